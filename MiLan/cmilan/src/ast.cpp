@@ -0,0 +1,28 @@
+#include "ast.h"
+
+AstArena::~AstArena()
+{
+	for(size_t i = 0; i < blocks_.size(); ++i) {
+		delete[] blocks_[i];
+	}
+}
+
+AstNode* AstArena::make(AstKind kind, int line)
+{
+	if(used_ == BLOCK_SIZE) {
+		blocks_.push_back(new AstNode[BLOCK_SIZE]);
+		used_ = 0;
+	}
+	AstNode* node = &blocks_.back()[used_++];
+	node->kind = kind;
+	node->line = line;
+	node->value = 0;
+	node->address = 0;
+	node->sizeAddress = 0;
+	node->tempAddress = 0;
+	node->left = 0;
+	node->right = 0;
+	node->third = 0;
+	node->next = 0;
+	return node;
+}
@@ -0,0 +1,85 @@
+#ifndef CMILAN_AST_H
+#define CMILAN_AST_H
+
+#include <vector>
+
+using namespace std;
+
+// Абстрактное синтаксическое дерево программы на Милане.
+//
+// Парсер строит дерево, в котором имена уже разрешены в адреса памяти данных,
+// а кодогенератор (AstCodeGen) или построитель промежуточного представления
+// обходят его отдельным проходом. Все узлы имеют один и тот же тип AstNode,
+// значение полей зависит от вида узла (см. AstKind). Узлы выделяются из
+// AstArena и освобождаются вместе с ней.
+
+enum AstKind
+{
+	// Выражения
+	AST_NUMBER,		// value - значение литерала
+	AST_VARIABLE,		// address - адрес переменной
+	AST_ELEMENT,		// элемент массива: address, sizeAddress; left - индекс
+	AST_READ,		// READ
+	AST_NEGATE,		// -left
+	AST_BINARY,		// left op right, value - операция (Arithmetic)
+	AST_COMPARE,		// условие left cmp right, value - операция сравнения (Cmp)
+
+	// Массив в правой части поэлементного присваивания; вместе с ним в таких
+	// выражениях встречаются AST_NEGATE и AST_BINARY
+	AST_ARRAY,		// address, sizeAddress
+
+	// Операторы
+	AST_ASSIGN,		// address := left
+	AST_ELEMENT_ASSIGN,	// address[left] := right; sizeAddress - адрес размера массива
+	AST_ARRAY_ASSIGN,	// поэлементное присваивание массиву address выражения left
+	AST_SET_ASSIGN,		// address := [left op right], value - A_PLUS (объединение)
+				// или A_MULTIPLY (пересечение), left и right - AST_ARRAY,
+				// tempAddress - начало временной области
+	AST_IF,			// IF left THEN right [ELSE third] FI; value != 0, если есть ELSE
+	AST_WHILE,		// WHILE left DO right OD
+	AST_WRITE,		// WRITE(left)
+	AST_DECLARE,		// ARRAY: address, sizeAddress, value - размер
+	AST_DELETE		// DELETE: address, sizeAddress
+};
+
+struct AstNode
+{
+	AstKind kind;		// вид узла
+	int line;		// номер строки, в которой начинается конструкция
+	int value;		// значение литерала, операция или размер массива
+	int address;		// адрес переменной или первого элемента массива
+	int sizeAddress;	// адрес ячейки с размером массива
+	int tempAddress;	// начало временной области (AST_SET_ASSIGN)
+	AstNode* left;		// первый потомок
+	AstNode* right;		// второй потомок
+	AstNode* third;		// третий потомок (ELSE)
+	AstNode* next;		// следующий оператор в списке
+};
+
+// Область памяти для узлов дерева. Узлы выделяются блоками и не
+// освобождаются по отдельности.
+
+class AstArena
+{
+public:
+	AstArena()
+		: used_(BLOCK_SIZE)
+	{
+	}
+
+	~AstArena();
+
+	// Новый узел вида kind, все поля которого, кроме line, обнулены
+	AstNode* make(AstKind kind, int line);
+
+private:
+	AstArena(const AstArena&);
+	AstArena& operator=(const AstArena&);
+
+	static const int BLOCK_SIZE = 1024;	// число узлов в блоке
+
+	vector<AstNode*> blocks_;	// выделенные блоки
+	int used_;			// число занятых узлов в последнем блоке
+};
+
+#endif
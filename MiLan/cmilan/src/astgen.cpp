@@ -0,0 +1,457 @@
+#include "astgen.h"
+
+void AstCodeGen::generate(const AstNode* program)
+{
+	statementList(program);
+	codegen_->emit(STOP);
+}
+
+void AstCodeGen::statementList(const AstNode* node)
+{
+	for(; node != 0; node = node->next) {
+		statement(node);
+	}
+}
+
+void AstCodeGen::statement(const AstNode* node)
+{
+	switch(node->kind) {
+		// Значение выражения записываем по адресу переменной
+		case AST_ASSIGN:
+			expression(node->left);
+			codegen_->emit(STORE, node->address);
+			break;
+
+		// Индекс проверяется (0 <= индекс < размер массива) до вычисления
+		// присваиваемого значения и сохраняется в служебной ячейке
+		case AST_ELEMENT_ASSIGN:
+			expression(node->left);
+			codegen_->emit(DUP); //дублируем значение индекса для сравнения с 0
+			codegen_->emit(DUP); //дублируем значение индекса для сравнения с размером массива
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(COMPARE, 2);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(COMPARE, 5);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+			codegen_->emit(STORE, RESERVE_ADDRESS);
+			expression(node->right);
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(BSTORE, node->address);
+			break;
+
+		case AST_SET_ASSIGN:
+			setAssign(node);
+			break;
+
+		// Значения элементов вычисляются в цикле по индексу (служебная ячейка 0)
+		// и накапливаются в стеке, затем записываются в массив в обратном порядке.
+		// Ячейка 1 хранит размер массива-результата.
+		case AST_ARRAY_ASSIGN: {
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(STORE, RESERVE_ADDRESS);
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(STORE, RESERVE_ADDRESS + 1);
+			int comandAddr = codegen_->getCurrentAddress();
+			arrExpression(node->left);
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(PUSH, 1);
+			codegen_->emit(ADD);
+			codegen_->emit(DUP);
+			codegen_->emit(STORE, RESERVE_ADDRESS);
+			codegen_->emit(LOAD, RESERVE_ADDRESS + 1);
+			codegen_->emit(COMPARE, 2);
+			codegen_->emit(JUMP_YES, comandAddr);
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(PUSH, 1);
+			codegen_->emit(SUB);
+			codegen_->emit(STORE, RESERVE_ADDRESS);
+			comandAddr = codegen_->getCurrentAddress();
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(BSTORE, node->address);
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(PUSH, 1);
+			codegen_->emit(SUB);
+			codegen_->emit(DUP);
+			codegen_->emit(STORE, RESERVE_ADDRESS);
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(COMPARE, 5);
+			codegen_->emit(JUMP_YES, comandAddr);
+			break;
+		}
+
+		// На вершине стека лежит 1 или 0 в зависимости от выполнения условия.
+		// Место для условного перехода JUMP_NO к блоку ELSE резервируется: адрес
+		// перехода станет известным только после генерации кода блока THEN.
+		case AST_IF: {
+			expression(node->left);
+			int jumpNoAddress = codegen_->reserve();
+			statementList(node->right);
+			if(node->value != 0) {
+				//Если есть блок ELSE, то чтобы не выполнять его в случае выполнения THEN,
+				//зарезервируем место для команды JUMP в конец этого блока
+				int jumpAddress = codegen_->reserve();
+				codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+				statementList(node->third);
+				codegen_->emitAt(jumpAddress, JUMP, codegen_->getCurrentAddress());
+			}
+			else {
+				codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+			}
+			break;
+		}
+
+		case AST_WHILE: {
+			//запоминаем адрес начала проверки условия.
+			int conditionAddress = codegen_->getCurrentAddress();
+			expression(node->left);
+			//резервируем место под инструкцию условного перехода для выхода из цикла.
+			int jumpNoAddress = codegen_->reserve();
+			statementList(node->right);
+			//переходим по адресу проверки условия
+			codegen_->emit(JUMP, conditionAddress);
+			//заполняем зарезервированный адрес инструкцией условного перехода на следующий за циклом оператор.
+			codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+			break;
+		}
+
+		case AST_WRITE:
+			expression(node->left);
+			codegen_->emit(PRINT);
+			break;
+
+		case AST_DECLARE:
+			codegen_->emit(PUSH, node->value);
+			codegen_->emit(STORE, node->sizeAddress);
+			break;
+
+		// Размер массива уменьшается на 1 (пустой массив - ошибка),
+		// освободившийся последний элемент обнуляется
+		case AST_DELETE:
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(DUP);
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(COMPARE, 3);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+			codegen_->emit(PUSH, 1);
+			codegen_->emit(SUB);
+			codegen_->emit(STORE, node->sizeAddress);
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(BSTORE, node->address);
+			break;
+
+		default:
+			break;
+	}
+}
+
+void AstCodeGen::expression(const AstNode* node)
+{
+	switch(node->kind) {
+		case AST_NUMBER:
+			codegen_->emit(PUSH, node->value);
+			break;
+
+		case AST_VARIABLE:
+			codegen_->emit(LOAD, node->address);
+			break;
+
+		// Индекс проверяется перед чтением элемента: 0 <= индекс < размер массива
+		case AST_ELEMENT:
+			expression(node->left);
+			codegen_->emit(DUP);
+			codegen_->emit(DUP);
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(COMPARE, 2);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+			codegen_->emit(PUSH, 0);
+			codegen_->emit(COMPARE, 5);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+			codegen_->emit(BLOAD, node->address);
+			break;
+
+		case AST_READ:
+			codegen_->emit(INPUT);
+			break;
+
+		case AST_NEGATE:
+			expression(node->left);
+			codegen_->emit(INVERT);
+			break;
+
+		case AST_BINARY:
+			expression(node->left);
+			expression(node->right);
+			switch(node->value) {
+				case A_PLUS:
+					codegen_->emit(ADD);
+					break;
+				case A_MINUS:
+					codegen_->emit(SUB);
+					break;
+				case A_MULTIPLY:
+					codegen_->emit(MULT);
+					break;
+				default:
+					codegen_->emit(DIV);
+					break;
+			}
+			break;
+
+		case AST_COMPARE:
+			expression(node->left);
+			expression(node->right);
+			codegen_->emit(COMPARE, compareCode((Cmp)node->value));
+			break;
+
+		default:
+			break;
+	}
+}
+
+int AstCodeGen::compareCode(Cmp cmp)
+{
+	switch(cmp) {
+		//для знака "=" - номер 0
+		case C_EQ:
+			return 0;
+		//для знака "!=" - номер 1
+		case C_NE:
+			return 1;
+		//для знака "<" - номер 2
+		case C_LT:
+			return 2;
+		//для знака ">" - номер 3
+		case C_GT:
+			return 3;
+		//для знака "<=" - номер 4
+		case C_LE:
+			return 4;
+		//для знака ">=" - номер 5
+		default:
+			return 5;
+	}
+}
+
+// Элемент с текущим индексом (служебная ячейка 0) каждого массива выражения.
+// Размер каждого массива должен совпадать с размером результата (ячейка 1).
+void AstCodeGen::arrExpression(const AstNode* node)
+{
+	switch(node->kind) {
+		case AST_ARRAY:
+			codegen_->emit(LOAD, RESERVE_ADDRESS + 1);
+			codegen_->emit(LOAD, node->sizeAddress);
+			codegen_->emit(COMPARE, 0);
+			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+			codegen_->emit(JUMP, -1);
+
+			codegen_->emit(LOAD, RESERVE_ADDRESS);
+			codegen_->emit(BLOAD, node->address);
+			break;
+
+		case AST_NEGATE:
+			arrExpression(node->left);
+			codegen_->emit(INVERT);
+			break;
+
+		case AST_BINARY:
+			arrExpression(node->left);
+			arrExpression(node->right);
+			switch(node->value) {
+				case A_PLUS:
+					codegen_->emit(ADD);
+					break;
+				case A_MINUS:
+					codegen_->emit(SUB);
+					break;
+				case A_MULTIPLY:
+					codegen_->emit(MULT);
+					break;
+				default:
+					codegen_->emit(DIV);
+					break;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+// Результат объединения или пересечения строится во временной области:
+// ячейка 0 - индекс в первом массиве, 1 - вспомогательный индекс,
+// 2 - размер результата. Затем результат копируется в массив-приемник,
+// а временная область очищается.
+void AstCodeGen::setAssign(const AstNode* node)
+{
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, RESERVE_ADDRESS); //хранит индекс первого массива
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, RESERVE_ADDRESS + 1); //хранит вспомагательный индекс
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, RESERVE_ADDRESS + 2); //хранит размер полученного массива
+	const AstNode* first = node->left;
+	const AstNode* second = node->right;
+	if (node->value == A_PLUS) {
+		orCode(first->address, first->sizeAddress, node->tempAddress);
+		codegen_->emit(PUSH, 0);
+		codegen_->emit(STORE, RESERVE_ADDRESS);
+		orCode(second->address, second->sizeAddress, node->tempAddress);
+	}
+	else {
+		andCode(first->address, first->sizeAddress, second->address, second->sizeAddress,
+			node->tempAddress);
+	}
+	copyToDest(node->address, node->sizeAddress, node->tempAddress);
+	clear(node->tempAddress);
+}
+
+void AstCodeGen::orCode(int arrAddress, int sizeAddress, int tempAddress)
+{
+	codegen_->emit(LOAD, 0);
+	codegen_->emit(BLOAD, arrAddress);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(COMPARE, 0);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 18);
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(DUP);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BLOAD, tempAddress);
+	codegen_->emit(COMPARE, 0);
+	codegen_->emit(JUMP_NO, codegen_->getCurrentAddress() + 3);
+	codegen_->emit(POP);
+	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 15);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 14);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(BSTORE, tempAddress);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(STORE, 2);
+	codegen_->emit(LOAD, 0);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 0);
+	codegen_->emit(LOAD, sizeAddress);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 36);
+}
+
+void AstCodeGen::andCode(int arrAddress1, int sizeAddress1, int arrAddress2, int sizeAddress2, int tempAddress)
+{
+	codegen_->emit(LOAD, 0);
+	codegen_->emit(BLOAD, arrAddress1);
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(DUP);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BLOAD, arrAddress2);
+	codegen_->emit(COMPARE, 0);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 11);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(LOAD, sizeAddress2);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 12);
+	codegen_->emit(POP);
+	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 28);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(COMPARE, 0);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 18);
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(DUP);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BLOAD, tempAddress);
+	codegen_->emit(COMPARE, 0);
+	codegen_->emit(JUMP_NO, codegen_->getCurrentAddress() + 3);
+	codegen_->emit(POP);
+	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 15);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 14);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(BSTORE, tempAddress);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(STORE, 2);
+	codegen_->emit(LOAD, 0);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 0);
+	codegen_->emit(LOAD, sizeAddress1);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 53);
+}
+
+void AstCodeGen::clear(int tempAddress)
+{
+	//index:=0
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, 1);
+	//while index < size do mem[index]:=0; index++; done
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BSTORE, tempAddress);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 10);
+}
+
+void AstCodeGen::copyToDest(int address, int size, int tempAddress)
+{
+	//if size <= arraySize then OK else JUMP -1
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(LOAD, size);
+	codegen_->emit(COMPARE, 4);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+	codegen_->emit(JUMP, -1);
+	//index:=0
+	codegen_->emit(PUSH, 0);
+	codegen_->emit(STORE, 1);
+	//while index < size do array[index]:=mem[index];index++; done
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BLOAD, tempAddress);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(BSTORE, address);
+	codegen_->emit(LOAD, 1);
+	codegen_->emit(PUSH, 1);
+	codegen_->emit(ADD);
+	codegen_->emit(DUP);
+	codegen_->emit(STORE, 1);
+	codegen_->emit(LOAD, 2);
+	codegen_->emit(COMPARE, 2);
+	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 11);
+}
\ No newline at end of file
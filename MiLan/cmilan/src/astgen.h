@@ -0,0 +1,53 @@
+#ifndef CMILAN_ASTGEN_H
+#define CMILAN_ASTGEN_H
+
+#include "ast.h"
+#include "codegen.h"
+#include "scanner.h"
+
+using namespace std;
+
+// Генерация кода виртуальной машины по синтаксическому дереву.
+//
+// Формирует ту же последовательность команд, которую прежде формировал парсер
+// во время разбора: код каждой конструкции по-прежнему зависит только от нее
+// самой. Поэлементные операции над массивами используют служебные ячейки
+// 0..2 и временную область, начинающуюся с AstNode::tempAddress.
+
+class AstCodeGen
+{
+public:
+	static const int RESERVE_ADDRESS = 0;	// первая из служебных ячеек 0..2
+
+	explicit AstCodeGen(CodeGen* codegen)
+		: codegen_(codegen)
+	{
+	}
+
+	// Код программы из списка операторов program (с завершающей командой STOP)
+	void generate(const AstNode* program);
+
+	// Код одного оператора
+	void statement(const AstNode* node);
+
+	// Код списка операторов
+	void statementList(const AstNode* node);
+
+	// Код выражения или условия; значение остается на вершине стека
+	void expression(const AstNode* node);
+
+	// Код сравнения с кодом операции cmp для команды COMPARE
+	static int compareCode(Cmp cmp);
+
+private:
+	void arrExpression(const AstNode* node); // поэлементное выражение над массивами
+	void setAssign(const AstNode* node); // объединение или пересечение массивов
+	void clear(int tempAddress); // очищает использованную память
+	void copyToDest(int address, int size, int tempAddress); // копирует массив (если размер позволяет), полученный при объединении или пересечении в конечный массив
+	void orCode(int arrAddress, int sizeAddress, int tempAddress); // формирование кода для операции объединения
+	void andCode(int arrAddress1, int sizeAddress1, int arrAddress2, int sizeAddress2, int tempAddress); // формирование кода для операции пересечения
+
+	CodeGen* codegen_; // буфер формируемой программы
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "batch.h"
+#include "bytecode.h"
+#include "mappedfile.h"
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+// Очереди заданий потоков. Владелец берет задания из конца своей очереди,
+// остальные потоки - из начала. Новые задания во время работы не появляются,
+// поэтому поток завершается, когда все очереди пусты.
+class BatchCompiler::WorkQueues
+{
+public:
+	explicit WorkQueues(int count)
+		: queues_(count)
+	{
+	}
+
+	void push(int worker, int job)
+	{
+		queues_[worker].jobs.push_back(job);
+	}
+
+	// Следующее задание для потока worker или -1, если заданий не осталось
+	int next(int worker)
+	{
+		const int count = queues_.size();
+		{
+			Queue& own = queues_[worker];
+			lock_guard<mutex> lock(own.lock);
+			if(!own.jobs.empty()) {
+				int job = own.jobs.back();
+				own.jobs.pop_back();
+				return job;
+			}
+		}
+		for(int i = 1; i < count; ++i) {
+			Queue& victim = queues_[(worker + i) % count];
+			lock_guard<mutex> lock(victim.lock);
+			if(!victim.jobs.empty()) {
+				int job = victim.jobs.front();
+				victim.jobs.pop_front();
+				return job;
+			}
+		}
+		return -1;
+	}
+
+private:
+	struct Queue
+	{
+		mutex lock;
+		deque<int> jobs;
+	};
+
+	vector<Queue> queues_;
+};
+
+void BatchCompiler::add(const string& input, const string& output)
+{
+	Job job;
+	job.input = input;
+	job.output = output;
+	if(job.output.empty()) {
+		string::size_type dot = input.rfind('.');
+		string::size_type slash = input.find_last_of("/\\");
+		if(dot == string::npos || (slash != string::npos && dot < slash)) {
+			dot = input.size();
+		}
+		job.output = input.substr(0, dot) + (binary_ ? ".mlb" : ".o");
+	}
+	job.bytes = 0;
+	job.ok = false;
+	jobs_.push_back(job);
+}
+
+bool BatchCompiler::addManifest(const char* fileName)
+{
+	ifstream manifest(fileName);
+	if(!manifest) {
+		return false;
+	}
+
+	string line;
+	while(getline(manifest, line)) {
+		const char* blanks = " \t\r";
+		string::size_type start = line.find_first_not_of(blanks);
+		if(start == string::npos || line[start] == '#') {
+			continue;
+		}
+		string::size_type end = line.find_first_of(blanks, start);
+		string input = line.substr(start, end - start);
+		string output;
+		if(end != string::npos) {
+			start = line.find_first_not_of(blanks, end);
+			if(start != string::npos) {
+				end = line.find_first_of(blanks, start);
+				output = line.substr(start, end - start);
+			}
+		}
+		add(input, output);
+	}
+	return true;
+}
+
+// Компиляция задания и запись результата
+void BatchCompiler::compile(Job& job) const
+{
+	MappedFile source;
+	if(!source.open(job.input.c_str())) {
+		job.error = source.getError();
+		return;
+	}
+	job.bytes = source.getSize();
+
+	Compiler compiler;
+	compiler.setOptimize(optimize_);
+	CompileResult result;
+	string key;
+	if(cache_ != 0) {
+		key = CompileCache::makeKey(source.getData(), source.getData() + source.getSize(),
+			compiler.getOptions());
+	}
+	if(cache_ == 0 || !cache_->lookup(key, result)) {
+		bool ok = compiler.compile(source.getData(), source.getData() + source.getSize(),
+			result, job.input);
+		if(!ok) {
+			job.diagnostics.swap(result.diagnostics);
+			return;
+		}
+		if(cache_ != 0) {
+			cache_->store(key, result);
+		}
+	}
+	source.close();
+
+	ofstream output(job.output.c_str(), binary_ ? ios::out | ios::binary : ios::out);
+	if(!output) {
+		job.error = "cannot create '" + job.output + "'";
+		return;
+	}
+	if(binary_) {
+		BytecodeFile::write(output, result.code, result.memorySize);
+	}
+	else {
+		for(size_t address = 0; address < result.code.size(); ++address) {
+			result.code[address].print(address, output);
+		}
+	}
+	output.close();
+	if(!output) {
+		job.error = "cannot write '" + job.output + "'";
+		return;
+	}
+	job.ok = true;
+}
+
+void BatchCompiler::work(WorkQueues& queues, int worker)
+{
+	for(int job = queues.next(worker); job >= 0; job = queues.next(worker)) {
+		compile(jobs_[job]);
+	}
+}
+
+int BatchCompiler::run(ostream& report)
+{
+	const int count = jobs_.size();
+	int threads = threads_;
+	if(threads <= 0) {
+		threads = max(1, (int)thread::hardware_concurrency());
+	}
+	threads = max(1, min(threads, count));
+
+	// Начальное распределение: последовательные блоки заданий по потокам,
+	// чтобы перехват работы требовался только при неравной нагрузке
+	WorkQueues queues(threads);
+	for(int job = 0; job < count; ++job) {
+		queues.push((long long)job * threads / max(count, 1), job);
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for(int worker = 1; worker < threads; ++worker) {
+		workers.push_back(thread(&BatchCompiler::work, this, ref(queues), worker));
+	}
+	work(queues, 0);
+	for(size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int failures = 0;
+	size_t bytes = 0;
+	for(int i = 0; i < count; ++i) {
+		const Job& job = jobs_[i];
+		bytes += job.bytes;
+		if(job.ok) {
+			continue;
+		}
+		++failures;
+		if(!job.error.empty()) {
+			report << job.input << ": " << job.error << '\n';
+		}
+		for(size_t d = 0; d < job.diagnostics.size(); ++d) {
+			report << job.input << ": Line " << job.diagnostics[d].line << ": "
+				<< job.diagnostics[d].message << '\n';
+		}
+	}
+
+	report << "Compiled " << count - failures << " of " << count << " files, "
+		<< failures << " failed, " << threads << " threads, "
+		<< seconds << " s";
+	if(seconds > 0) {
+		report << " (" << (int)(count / seconds) << " files/s, "
+			<< bytes / seconds / (1024 * 1024) << " MB/s)";
+	}
+	report << endl;
+	if(cache_ != 0) {
+		cache_->printStatistics(report);
+	}
+	return failures;
+}
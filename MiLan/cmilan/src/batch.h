@@ -0,0 +1,81 @@
+#ifndef CMILAN_BATCH_H
+#define CMILAN_BATCH_H
+
+#include "compiler.h"
+#include "cache.h"
+#include <vector>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+// Пакетная компиляция.
+//
+// Компилирует много программ в одном процессе на пуле потоков с перехватом
+// работы (work stealing): у каждого потока своя очередь заданий, из конца
+// которой он берет задания сам; опустевший поток забирает задания из начала
+// очередей других потоков. Каждое задание компилируется своим экземпляром
+// Compiler (и, следовательно, своими Parser, Scanner и CodeGen) и записывается
+// в свой выходной файл в текстовом или двоичном формате.
+
+class BatchCompiler
+{
+public:
+	// Конструктор
+	//     int threads - число потоков (0 - по числу процессоров)
+	//     bool binary - записывать программы в двоичном формате (см. BytecodeFile)
+	BatchCompiler(int threads, bool binary)
+		: threads_(threads), binary_(binary), optimize_(false), cache_(0)
+	{
+	}
+
+	// Оптимизация кода (cmilan -O)
+	void setOptimize(bool optimize)
+	{
+		optimize_ = optimize;
+	}
+
+	// Использование кэша результатов компиляции (0 - без кэша)
+	void setCache(CompileCache* cache)
+	{
+		cache_ = cache;
+	}
+
+	// Добавление задания. Если output пуст, выходной файл получает имя
+	// входного с расширением .o (.mlb для двоичного формата).
+	void add(const string& input, const string& output = string());
+
+	// Добавление заданий из файла-списка: в каждой строке имя входного файла
+	// и, через пробел, необязательное имя выходного. Пустые строки и строки,
+	// начинающиеся с '#', пропускаются. Возвращает false, если файл не прочитан.
+	bool addManifest(const char* fileName);
+
+	// Компиляция всех заданий. Сообщения об ошибках (в порядке заданий) и
+	// итоговая статистика печатаются в report. Возвращает число неудачных заданий.
+	int run(ostream& report);
+
+private:
+	// Задание и его результат
+	struct Job
+	{
+		string input;			// входной файл
+		string output;			// выходной файл
+		size_t bytes;			// размер входного файла
+		bool ok;			// скомпилировано и записано успешно
+		string error;			// ошибка чтения или записи
+		vector<Diagnostic> diagnostics;	// ошибки компиляции
+	};
+
+	class WorkQueues;
+
+	void compile(Job& job) const;
+	void work(WorkQueues& queues, int worker);
+
+	int threads_;		// число потоков
+	bool binary_;		// двоичный формат выходных файлов
+	bool optimize_;		// оптимизировать ли код
+	CompileCache* cache_;	// кэш результатов компиляции
+	vector<Job> jobs_;	// задания
+};
+
+#endif
@@ -0,0 +1,362 @@
+#include "boundscheck.h"
+#include <climits>
+#include <algorithm>
+
+// Коды сравнения команды COMPARE
+enum
+{
+	CMP_EQ,
+	CMP_NE,
+	CMP_LT,
+	CMP_GT,
+	CMP_LE,
+	CMP_GE
+};
+
+// Сравнение, истинное, когда cmp ложно
+static int negateCompare(int cmp)
+{
+	static const int negated[] = { CMP_NE, CMP_EQ, CMP_GE, CMP_LE, CMP_GT, CMP_LT };
+	return negated[cmp];
+}
+
+// Сравнение с переставленными операндами
+static int swapCompare(int cmp)
+{
+	static const int swapped[] = { CMP_EQ, CMP_NE, CMP_GT, CMP_LT, CMP_GE, CMP_LE };
+	return swapped[cmp];
+}
+
+bool BoundsCheckElimination::run(IrFunction& function)
+{
+	DominatorTree dominators(function);
+	dominators_ = &dominators;
+	Range empty = { 1, 0 };
+	range_.assign(function.getInstrCount(), empty);
+	facts_.assign(function.getBlockCount(), vector<Fact>());
+	collectFacts();
+	computeRanges();
+
+	bool changed = false;
+	const vector<IrBlock*>& order = dominators.getOrder();
+	for(size_t i = 0; i < order.size(); ++i) {
+		IrBlock* block = order[i];
+		vector<IrInstr*> instrs = block->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			IrInstr* instr = instrs[j];
+			if(instr->opcode != IR_CHECK) {
+				continue;
+			}
+			Range index = rangeAt(instr->operands[0], block, MAX_DEPTH);
+			Range size = rangeAt(instr->operands[1], block, MAX_DEPTH);
+			if(index.lo <= index.hi && size.lo <= size.hi && index.lo >= 0 && index.hi < size.lo) {
+				function.replaceAllUses(instr, instr->operands[0]);
+				function.remove(instr);
+				changed = true;
+			}
+		}
+	}
+	dominators_ = 0;
+	return changed;
+}
+
+// Условие перехода P -> B выполняется во всех блоках, над которыми
+// доминирует B, если P - единственный предшественник B
+void BoundsCheckElimination::collectFacts()
+{
+	const vector<IrBlock*>& order = dominators_->getOrder();
+	for(size_t i = 0; i < order.size(); ++i) {
+		IrBlock* block = order[i];
+		IrBlock* idom = dominators_->getIdom(block);
+		if(idom != 0) {
+			facts_[block->id] = facts_[idom->id];
+		}
+		if(block->preds.size() != 1) {
+			continue;
+		}
+		IrBlock* pred = block->preds[0];
+		IrInstr* terminator = pred->getTerminator();
+		if(terminator->opcode != IR_BRANCH || pred->succs[0] == pred->succs[1]
+			|| terminator->operands[0]->opcode != IR_COMPARE) {
+			continue;
+		}
+		IrInstr* condition = terminator->operands[0];
+		Fact fact;
+		fact.left = condition->operands[0];
+		fact.right = condition->operands[1];
+		fact.cmp = (block == pred->succs[0]) ? condition->value : negateCompare(condition->value);
+		facts_[block->id].push_back(fact);
+	}
+}
+
+// Интервал [lo, hi], если он не выходит за пределы int; иначе значение
+// может оказаться любым (переполнение по модулю 2^32)
+static void makeRange(long long lo, long long hi, int& rangeLo, int& rangeHi)
+{
+	if(lo < INT_MIN || hi > INT_MAX) {
+		rangeLo = INT_MIN;
+		rangeHi = INT_MAX;
+	}
+	else {
+		rangeLo = (int)lo;
+		rangeHi = (int)hi;
+	}
+}
+
+BoundsCheckElimination::Range BoundsCheckElimination::evaluate(IrInstr* instr) const
+{
+	Range result = { INT_MIN, INT_MAX };
+	switch(instr->opcode) {
+		case IR_CONST:
+			result.lo = result.hi = instr->value;
+			return result;
+
+		case IR_PHI: {
+			// Операнд уточняется условиями в конце предшественника
+			result.lo = 1;
+			result.hi = 0;
+			IrBlock* block = instr->block;
+			for(size_t i = 0; i < instr->operands.size(); ++i) {
+				Range operand = rangeAt(instr->operands[i], block->preds[i], MAX_DEPTH);
+				if(operand.lo > operand.hi) {
+					continue;
+				}
+				if(result.lo > result.hi) {
+					result = operand;
+				}
+				else {
+					result.lo = min(result.lo, operand.lo);
+					result.hi = max(result.hi, operand.hi);
+				}
+			}
+			return result;
+		}
+
+		case IR_COMPARE:
+			result.lo = 0;
+			result.hi = 1;
+			return result;
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_DIV:
+		case IR_NEG:
+		case IR_CHECK:
+			break;
+
+		default:
+			return result;
+	}
+
+	Range a = rangeAt(instr->operands[0], instr->block, 1);
+	Range b = a;
+	if(instr->operands.size() > 1) {
+		b = rangeAt(instr->operands[1], instr->block, 1);
+	}
+	return arithmetic(instr->opcode, a, b);
+}
+
+BoundsCheckElimination::Range BoundsCheckElimination::arithmetic(IrOpcode opcode, Range a, Range b)
+{
+	Range result = { 1, 0 };
+	if(a.lo > a.hi || b.lo > b.hi) {
+		return result;
+	}
+	switch(opcode) {
+		case IR_ADD:
+			makeRange((long long)a.lo + b.lo, (long long)a.hi + b.hi, result.lo, result.hi);
+			break;
+
+		case IR_SUB:
+			makeRange((long long)a.lo - b.hi, (long long)a.hi - b.lo, result.lo, result.hi);
+			break;
+
+		case IR_MULT: {
+			long long p[] = {
+				(long long)a.lo * b.lo, (long long)a.lo * b.hi,
+				(long long)a.hi * b.lo, (long long)a.hi * b.hi
+			};
+			makeRange(*min_element(p, p + 4), *max_element(p, p + 4), result.lo, result.hi);
+			break;
+		}
+
+		case IR_DIV:
+			if(b.lo > 0 || b.hi < 0) {
+				// Частное монотонно по каждому операнду при делителе одного знака
+				long long q[] = {
+					(long long)a.lo / b.lo, (long long)a.lo / b.hi,
+					(long long)a.hi / b.lo, (long long)a.hi / b.hi
+				};
+				makeRange(*min_element(q, q + 4), *max_element(q, q + 4), result.lo, result.hi);
+			}
+			else {
+				// Модуль частного не больше модуля делимого
+				long long m = max(-(long long)a.lo, (long long)a.hi);
+				makeRange(-m, m, result.lo, result.hi);
+			}
+			break;
+
+		case IR_NEG:
+			makeRange(-(long long)a.hi, -(long long)a.lo, result.lo, result.hi);
+			break;
+
+		case IR_CHECK:
+			// После проверки 0 <= индекс < размер
+			result.lo = max(a.lo, 0);
+			result.hi = (int)min((long long)a.hi, (long long)b.hi - 1);
+			break;
+
+		default:
+			result.lo = INT_MIN;
+			result.hi = INT_MAX;
+			break;
+	}
+	return result;
+}
+
+void BoundsCheckElimination::computeRanges()
+{
+	const vector<IrBlock*>& order = dominators_->getOrder();
+	vector<int> changes(range_.size(), 0);
+
+	// Интервалы растут, пока не перестанут меняться; интервал, изменившийся
+	// много раз, расширяется до бесконечности в сторону роста
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(size_t i = 0; i < order.size(); ++i) {
+			const vector<IrInstr*>& instrs = order[i]->instrs;
+			for(size_t j = 0; j < instrs.size(); ++j) {
+				IrInstr* instr = instrs[j];
+				if(!instr->hasValue()) {
+					continue;
+				}
+				Range old = range_[instr->id];
+				Range value = evaluate(instr);
+				if(value.lo > value.hi) {
+					continue;
+				}
+				if(old.lo <= old.hi) {
+					value.lo = min(value.lo, old.lo);
+					value.hi = max(value.hi, old.hi);
+					if(value.lo == old.lo && value.hi == old.hi) {
+						continue;
+					}
+					if(++changes[instr->id] > WIDEN_AFTER) {
+						if(value.lo < old.lo) {
+							value.lo = INT_MIN;
+						}
+						if(value.hi > old.hi) {
+							value.hi = INT_MAX;
+						}
+					}
+				}
+				range_[instr->id] = value;
+				changed = true;
+			}
+		}
+	}
+
+	// Сужение: повторное вычисление по уже найденным интервалам
+	for(int round = 0; round < 2; ++round) {
+		for(size_t i = 0; i < order.size(); ++i) {
+			const vector<IrInstr*>& instrs = order[i]->instrs;
+			for(size_t j = 0; j < instrs.size(); ++j) {
+				IrInstr* instr = instrs[j];
+				if(!instr->hasValue()) {
+					continue;
+				}
+				Range& old = range_[instr->id];
+				Range value = evaluate(instr);
+				if(value.lo <= value.hi && old.lo <= old.hi) {
+					old.lo = max(old.lo, value.lo);
+					old.hi = min(old.hi, value.hi);
+				}
+			}
+		}
+	}
+}
+
+BoundsCheckElimination::Range BoundsCheckElimination::rangeAt(IrInstr* value, IrBlock* block,
+	int depth) const
+{
+	Range result = range_[value->id];
+	if(depth == 0 || result.lo > result.hi) {
+		return result;
+	}
+
+	// Вычисление по уточненным операндам
+	switch(value->opcode) {
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_NEG: {
+			Range a = rangeAt(value->operands[0], block, depth - 1);
+			Range b = (value->operands.size() > 1) ? rangeAt(value->operands[1], block, depth - 1) : a;
+			Range refined = arithmetic(value->opcode, a, b);
+			if(refined.lo <= refined.hi) {
+				result.lo = max(result.lo, refined.lo);
+				result.hi = min(result.hi, refined.hi);
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	// Условия переходов, доминирующих над блоком
+	const vector<Fact>& facts = facts_[block->id];
+	for(size_t i = 0; i < facts.size() && result.lo <= result.hi; ++i) {
+		const Fact& fact = facts[i];
+		IrInstr* other;
+		int cmp;
+		if(fact.left == value) {
+			other = fact.right;
+			cmp = fact.cmp;
+		}
+		else if(fact.right == value) {
+			other = fact.left;
+			cmp = swapCompare(fact.cmp);
+		}
+		else {
+			continue;
+		}
+		Range bound = rangeAt(other, block, depth - 1);
+		if(bound.lo > bound.hi) {
+			continue;
+		}
+		long long lo = result.lo;
+		long long hi = result.hi;
+		switch(cmp) {
+			case CMP_EQ:
+				lo = max(lo, (long long)bound.lo);
+				hi = min(hi, (long long)bound.hi);
+				break;
+			case CMP_LT:
+				hi = min(hi, (long long)bound.hi - 1);
+				break;
+			case CMP_LE:
+				hi = min(hi, (long long)bound.hi);
+				break;
+			case CMP_GT:
+				lo = max(lo, (long long)bound.lo + 1);
+				break;
+			case CMP_GE:
+				lo = max(lo, (long long)bound.lo);
+				break;
+			default:
+				break;
+		}
+		if(lo > hi) {
+			// Путь невозможен
+			result.lo = 1;
+			result.hi = 0;
+			break;
+		}
+		result.lo = (int)lo;
+		result.hi = (int)hi;
+	}
+	return result;
+}
@@ -0,0 +1,69 @@
+#ifndef CMILAN_BOUNDSCHECK_H
+#define CMILAN_BOUNDSCHECK_H
+
+#include "passes.h"
+#include "dominators.h"
+#include <vector>
+
+using namespace std;
+
+// Удаление избыточных проверок индексов массивов (IR_CHECK).
+//
+// Для каждого значения вычисляется интервал, в котором оно лежит при любом
+// исполнении программы (с расширением интервалов phi-функций, которые
+// растут в цикле, до бесконечности и последующим сужением). В точке
+// проверки интервал индекса уточняется условиями переходов, которые
+// доминируют над ней: в теле цикла WHILE i < n индекс i меньше n. Операнд
+// phi-функции уточняется условиями, выполненными в конце соответствующего
+// предшественника, поэтому для счетчика i := i + 1 в таком цикле
+// переполнение исключается, и он остается неотрицательным.
+//
+// Проверка удаляется, если индекс заведомо не меньше 0 и меньше
+// наименьшего возможного размера массива.
+
+class BoundsCheckElimination : public IrPass
+{
+public:
+	BoundsCheckElimination()
+		: dominators_(0)
+	{
+	}
+
+	const char* getName() const
+	{
+		return "bce";
+	}
+
+	bool run(IrFunction& function);
+
+private:
+	static const int MAX_DEPTH = 4;		// глубина уточнения по операндам
+	static const int WIDEN_AFTER = 3;	// число изменений до расширения
+
+	// Интервал значений [lo, hi]; пустой, если lo > hi
+	struct Range
+	{
+		int lo;
+		int hi;
+	};
+
+	// Условие перехода, выполненное в блоке: op0 cmp op1
+	struct Fact
+	{
+		IrInstr* left;
+		IrInstr* right;
+		int cmp;
+	};
+
+	void collectFacts();
+	void computeRanges();
+	Range evaluate(IrInstr* instr) const;
+	static Range arithmetic(IrOpcode opcode, Range a, Range b);
+	Range rangeAt(IrInstr* value, IrBlock* block, int depth) const;
+
+	DominatorTree* dominators_;
+	vector<Range> range_;			// интервалы значений
+	vector< vector<Fact> > facts_;		// условия, выполненные в блоке
+};
+
+#endif
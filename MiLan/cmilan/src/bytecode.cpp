@@ -0,0 +1,100 @@
+#include "bytecode.h"
+#include <cstring>
+#include <fstream>
+
+// Формат определен для порядка байтов little-endian
+static bool isLittleEndian()
+{
+	const uint16_t probe = 1;
+	return *(const unsigned char*)&probe == 1;
+}
+
+void BytecodeFile::write(ostream& os, const vector<Command>& program, int memorySize, int entry)
+{
+	const int count = program.size();
+
+	BytecodeHeader header;
+	memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+	header.version = BYTECODE_VERSION;
+	header.count = count;
+	header.memorySize = memorySize;
+	header.entry = entry;
+	header.reserved = 0;
+
+	vector<BytecodeRecord> records(count);
+	for(int address = 0; address < count; ++address) {
+		BytecodeRecord& record = records[address];
+		record.opcode = program[address].getInstruction();
+		record.reserved[0] = record.reserved[1] = record.reserved[2] = 0;
+		record.arg = program[address].getArg();
+	}
+
+	os.write((const char*)&header, sizeof(header));
+	if(count > 0) {
+		os.write((const char*)&records[0], count * sizeof(BytecodeRecord));
+	}
+	os.flush();
+}
+
+bool BytecodeFile::isBytecode(const char* fileName)
+{
+	ifstream input(fileName, ios::binary);
+	char magic[sizeof(BYTECODE_MAGIC)];
+	return input.read(magic, sizeof(magic)) && memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool BytecodeFile::fail(const string& message)
+{
+	file_.close();
+	header_ = 0;
+	records_ = 0;
+	error_ = message;
+	return false;
+}
+
+bool BytecodeFile::open(const char* fileName)
+{
+	header_ = 0;
+	records_ = 0;
+	if(!isLittleEndian()) {
+		return fail("bytecode is not supported on big-endian platforms");
+	}
+	if(!file_.open(fileName)) {
+		return fail(file_.getError());
+	}
+
+	const char* data = file_.getData();
+	const size_t size = file_.getSize();
+	if(size < sizeof(BytecodeHeader)) {
+		return fail("file is too short");
+	}
+	header_ = (const BytecodeHeader*)data;
+	if(memcmp(header_->magic, BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC)) != 0) {
+		return fail("not a MiLan bytecode file");
+	}
+	if(header_->version != BYTECODE_VERSION) {
+		return fail("unsupported bytecode version");
+	}
+	if(header_->count > 0x7FFFFFFF / sizeof(BytecodeRecord)
+		|| size != sizeof(BytecodeHeader) + header_->count * sizeof(BytecodeRecord)) {
+		return fail("file size does not match instruction count");
+	}
+	if(header_->memorySize > 0x7FFFFFFF) {
+		return fail("memory size is out of range");
+	}
+	if(header_->entry > header_->count) {
+		return fail("entry point is outside of the program");
+	}
+	records_ = (const BytecodeRecord*)(data + sizeof(BytecodeHeader));
+	return true;
+}
+
+void BytecodeFile::getCommands(vector<Command>& program) const
+{
+	const int count = getCount();
+	program.clear();
+	program.reserve(count);
+	for(int address = 0; address < count; ++address) {
+		program.push_back(Command((Instruction)records_[address].opcode, records_[address].arg));
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef CMILAN_BYTECODE_H
+#define CMILAN_BYTECODE_H
+
+#include "codegen.h"
+#include "mappedfile.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Двоичный формат программы виртуальной машины Милана.
+//
+// Файл состоит из заголовка BytecodeHeader и count записей BytecodeRecord
+// фиксированного размера (по одной на инструкцию, в порядке адресов).
+// Многобайтовые поля хранятся в порядке little-endian. Записи выровнены
+// на 4 байта, поэтому отображенный в память файл используется на месте,
+// без разбора и копирования.
+//
+// Версия формата увеличивается при любом несовместимом изменении заголовка,
+// записей или кодов инструкций (Instruction).
+
+static const char BYTECODE_MAGIC[4] = { 'M', 'I', 'L', 'B' };
+static const uint32_t BYTECODE_VERSION = 1;
+
+struct BytecodeHeader
+{
+	char magic[4];		// BYTECODE_MAGIC
+	uint32_t version;	// BYTECODE_VERSION
+	uint32_t count;		// число инструкций
+	uint32_t memorySize;	// число слов памяти данных, занятых переменными и массивами
+	uint32_t entry;		// адрес первой исполняемой инструкции
+	uint32_t reserved;	// 0
+};
+
+struct BytecodeRecord
+{
+	uint8_t opcode;		// код инструкции (Instruction)
+	uint8_t reserved[3];	// 0
+	int32_t arg;		// аргумент инструкции
+};
+
+// Класс BytecodeFile записывает программы в двоичном формате и открывает
+// двоичные файлы программ, отображая их в память.
+
+class BytecodeFile
+{
+public:
+	BytecodeFile()
+		: header_(0), records_(0)
+	{
+	}
+
+	// Запись программы в двоичном формате
+	//     int memorySize - число слов памяти данных, занятых переменными
+	//     int entry - адрес первой исполняемой инструкции
+	static void write(ostream& os, const vector<Command>& program, int memorySize, int entry = 0);
+
+	// Начинается ли файл с сигнатуры двоичного формата
+	static bool isBytecode(const char* fileName);
+
+	// Открытие файла и проверка заголовка. При ошибке возвращает false,
+	// описание ошибки возвращает getError().
+	bool open(const char* fileName);
+
+	const string& getError() const
+	{
+		return error_;
+	}
+
+	int getCount() const
+	{
+		return header_->count;
+	}
+
+	int getMemorySize() const
+	{
+		return header_->memorySize;
+	}
+
+	int getEntry() const
+	{
+		return header_->entry;
+	}
+
+	// Записи инструкций; действительны, пока файл открыт
+	const BytecodeRecord* getRecords() const
+	{
+		return records_;
+	}
+
+	// Преобразование программы в последовательность команд
+	void getCommands(vector<Command>& program) const;
+
+private:
+	BytecodeFile(const BytecodeFile&);
+	BytecodeFile& operator=(const BytecodeFile&);
+
+	bool fail(const string& message);
+
+	MappedFile file_;		// отображенный файл
+	const BytecodeHeader* header_;	// заголовок
+	const BytecodeRecord* records_;	// записи инструкций
+	string error_;			// описание последней ошибки
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "cache.h"
+#include "bytecode.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+static const char* const CACHE_SUFFIX = ".mlb";
+
+// 64-битная хеш-функция FNV-1a. Ключ составляется из двух хешей с разными
+// начальными значениями, чтобы вероятность совпадения ключей разных программ
+// была пренебрежимо мала.
+static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+{
+	for(size_t i = 0; i < size; ++i) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static uint64_t hashKey(uint64_t hash, const char* begin, const char* end, const string& options)
+{
+	hash = fnv1a(hash, COMPILER_VERSION, strlen(COMPILER_VERSION) + 1);
+	hash = fnv1a(hash, options.c_str(), options.size() + 1);
+	return fnv1a(hash, begin, end - begin);
+}
+
+string CompileCache::makeKey(const char* begin, const char* end, const string& options)
+{
+	char key[64];
+	snprintf(key, sizeof(key), "%016llx%016llx-%llx",
+		(unsigned long long)hashKey(0xCBF29CE484222325ULL, begin, end, options),
+		(unsigned long long)hashKey(0x84222325CBF29CE4ULL, begin, end, options),
+		(unsigned long long)(end - begin));
+	return key;
+}
+
+string CompileCache::path(const string& key) const
+{
+	return directory_ + "/" + key + CACHE_SUFFIX;
+}
+
+bool CompileCache::lookup(const string& key, CompileResult& result)
+{
+	string fileName = path(key);
+	BytecodeFile image;
+	if(!image.open(fileName.c_str())) {
+		++misses_;
+		return false;
+	}
+
+	image.getCommands(result.code);
+	result.memorySize = image.getMemorySize();
+	result.diagnostics.clear();
+	utime(fileName.c_str(), 0);	// запись использована последней
+	++hits_;
+	return true;
+}
+
+void CompileCache::store(const string& key, const CompileResult& result)
+{
+	if(!result.ok()) {
+		return;
+	}
+
+	mkdir(directory_.c_str(), 0777);
+
+	// Имя временного файла уникально для процесса и потока
+	static atomic<long> counter(0);
+	ostringstream temporary;
+	temporary << directory_ << "/" << key << ".tmp." << getpid() << "." << ++counter;
+	string fileName = temporary.str();
+
+	ofstream output(fileName.c_str(), ios::out | ios::binary);
+	BytecodeFile::write(output, result.code, result.memorySize);
+	output.close();
+	if(!output || rename(fileName.c_str(), path(key).c_str()) != 0) {
+		unlink(fileName.c_str());
+		return;
+	}
+	++stores_;
+
+	size_t size = sizeof(BytecodeHeader) + result.code.size() * sizeof(BytecodeRecord);
+	lock_guard<mutex> lock(lock_);
+	totalBytes_ += size;
+	if(!scanned_ || totalBytes_ > maxBytes_) {
+		evict();
+	}
+}
+
+// Пересчет размера кэша и удаление давно не использованных записей, пока
+// размер кэша больше 90% наибольшего. Вызывается под lock_.
+void CompileCache::evict()
+{
+	struct Entry
+	{
+		time_t time;
+		size_t size;
+		string name;
+
+		bool operator<(const Entry& other) const
+		{
+			return time < other.time;
+		}
+	};
+
+	DIR* directory = opendir(directory_.c_str());
+	if(directory == 0) {
+		return;
+	}
+	vector<Entry> entries;
+	size_t total = 0;
+	const size_t suffixLength = strlen(CACHE_SUFFIX);
+	while(dirent* item = readdir(directory)) {
+		string name = item->d_name;
+		if(name.size() <= suffixLength
+			|| name.compare(name.size() - suffixLength, suffixLength, CACHE_SUFFIX) != 0) {
+			continue;
+		}
+		struct stat info;
+		string fileName = directory_ + "/" + name;
+		if(stat(fileName.c_str(), &info) != 0) {
+			continue;
+		}
+		Entry entry = { info.st_mtime, (size_t)info.st_size, fileName };
+		entries.push_back(entry);
+		total += entry.size;
+	}
+	closedir(directory);
+
+	scanned_ = true;
+	totalBytes_ = total;
+	if(totalBytes_ <= maxBytes_) {
+		return;
+	}
+
+	sort(entries.begin(), entries.end());
+	const size_t target = maxBytes_ / 10 * 9;
+	for(size_t i = 0; i < entries.size() && totalBytes_ > target; ++i) {
+		if(unlink(entries[i].name.c_str()) == 0) {
+			++evictions_;
+		}
+		totalBytes_ -= entries[i].size;
+	}
+}
+
+void CompileCache::printStatistics(ostream& os) const
+{
+	long hits = hits_;
+	long misses = misses_;
+	os << "Cache: " << hits << " hits, " << misses << " misses";
+	if(hits + misses > 0) {
+		os << " (" << 100 * hits / (hits + misses) << "% hit rate)";
+	}
+	os << ", " << stores_ << " stored, " << evictions_ << " evicted" << endl;
+}
@@ -0,0 +1,80 @@
+#ifndef CMILAN_CACHE_H
+#define CMILAN_CACHE_H
+
+#include "compiler.h"
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+// Дисковый кэш результатов компиляции.
+//
+// Ключ записи - хеш текста программы, версии компилятора (COMPILER_VERSION)
+// и строки параметров, влияющих на код. Запись - программа в двоичном
+// формате (см. BytecodeFile), поэтому при попадании в кэш текст программы
+// не разбирается. В кэш попадают только программы без ошибок.
+//
+// Записи создаются во временном файле и переименовываются, так что
+// одновременно работающие процессы и потоки не видят неполных записей.
+// Если суммарный размер записей превышает заданный, удаляются записи,
+// которые дольше всех не использовались (время изменения файла обновляется
+// при каждом попадании).
+
+class CompileCache
+{
+public:
+	static const size_t DEFAULT_MAX_BYTES = 256 << 20;	// размер кэша по умолчанию
+
+	// Конструктор
+	//     const string& directory - каталог кэша (создается при необходимости)
+	//     size_t maxBytes - наибольший суммарный размер записей
+	explicit CompileCache(const string& directory, size_t maxBytes = DEFAULT_MAX_BYTES)
+		: directory_(directory), maxBytes_(maxBytes), totalBytes_(0), scanned_(false),
+		  hits_(0), misses_(0), stores_(0), evictions_(0)
+	{
+	}
+
+	// Ключ записи для программы из буфера [begin, end)
+	//     const string& options - параметры компиляции, влияющие на код
+	static string makeKey(const char* begin, const char* end, const string& options);
+
+	// Поиск записи. При попадании заполняет result.code и result.memorySize.
+	bool lookup(const string& key, CompileResult& result);
+
+	// Сохранение результата компиляции без ошибок
+	void store(const string& key, const CompileResult& result);
+
+	// Печать статистики попаданий и промахов
+	void printStatistics(ostream& os) const;
+
+	long getHits() const
+	{
+		return hits_;
+	}
+
+	long getMisses() const
+	{
+		return misses_;
+	}
+
+private:
+	CompileCache(const CompileCache&);
+	CompileCache& operator=(const CompileCache&);
+
+	string path(const string& key) const;
+	void evict();
+
+	const string directory_;	// каталог кэша
+	const size_t maxBytes_;		// наибольший суммарный размер записей
+	mutex lock_;			// защищает totalBytes_ и scanned_
+	size_t totalBytes_;		// суммарный размер записей (оценка)
+	bool scanned_;			// вычислен ли totalBytes_ по содержимому каталога
+	atomic<long> hits_;		// число попаданий
+	atomic<long> misses_;		// число промахов
+	atomic<long> stores_;		// число сохраненных записей
+	atomic<long> evictions_;	// число удаленных записей
+};
+
+#endif
@@ -85,7 +85,7 @@ void Command::print(int address, ostream& os)
 			break;
 	}
 
-	os << endl;
+	os << '\n';
 }
 
 void CodeGen::emit(Instruction instruction)
@@ -119,11 +119,11 @@ int CodeGen::reserve()
 	return commandBuffer_.size() - 1;
 }
 
-void CodeGen::flush()
+void CodeGen::flush(ostream& output)
 {
 	int count = commandBuffer_.size();
 	for(int address = 0; address < count; ++address) {
-		commandBuffer_[address].print(address, output_);
+		commandBuffer_[address].print(address, output);
 	}
-	output_.flush();
+	output.flush();
 }
@@ -52,6 +52,18 @@ public:
 	//     ostream& os - поток вывода, куда будет напечатана инструкция
 	void print(int address, ostream& os);
 
+	// Код инструкции
+	Instruction getInstruction() const
+	{
+		return instruction_;
+	}
+
+	// Аргумент инструкции
+	int getArg() const
+	{
+		return arg_;
+	}
+
 private:
 	Instruction instruction_; // Код инструкции
 	int arg_;				  // Аргумент инструкции
@@ -66,8 +78,7 @@ private:
 class CodeGen
 {
 public:
-	explicit CodeGen(ostream& output)
-		: output_(output)
+	CodeGen()
 	{
 	}
 
@@ -89,11 +100,23 @@ public:
 	// Формирование "пустой" инструкции (NOP) и возврат ее адреса
 	int reserve();
 	
-	// Запись последовательности инструкций в выходной поток
-	void flush();
+	// Запись последовательности инструкций в поток вывода output
+	void flush(ostream& output);
+
+	// Сформированная программа
+	const vector<Command>& getCommands() const
+	{
+		return commandBuffer_;
+	}
+
+	// Передача сформированной программы в commands без копирования
+	// (буфер инструкций получает прежнее содержимое commands)
+	void swapCommands(vector<Command>& commands)
+	{
+		commandBuffer_.swap(commands);
+	}
 
 private:
-	ostream& output_;               // Выходной поток
 	vector<Command> commandBuffer_;	// Буфер инструкций
 };
 
@@ -0,0 +1,23 @@
+#include "compiler.h"
+
+bool Compiler::compile(const char* begin, const char* end, CompileResult& result,
+	const string& fileName) const
+{
+	Parser parser(fileName, begin, end);
+	parser.setLexMode(lexMode_);
+	Optimizer optimizer;
+	if(optimize_) {
+		optimizer.setVerify(verify_);
+		parser.setOptimizer(&optimizer);
+	}
+	bool ok = parser.compile();
+
+	result.code.clear();
+	if(ok) {
+		parser.takeCode(result.code);
+	}
+	result.diagnostics = parser.getDiagnostics();
+	result.memorySize = parser.getMemorySize();
+	result.passTimes = optimizer.getTimes();
+	return ok;
+}
@@ -0,0 +1,97 @@
+#ifndef CMILAN_COMPILER_H
+#define CMILAN_COMPILER_H
+
+#include "parser.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Интерфейс библиотеки компилятора Милана (libcmilan).
+//
+// Компилирует программу, текст которой находится в памяти, и возвращает код
+// для виртуальной машины вместе с сообщениями об ошибках. Потоки ввода-вывода
+// при компиляции не используются. Компиляторы не разделяют изменяемых данных,
+// поэтому можно одновременно компилировать программы в разных потоках, если
+// каждый поток использует свой экземпляр CompileResult.
+
+// Версия компилятора. Изменяется при любом изменении формируемого кода,
+// так как входит в ключ кэша результатов компиляции (см. CompileCache).
+static const char* const COMPILER_VERSION = "cmilan-1";
+
+// Результат компиляции
+struct CompileResult
+{
+	CompileResult()
+		: memorySize(0)
+	{
+	}
+
+	vector<Command> code;			// программа (пуста, если есть ошибки)
+	vector<Diagnostic> diagnostics;		// сообщения об ошибках
+	int memorySize;				// число слов памяти данных, занятых переменными и массивами
+	vector<PassTime> passTimes;		// время работы этапов оптимизатора (с оптимизацией)
+
+	bool ok() const
+	{
+		return diagnostics.empty();
+	}
+};
+
+class Compiler
+{
+public:
+	Compiler()
+		: lexMode_(LEX_ON_DEMAND), optimize_(false), verify_(false)
+	{
+	}
+
+	// Способ получения лексем парсером (на формируемый код не влияет)
+	void setLexMode(LexMode mode)
+	{
+		lexMode_ = mode;
+	}
+
+	// Оптимизация кода (см. Optimizer)
+	void setOptimize(bool optimize)
+	{
+		optimize_ = optimize;
+	}
+
+	// Проверка промежуточного представления после каждого прохода оптимизатора
+	void setVerify(bool verify)
+	{
+		verify_ = verify;
+	}
+
+	// Компиляция программы из буфера [begin, end). Результат записывается
+	// в result, память, выделенная в result ранее, используется повторно.
+	// За концом текста должен находиться нулевой байт (*end == '\0'), как
+	// в string и MappedFile: текст разбирается на месте, без копирования.
+	// Возвращает true, если ошибок не найдено.
+	//     const string& fileName - имя программы для сообщений
+	bool compile(const char* begin, const char* end, CompileResult& result,
+		const string& fileName = "<input>") const;
+
+	// Параметры компиляции, влияющие на формируемый код (для ключа кэша)
+	string getOptions() const
+	{
+		return optimize_ ? string("-O ") + OPTIMIZER_VERSION : string();
+	}
+
+	// Компиляция программы из строки
+	bool compile(const string& source, CompileResult& result,
+		const string& fileName = "<input>") const
+	{
+		return compile(source.data(), source.data() + source.size(), result, fileName);
+	}
+
+private:
+	LexMode lexMode_;	// способ получения лексем
+	bool optimize_;		// оптимизировать ли код
+	bool verify_;		// проверять ли промежуточное представление
+};
+
+#endif
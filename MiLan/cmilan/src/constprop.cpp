@@ -0,0 +1,306 @@
+#include "constprop.h"
+
+bool ConstantPropagation::run(IrFunction& function)
+{
+	int count = function.getInstrCount();
+	state_.assign(count, UNDEFINED);
+	value_.assign(count, 0);
+	executable_.assign(function.getBlockCount(), 0);
+	edges_.clear();
+	blockWork_.clear();
+	instrWork_.clear();
+
+	IrBlock* entry = function.getEntry();
+	executable_[entry->id] = 1;
+	blockWork_.push_back(entry);
+	while(!blockWork_.empty() || !instrWork_.empty()) {
+		if(!blockWork_.empty()) {
+			IrBlock* block = blockWork_.back();
+			blockWork_.pop_back();
+			for(size_t i = 0; i < block->instrs.size(); ++i) {
+				visit(block->instrs[i]);
+			}
+			continue;
+		}
+		IrInstr* instr = instrWork_.back();
+		instrWork_.pop_back();
+		if(instr->block != 0 && executable_[instr->block->id]) {
+			visit(instr);
+		}
+	}
+
+	bool changed = rewrite(function);
+	while(simplify(function)) {
+		changed = true;
+	}
+	return changed;
+}
+
+void ConstantPropagation::markEdge(IrBlock* from, IrBlock* to)
+{
+	char& edge = edges_[make_pair(from->id, to->id)];
+	if(edge) {
+		return;
+	}
+	edge = 1;
+	if(!executable_[to->id]) {
+		executable_[to->id] = 1;
+		blockWork_.push_back(to);
+		return;
+	}
+	// Новый операнд phi-функций уже достижимого блока
+	for(size_t i = 0; i < to->instrs.size() && to->instrs[i]->opcode == IR_PHI; ++i) {
+		instrWork_.push_back(to->instrs[i]);
+	}
+}
+
+void ConstantPropagation::visit(IrInstr* instr)
+{
+	IrBlock* block = instr->block;
+	switch(instr->opcode) {
+		case IR_JUMP:
+			markEdge(block, block->succs[0]);
+			return;
+
+		case IR_BRANCH: {
+			IrInstr* condition = instr->operands[0];
+			if(state_[condition->id] == CONSTANT) {
+				markEdge(block, block->succs[(value_[condition->id] != 0) ? 0 : 1]);
+			}
+			else if(state_[condition->id] == VARYING) {
+				markEdge(block, block->succs[0]);
+				markEdge(block, block->succs[1]);
+			}
+			return;
+		}
+
+		default:
+			if(instr->hasValue()) {
+				State state;
+				int value;
+				evaluate(instr, state, value);
+				setValue(instr, state, value);
+			}
+			return;
+	}
+}
+
+void ConstantPropagation::evaluate(IrInstr* instr, State& state, int& value) const
+{
+	state = VARYING;
+	value = 0;
+	switch(instr->opcode) {
+		case IR_CONST:
+			state = CONSTANT;
+			value = instr->value;
+			return;
+
+		case IR_PHI: {
+			// Пересечение значений из достижимых предшественников
+			state = UNDEFINED;
+			IrBlock* block = instr->block;
+			for(size_t i = 0; i < instr->operands.size(); ++i) {
+				map< pair<int, int>, char >::const_iterator edge
+					= edges_.find(make_pair(block->preds[i]->id, block->id));
+				if(edge == edges_.end()) {
+					continue;
+				}
+				IrInstr* operand = instr->operands[i];
+				State operandState = state_[operand->id];
+				if(operandState == UNDEFINED) {
+					continue;
+				}
+				if(operandState == VARYING
+					|| (state == CONSTANT && value != value_[operand->id])) {
+					state = VARYING;
+					return;
+				}
+				state = CONSTANT;
+				value = value_[operand->id];
+			}
+			return;
+		}
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_DIV:
+		case IR_NEG:
+		case IR_COMPARE:
+		case IR_CHECK: {
+			// Произведение с нулем равно нулю при любом другом множителе
+			if(instr->opcode == IR_MULT) {
+				for(size_t i = 0; i < 2; ++i) {
+					IrInstr* operand = instr->operands[i];
+					if(state_[operand->id] == CONSTANT && value_[operand->id] == 0) {
+						state = CONSTANT;
+						return;
+					}
+				}
+			}
+
+			state = CONSTANT;
+			for(size_t i = 0; i < instr->operands.size(); ++i) {
+				State operandState = state_[instr->operands[i]->id];
+				if(operandState == UNDEFINED) {
+					state = UNDEFINED;
+				}
+				else if(operandState == VARYING) {
+					state = VARYING;
+					return;
+				}
+			}
+			if(state == UNDEFINED) {
+				return;
+			}
+
+			int a = value_[instr->operands[0]->id];
+			int b = (instr->operands.size() > 1) ? value_[instr->operands[1]->id] : 0;
+			if(instr->opcode == IR_CHECK) {
+				// Проверка индекса, который заведомо в границах
+				value = a;
+				if(a < 0 || a >= b) {
+					state = VARYING;
+				}
+			}
+			else if(!irFold(instr->opcode, instr->value, a, b, value)) {
+				state = VARYING;
+			}
+			return;
+		}
+
+		default:
+			return;
+	}
+}
+
+void ConstantPropagation::setValue(IrInstr* instr, State state, int value)
+{
+	int id = instr->id;
+	if(state_[id] == VARYING || state == UNDEFINED) {
+		return;
+	}
+	if(state_[id] == CONSTANT) {
+		if(state == CONSTANT && value == value_[id]) {
+			return;
+		}
+		state = VARYING;
+	}
+	state_[id] = state;
+	value_[id] = value;
+	instrWork_.insert(instrWork_.end(), instr->users.begin(), instr->users.end());
+}
+
+bool ConstantPropagation::rewrite(IrFunction& function)
+{
+	bool changed = false;
+	vector<IrBlock*> blocks = function.getBlocks();
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		if(!executable_[block->id]) {
+			continue;
+		}
+
+		vector<IrInstr*> instrs = block->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			IrInstr* instr = instrs[j];
+			if(instr->isConst() || !instr->hasValue() || state_[instr->id] != CONSTANT) {
+				continue;
+			}
+			function.replaceAllUses(instr, function.constant(value_[instr->id]));
+			// Проверка индекса в границах и деление на ненулевую константу
+			// ошибки не вызывают
+			if(!instr->hasSideEffects() || instr->opcode == IR_CHECK || instr->opcode == IR_DIV) {
+				function.remove(instr);
+			}
+			changed = true;
+		}
+
+		// Переход по условию-константе (условие уже могло быть заменено
+		// константой, созданной выше, для которой состояния не вычислялись)
+		IrInstr* terminator = block->getTerminator();
+		IrInstr* condition = (terminator->opcode == IR_BRANCH) ? terminator->operands[0] : 0;
+		if(condition != 0 && (condition->isConst() || state_[condition->id] == CONSTANT)) {
+			int value = condition->isConst() ? condition->value : value_[condition->id];
+			IrBlock* other = block->succs[(value != 0) ? 1 : 0];
+			function.removeEdge(block, other);
+			function.remove(terminator);
+			function.append(block, function.newInstr(IR_JUMP));
+			changed = true;
+		}
+	}
+	if(function.removeUnreachableBlocks()) {
+		changed = true;
+	}
+	return changed;
+}
+
+// Значение, равное инструкции instr, или 0
+static IrInstr* simplified(IrInstr* instr)
+{
+	switch(instr->opcode) {
+		case IR_PHI: {
+			// Все операнды, кроме самой phi-функции, совпадают
+			IrInstr* same = 0;
+			for(size_t i = 0; i < instr->operands.size(); ++i) {
+				IrInstr* operand = instr->operands[i];
+				if(operand == instr || operand == same) {
+					continue;
+				}
+				if(same != 0) {
+					return 0;
+				}
+				same = operand;
+			}
+			return same;
+		}
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_DIV: {
+			IrInstr* left = instr->operands[0];
+			IrInstr* right = instr->operands[1];
+			int identity = (instr->opcode == IR_ADD || instr->opcode == IR_SUB) ? 0 : 1;
+			if(right->isConst() && right->value == identity) {
+				return left;
+			}
+			bool commutative = (instr->opcode == IR_ADD || instr->opcode == IR_MULT);
+			if(commutative && left->isConst() && left->value == identity) {
+				return right;
+			}
+			return 0;
+		}
+
+		case IR_NEG:
+			if(instr->operands[0]->opcode == IR_NEG) {
+				return instr->operands[0]->operands[0];
+			}
+			return 0;
+
+		default:
+			return 0;
+	}
+}
+
+bool ConstantPropagation::simplify(IrFunction& function)
+{
+	bool changed = false;
+	vector<IrBlock*>& blocks = function.getBlocks();
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		vector<IrInstr*> instrs = blocks[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			IrInstr* instr = instrs[j];
+			if(instr->block == 0) {
+				continue;
+			}
+			IrInstr* value = simplified(instr);
+			if(value != 0) {
+				function.replaceAllUses(instr, value);
+				function.remove(instr);
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
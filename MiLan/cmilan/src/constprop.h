@@ -0,0 +1,58 @@
+#ifndef CMILAN_CONSTPROP_H
+#define CMILAN_CONSTPROP_H
+
+#include "passes.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Распространение констант (sparse conditional constant propagation,
+// Wegman, Zadeck, "Constant Propagation with Conditional Branches").
+//
+// Для каждого значения вычисляется, является ли оно константой, с учетом
+// того, какие переходы могут выполняться: phi-функция учитывает только
+// операнды из достижимых предшественников. Значения-константы заменяются
+// константами, условные переходы по константе - безусловными, недостижимые
+// блоки удаляются. Кроме того, упрощаются x + 0, x - 0, x * 1, x / 1 и
+// --x.
+//
+// Деление на 0 константой не считается: оно остается в программе и
+// завершает ее с ошибкой во время исполнения.
+
+class ConstantPropagation : public IrPass
+{
+public:
+	const char* getName() const
+	{
+		return "constprop";
+	}
+
+	bool run(IrFunction& function);
+
+private:
+	// Значение в решетке: неизвестно (еще не вычислялось), константа,
+	// не константа
+	enum State
+	{
+		UNDEFINED,
+		CONSTANT,
+		VARYING
+	};
+
+	void markEdge(IrBlock* from, IrBlock* to);
+	void visit(IrInstr* instr);
+	void evaluate(IrInstr* instr, State& state, int& value) const;
+	void setValue(IrInstr* instr, State state, int value);
+	bool rewrite(IrFunction& function);
+	bool simplify(IrFunction& function);
+
+	vector<State> state_;		// состояние значения
+	vector<int> value_;		// значение константы
+	vector<char> executable_;	// блок достижим
+	map< pair<int, int>, char > edges_;	// выполнимые переходы (номера блоков)
+	vector<IrBlock*> blockWork_;	// блоки, ставшие достижимыми
+	vector<IrInstr*> instrWork_;	// инструкции, операнды которых изменились
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "csource.h"
+#include "stackdepth.h"
+#include <algorithm>
+
+// Запись целой константы. Наименьшее значение int нельзя записать литералом.
+static string intLiteral(int value)
+{
+	if(value == -2147483647 - 1) {
+		return "(-2147483647 - 1)";
+	}
+	ostringstream os;
+	os << value;
+	return os.str();
+}
+
+static const char* compareOperators[] = {"==", "!=", "<", ">", "<=", ">="};
+
+// Слово стека со смещением offset относительно первого свободного слова:
+// -1 - вершина стека, -2 - слово под ней, 0 - новое слово
+string CSourceGen::slot(int offset) const
+{
+	ostringstream os;
+	if(depth_ >= 0) {
+		os << "s[" << depth_ + offset << "]";
+	}
+	else {
+		os << "sp[" << offset << "]";
+	}
+	return os.str();
+}
+
+// Завершение программы с ошибкой status на инструкции address
+void CSourceGen::fail(int address, VmStatus status)
+{
+	code_ << "\treturn fail(" << address << ", \"" << vmStatusToString(status) << "\");\n";
+	usesFail_ = true;
+}
+
+// Проверки стека и аргумента инструкции, которые выполняет VirtualMachine.
+// Возвращает false, если инструкция всегда завершается ошибкой.
+bool CSourceGen::check(const Command& command, int address)
+{
+	const int arg = command.getArg();
+	int need = 0;
+	int room = 0;
+	VmStatus failure = VM_OK;
+
+	switch(command.getInstruction()) {
+		case NOP:
+		case STOP:
+		case JUMP:
+			break;
+
+		case LOAD:
+			room = 1;
+			if((unsigned)arg >= (unsigned)memorySize_) {
+				failure = VM_BAD_ADDRESS;
+			}
+			break;
+
+		case STORE:
+			need = 1;
+			if((unsigned)arg >= (unsigned)memorySize_) {
+				failure = VM_BAD_ADDRESS;
+			}
+			break;
+
+		case PUSH:
+		case INPUT:
+			room = 1;
+			break;
+
+		case DUP:
+			need = 1;
+			room = 1;
+			break;
+
+		case BLOAD:
+		case POP:
+		case INVERT:
+		case JUMP_YES:
+		case JUMP_NO:
+		case PRINT:
+			need = 1;
+			break;
+
+		case BSTORE:
+		case ADD:
+		case SUB:
+		case MULT:
+		case DIV:
+			need = 2;
+			break;
+
+		case COMPARE:
+			need = 2;
+			if(arg < 0 || arg > 5) {
+				failure = VM_BAD_INSTRUCTION;
+			}
+			break;
+
+		default:
+			failure = VM_BAD_INSTRUCTION;
+			break;
+	}
+
+	if(need > 0) {
+		code_ << "\tif(sp - stack < " << need << ")\n\t";
+		fail(address, VM_STACK_UNDERFLOW);
+	}
+	if(room > 0) {
+		code_ << "\tif(stack + STACK_SIZE - sp < " << room << ")\n\t";
+		fail(address, VM_STACK_OVERFLOW);
+	}
+	if(failure != VM_OK) {
+		fail(address, failure);
+		return false;
+	}
+	return true;
+}
+
+// Трансляция инструкции address. Проверки стека уже выполнены.
+void CSourceGen::generate(const vector<Command>& program, int address)
+{
+	const Command& command = program[address];
+	const Instruction instruction = command.getInstruction();
+	const int arg = command.getArg();
+	const int count = program.size();
+
+	switch(instruction) {
+		case NOP:
+		case POP:
+			break;
+
+		case STOP:
+			code_ << "\treturn EXIT_SUCCESS;\n";
+			break;
+
+		case LOAD:
+			code_ << "\t" << slot(0) << " = memory[" << arg << "];\n";
+			break;
+
+		case STORE:
+			code_ << "\tmemory[" << arg << "] = " << slot(-1) << ";\n";
+			break;
+
+		case BLOAD:
+		case BSTORE:
+			code_ << "\ta = (unsigned)" << intLiteral(arg) << " + (unsigned)" << slot(-1) << ";\n"
+				<< "\tif(a >= MEMORY_SIZE)\n\t";
+			fail(address, VM_BAD_ADDRESS);
+			if(instruction == BLOAD) {
+				code_ << "\t" << slot(-1) << " = memory[a];\n";
+			}
+			else {
+				code_ << "\tmemory[a] = " << slot(-2) << ";\n";
+			}
+			usesAddress_ = true;
+			break;
+
+		case PUSH:
+			code_ << "\t" << slot(0) << " = " << intLiteral(arg) << ";\n";
+			break;
+
+		case DUP:
+			code_ << "\t" << slot(0) << " = " << slot(-1) << ";\n";
+			break;
+
+		case ADD:
+		case SUB:
+		case MULT: {
+			const char* op = (instruction == ADD) ? "+" : (instruction == SUB) ? "-" : "*";
+			code_ << "\t" << slot(-2) << " = (int)((unsigned)" << slot(-2) << " "
+				<< op << " (unsigned)" << slot(-1) << ");\n";
+			break;
+		}
+
+		case DIV:
+			code_ << "\tif(" << slot(-1) << " == 0)\n\t";
+			fail(address, VM_DIVISION_BY_ZERO);
+			code_ << "\t" << slot(-2) << " = (" << slot(-1) << " == -1)"
+				<< " ? (int)(0u - (unsigned)" << slot(-2) << ")"
+				<< " : " << slot(-2) << " / " << slot(-1) << ";\n";
+			break;
+
+		case INVERT:
+			code_ << "\t" << slot(-1) << " = (int)(0u - (unsigned)" << slot(-1) << ");\n";
+			break;
+
+		case COMPARE:
+			code_ << "\t" << slot(-2) << " = " << slot(-2) << " "
+				<< compareOperators[arg] << " " << slot(-1) << ";\n";
+			break;
+
+		case JUMP:
+		case JUMP_YES:
+		case JUMP_NO:
+			if(instruction != JUMP) {
+				// Условие выталкивается из стека до перехода
+				code_ << "\tif(" << (instruction == JUMP_NO ? "!" : "")
+					<< (depth_ >= 0 ? slot(-1) : "*--sp") << ")\n\t";
+			}
+			if(arg >= 0 && arg < count) {
+				code_ << "\tgoto L" << arg << ";\n";
+			}
+			else {
+				fail(address, VM_ABORT);
+			}
+			return;
+
+		case INPUT:
+			code_ << "\tif(scanf(\"%d\", &" << slot(0) << ") != 1)\n\t";
+			fail(address, VM_INPUT_ERROR);
+			break;
+
+		case PRINT:
+			code_ << "\tprintf(\"%d\\n\", " << slot(-1) << ");\n";
+			break;
+	}
+
+	int effect = StackDepth::getEffect(instruction);
+	if(depth_ < 0 && effect != 0) {
+		code_ << "\tsp += " << effect << ";\n";
+	}
+}
+
+void CSourceGen::generate(const vector<Command>& program)
+{
+	const int count = program.size();
+	StackDepth analysis(program, memorySize_, stackSize_);
+	const bool constantDepth = analysis.analyze();
+
+	// Метки нужны только адресам, на которые есть переходы
+	vector<bool> targets(count, false);
+	for(int address = 0; address < count; ++address) {
+		const Command& command = program[address];
+		if(StackDepth::isJump(command.getInstruction()) && analysis.isValidTarget(command.getArg())
+			&& (!constantDepth || analysis.getDepth(address) >= 0)) {
+			targets[command.getArg()] = true;
+		}
+	}
+
+	// Инструкции транслируются в порядке адресов; недостижимые инструкции
+	// при постоянной глубине стека пропускаются.
+	bool fallsThrough = true;
+	for(int address = 0; address < count; ++address) {
+		depth_ = constantDepth ? analysis.getDepth(address) : -1;
+		if(constantDepth && depth_ < 0) {
+			fallsThrough = false;
+			continue;
+		}
+		if(targets[address]) {
+			code_ << "L" << address << ": ;\n";
+		}
+
+		Instruction instruction = program[address].getInstruction();
+		fallsThrough = (instruction != STOP && instruction != JUMP);
+		if(constantDepth) {
+			VmStatus failure = analysis.getFailure(address);
+			if(failure != VM_OK) {
+				fail(address, failure);
+				fallsThrough = false;
+				continue;
+			}
+		}
+		else if(!check(program[address], address)) {
+			fallsThrough = false;
+			continue;
+		}
+		generate(program, address);
+	}
+
+	// Выход за конец программы
+	if(fallsThrough) {
+		fail(max(count - 1, 0), VM_ABORT);
+	}
+
+	output_ << "/* Программа виртуальной машины Милана, оттранслированная cmilan --emit-c */\n\n"
+		<< "#include <stdio.h>\n"
+		<< "#include <stdlib.h>\n\n"
+		<< "#define MEMORY_SIZE " << memorySize_ << "u\n";
+	if(!constantDepth) {
+		output_ << "#define STACK_SIZE " << stackSize_ << "\n";
+	}
+	output_ << "\nstatic int memory[MEMORY_SIZE];\n";
+	if(!constantDepth) {
+		output_ << "static int stack[STACK_SIZE];\n";
+	}
+	if(usesFail_) {
+		output_ << "\nstatic int fail(int address, const char* message)\n"
+			<< "{\n"
+			<< "\tfflush(stdout);\n"
+			<< "\tfprintf(stderr, \"Runtime error at address %d: %s\\n\", address, message);\n"
+			<< "\treturn EXIT_FAILURE;\n"
+			<< "}\n";
+	}
+	output_ << "\nint main(void)\n{\n";
+	if(constantDepth) {
+		output_ << "\tint s[" << max(analysis.getMaxDepth(), 1) << "];\n";
+	}
+	else {
+		output_ << "\tint* sp = stack;\n";
+	}
+	if(usesAddress_) {
+		output_ << "\tunsigned a;\n";
+	}
+	output_ << "\n" << code_.str() << "}\n";
+	output_.flush();
+}
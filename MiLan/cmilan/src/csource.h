@@ -0,0 +1,63 @@
+#ifndef CMILAN_CSOURCE_H
+#define CMILAN_CSOURCE_H
+
+#include "codegen.h"
+#include "vm.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+using namespace std;
+
+// Трансляция программы виртуальной машины Милана в исходный текст на C.
+//
+// Результат - самостоятельная единица трансляции, которую можно собрать
+// системным компилятором (например, cc -O2) в исполняемый файл. Память данных
+// становится статическим массивом, стек - массивом, адреса, на которые есть
+// переходы, - метками функции main.
+//
+// Если глубина стека в каждой точке программы постоянна (см. StackDepth),
+// стек - локальный массив, слова которого адресуются постоянными индексами,
+// поэтому компилятор C может разместить их в регистрах, а проверки стека
+// выполняются при трансляции. Иначе (например, при присваивании массивов,
+// которое копирует элементы через стек) используется указатель стека
+// с проверками во время исполнения.
+//
+// Семантика совпадает с VirtualMachine: STOP завершает программу с кодом
+// EXIT_SUCCESS, переход за пределы программы (JUMP -1) и другие ошибки
+// печатают сообщение "Runtime error at address N: ..." и завершают программу
+// с кодом EXIT_FAILURE.
+
+class CSourceGen
+{
+public:
+	// Конструктор
+	//     ostream& output - поток, в который записывается текст на C
+	CSourceGen(ostream& output,
+		int memorySize = VirtualMachine::DEFAULT_MEMORY_SIZE,
+		int stackSize = VirtualMachine::DEFAULT_STACK_SIZE)
+		: output_(output), memorySize_(memorySize), stackSize_(stackSize),
+		  depth_(-1), usesFail_(false), usesAddress_(false)
+	{
+	}
+
+	// Запись программы в выходной поток
+	void generate(const vector<Command>& program);
+
+private:
+	void generate(const vector<Command>& program, int address);
+	bool check(const Command& command, int address);
+	string slot(int offset) const;
+	void fail(int address, VmStatus status);
+
+	ostream& output_;	// выходной поток
+	int memorySize_;	// размер памяти данных в словах
+	int stackSize_;		// размер стека в словах
+	ostringstream code_;	// тело функции main
+	int depth_;		// глубина стека перед текущей инструкцией (-1 - не постоянна)
+	bool usesFail_;		// есть ли в программе проверки ошибок
+	bool usesAddress_;	// есть ли в программе BLOAD или BSTORE
+};
+
+#endif
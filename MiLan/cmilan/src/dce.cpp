@@ -0,0 +1,230 @@
+#include "dce.h"
+
+bool DeadCodeElimination::run(IrFunction& function)
+{
+	bool changed = false;
+	for(;;) {
+		bool round = removeDeadStores(function);
+		if(removeDeadInstrs(function)) {
+			round = true;
+		}
+		if(foldBranches(function)) {
+			round = true;
+		}
+		if(!round) {
+			break;
+		}
+		changed = true;
+	}
+	return changed;
+}
+
+bool DeadCodeElimination::removeDeadInstrs(IrFunction& function)
+{
+	vector<IrBlock*>& blocks = function.getBlocks();
+	vector<char> needed(function.getInstrCount(), 0);
+	vector<IrInstr*> work;
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		const vector<IrInstr*>& instrs = blocks[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			if(instrs[j]->hasSideEffects()) {
+				needed[instrs[j]->id] = 1;
+				work.push_back(instrs[j]);
+			}
+		}
+	}
+	while(!work.empty()) {
+		IrInstr* instr = work.back();
+		work.pop_back();
+		for(size_t i = 0; i < instr->operands.size(); ++i) {
+			IrInstr* operand = instr->operands[i];
+			if(!needed[operand->id]) {
+				needed[operand->id] = 1;
+				work.push_back(operand);
+			}
+		}
+	}
+
+	// Ненужные инструкции используются только ненужными: сначала
+	// отбрасываются их операнды, затем сами инструкции
+	vector<IrInstr*> dead;
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		const vector<IrInstr*>& instrs = blocks[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			if(!needed[instrs[j]->id]) {
+				dead.push_back(instrs[j]);
+			}
+		}
+	}
+	for(size_t i = 0; i < dead.size(); ++i) {
+		while(!dead[i]->operands.empty()) {
+			function.removeOperand(dead[i], dead[i]->operands.size() - 1);
+		}
+	}
+	for(size_t i = 0; i < dead.size(); ++i) {
+		function.remove(dead[i]);
+	}
+	return !dead.empty();
+}
+
+void DeadCodeElimination::transfer(const IrInstr* instr, vector<char>& live) const
+{
+	map<int, int>::const_iterator cell;
+	switch(instr->opcode) {
+		case IR_STORE:
+			live[cells_.find(instr->value)->second] = 0;
+			break;
+
+		case IR_LOAD:
+			cell = cells_.find(instr->value);
+			if(cell != cells_.end()) {
+				live[cell->second] = 1;
+			}
+			break;
+
+		case IR_RAW:
+			live.assign(live.size(), 1);
+			break;
+
+		default:
+			break;
+	}
+}
+
+bool DeadCodeElimination::removeDeadStores(IrFunction& function)
+{
+	vector<IrBlock*>& blocks = function.getBlocks();
+	cells_.clear();
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		const vector<IrInstr*>& instrs = blocks[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			if(instrs[j]->opcode == IR_STORE && cells_.count(instrs[j]->value) == 0) {
+				int index = cells_.size();
+				cells_[instrs[j]->value] = index;
+			}
+		}
+	}
+	if(cells_.empty()) {
+		return false;
+	}
+
+	// Ячейки, которые могут быть прочитаны после начала блока; после
+	// остановки программы память не читается
+	vector<IrBlock*> order;
+	function.getReversePostorder(order);
+	vector< vector<char> > liveIn(function.getBlockCount(), vector<char>(cells_.size(), 0));
+	vector<char> live;
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(size_t i = order.size(); i-- > 0;) {
+			IrBlock* block = order[i];
+			live.assign(cells_.size(), 0);
+			for(size_t j = 0; j < block->succs.size(); ++j) {
+				const vector<char>& succ = liveIn[block->succs[j]->id];
+				for(size_t k = 0; k < live.size(); ++k) {
+					live[k] |= succ[k];
+				}
+			}
+			for(size_t j = block->instrs.size(); j-- > 0;) {
+				transfer(block->instrs[j], live);
+			}
+			if(live != liveIn[block->id]) {
+				liveIn[block->id] = live;
+				changed = true;
+			}
+		}
+	}
+
+	bool removed = false;
+	for(size_t i = 0; i < order.size(); ++i) {
+		IrBlock* block = order[i];
+		live.assign(cells_.size(), 0);
+		for(size_t j = 0; j < block->succs.size(); ++j) {
+			const vector<char>& succ = liveIn[block->succs[j]->id];
+			for(size_t k = 0; k < live.size(); ++k) {
+				live[k] |= succ[k];
+			}
+		}
+		vector<IrInstr*> instrs = block->instrs;
+		for(size_t j = instrs.size(); j-- > 0;) {
+			IrInstr* instr = instrs[j];
+			if(instr->opcode == IR_STORE && !live[cells_[instr->value]]) {
+				function.remove(instr);
+				removed = true;
+				continue;
+			}
+			transfer(instr, live);
+		}
+	}
+	return removed;
+}
+
+// Блок, через который ветвь from проходит без вычислений: блок из одного
+// перехода с единственным предшественником from заменяется своим преемником
+// (блок из одной команды STOP преемников не имеет)
+static IrBlock* forward(IrBlock* from, IrBlock* block)
+{
+	if(block->instrs.size() == 1 && block->instrs[0]->opcode == IR_JUMP
+		&& block->succs.size() == 1 && block->preds.size() == 1 && block->preds[0] == from
+		&& block->succs[0] != block) {
+		return block->succs[0];
+	}
+	return block;
+}
+
+// Номер дуги, по которой ветвь из from через block входит в target
+static int predIndex(IrBlock* from, IrBlock* block, IrBlock* target)
+{
+	IrBlock* pred = (block == target) ? from : block;
+	for(size_t i = 0; i < target->preds.size(); ++i) {
+		if(target->preds[i] == pred) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool DeadCodeElimination::foldBranches(IrFunction& function)
+{
+	bool changed = false;
+	vector<IrBlock*>& blocks = function.getBlocks();
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		IrInstr* terminator = block->getTerminator();
+		if(terminator->opcode != IR_BRANCH || block->succs[0] == block->succs[1]) {
+			continue;
+		}
+		IrBlock* yes = block->succs[0];
+		IrBlock* no = block->succs[1];
+		IrBlock* target = forward(block, yes);
+		if(forward(block, no) != target) {
+			continue;
+		}
+
+		int yesIndex = predIndex(block, yes, target);
+		int noIndex = predIndex(block, no, target);
+		bool same = true;
+		for(size_t j = 0; j < target->instrs.size() && target->instrs[j]->opcode == IR_PHI; ++j) {
+			IrInstr* phi = target->instrs[j];
+			if(phi->operands[yesIndex] != phi->operands[noIndex]) {
+				same = false;
+				break;
+			}
+		}
+		if(!same) {
+			continue;
+		}
+
+		// Остается ветвь, которая ведет прямо в target (если такая есть)
+		IrBlock* dropped = (no == target) ? yes : no;
+		function.removeEdge(block, dropped);
+		function.remove(terminator);
+		function.append(block, function.newInstr(IR_JUMP));
+		changed = true;
+	}
+	if(function.removeUnreachableBlocks()) {
+		changed = true;
+	}
+	return changed;
+}
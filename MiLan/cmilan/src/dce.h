@@ -0,0 +1,46 @@
+#ifndef CMILAN_DCE_H
+#define CMILAN_DCE_H
+
+#include "passes.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Удаление мертвого кода и мертвых записей в память.
+//
+// Инструкция нужна, если у нее есть побочный эффект (ввод-вывод, запись,
+// проверка индекса, деление, которое может вызвать ошибку, переход) или ее
+// значение использует нужная инструкция; остальные удаляются, в том числе
+// phi-функции, которые используют только друг друга (переменная, значение
+// которой не читается).
+//
+// Запись в ячейку памяти (IR_STORE) удаляется, если ни на одном пути от нее
+// ячейка не читается до следующей записи в нее или до конца программы.
+// Фрагменты кода (IR_RAW) считаются читающими все ячейки.
+//
+// Ветвление, обе ветви которого ведут в один блок через пустые блоки и
+// передают в его phi-функции одинаковые значения, заменяется переходом;
+// недостижимые блоки удаляются. Порядок оставшихся инструкций не меняется,
+// поэтому ввод и вывод выполняются в прежней последовательности.
+
+class DeadCodeElimination : public IrPass
+{
+public:
+	const char* getName() const
+	{
+		return "dce";
+	}
+
+	bool run(IrFunction& function);
+
+private:
+	bool removeDeadInstrs(IrFunction& function);
+	bool removeDeadStores(IrFunction& function);
+	bool foldBranches(IrFunction& function);
+	void transfer(const IrInstr* instr, vector<char>& live) const;	// живые ячейки до инструкции
+
+	map<int, int> cells_;		// номера ячеек, в которые выполняется запись
+};
+
+#endif
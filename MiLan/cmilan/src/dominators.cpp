@@ -0,0 +1,126 @@
+#include "dominators.h"
+#include <algorithm>
+
+DominatorTree::DominatorTree(IrFunction& function)
+{
+	function.getReversePostorder(order_);
+	int count = function.getBlockCount();
+	number_.assign(count, -1);
+	for(size_t i = 0; i < order_.size(); ++i) {
+		number_[order_[i]->id] = i;
+	}
+
+	// Доминатор блока - ближайший общий доминатор его обработанных
+	// предшественников; повторяется до стабилизации
+	vector<int> idom(order_.size(), -1);
+	idom[0] = 0;
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(size_t i = 1; i < order_.size(); ++i) {
+			const vector<IrBlock*>& preds = order_[i]->preds;
+			int result = -1;
+			for(size_t j = 0; j < preds.size(); ++j) {
+				int pred = number_[preds[j]->id];
+				if(pred < 0 || idom[pred] < 0) {
+					continue;
+				}
+				if(result < 0) {
+					result = pred;
+					continue;
+				}
+				int other = pred;
+				while(result != other) {
+					while(result > other) {
+						result = idom[result];
+					}
+					while(other > result) {
+						other = idom[other];
+					}
+				}
+			}
+			if(idom[i] != result) {
+				idom[i] = result;
+				changed = true;
+			}
+		}
+	}
+
+	idom_.assign(count, 0);
+	children_.assign(count, vector<IrBlock*>());
+	for(size_t i = 1; i < order_.size(); ++i) {
+		IrBlock* parent = order_[idom[i]];
+		idom_[order_[i]->id] = parent;
+		children_[parent->id].push_back(order_[i]);
+	}
+
+	// Нумерация вершин дерева при обходе в глубину: a доминирует над b,
+	// если b посещается во время обхода поддерева a
+	enter_.assign(count, 0);
+	leave_.assign(count, 0);
+	int time = 0;
+	vector< pair<IrBlock*, size_t> > stack;
+	stack.push_back(make_pair(order_[0], (size_t)0));
+	enter_[order_[0]->id] = time++;
+	while(!stack.empty()) {
+		IrBlock* block = stack.back().first;
+		size_t next = stack.back().second;
+		if(next < children_[block->id].size()) {
+			++stack.back().second;
+			IrBlock* child = children_[block->id][next];
+			enter_[child->id] = time++;
+			stack.push_back(make_pair(child, (size_t)0));
+		}
+		else {
+			leave_[block->id] = time++;
+			stack.pop_back();
+		}
+	}
+}
+
+bool DominatorTree::dominates(const IrBlock* a, const IrBlock* b) const
+{
+	if(!isReachable(a) || !isReachable(b)) {
+		return false;
+	}
+	return enter_[a->id] <= enter_[b->id] && leave_[b->id] <= leave_[a->id];
+}
+
+bool DominatorTree::dominates(const IrInstr* a, const IrInstr* b) const
+{
+	if(a->block != b->block) {
+		return dominates(a->block, b->block);
+	}
+	const vector<IrInstr*>& instrs = a->block->instrs;
+	return find(instrs.begin(), instrs.end(), a) <= find(instrs.begin(), instrs.end(), b);
+}
+
+bool DominatorTree::findLoop(const IrBlock* header, vector<char>& inLoop) const
+{
+	vector<IrBlock*> work;
+	for(size_t i = 0; i < header->preds.size(); ++i) {
+		if(dominates(header, header->preds[i])) {
+			work.push_back(header->preds[i]);
+		}
+	}
+	if(work.empty()) {
+		return false;
+	}
+
+	inLoop.assign(idom_.size(), 0);
+	inLoop[header->id] = 1;
+	while(!work.empty()) {
+		IrBlock* block = work.back();
+		work.pop_back();
+		if(inLoop[block->id]) {
+			continue;
+		}
+		inLoop[block->id] = 1;
+		for(size_t i = 0; i < block->preds.size(); ++i) {
+			if(isReachable(block->preds[i])) {
+				work.push_back(block->preds[i]);
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#ifndef CMILAN_DOMINATORS_H
+#define CMILAN_DOMINATORS_H
+
+#include "ir.h"
+#include <vector>
+
+using namespace std;
+
+// Дерево доминаторов графа потока управления (алгоритм Cooper, Harvey,
+// Kennedy, "A Simple, Fast Dominance Algorithm").
+//
+// Блок A доминирует над блоком B, если любой путь от входного блока к B
+// проходит через A. Дерево строится для блоков, достижимых из входного;
+// после изменения графа его нужно построить заново.
+
+class DominatorTree
+{
+public:
+	explicit DominatorTree(IrFunction& function);
+
+	// Достижимые блоки в обратном порядке после обхода в глубину
+	// (каждый блок следует за своим непосредственным доминатором)
+	const vector<IrBlock*>& getOrder() const
+	{
+		return order_;
+	}
+
+	// Непосредственный доминатор (0 для входного и недостижимых блоков)
+	IrBlock* getIdom(const IrBlock* block) const
+	{
+		return idom_[block->id];
+	}
+
+	// Блоки, непосредственным доминатором которых является block
+	const vector<IrBlock*>& getChildren(const IrBlock* block) const
+	{
+		return children_[block->id];
+	}
+
+	// Достижим ли блок из входного
+	bool isReachable(const IrBlock* block) const
+	{
+		return number_[block->id] >= 0;
+	}
+
+	// Доминирует ли a над b (блок доминирует сам над собой)
+	bool dominates(const IrBlock* a, const IrBlock* b) const;
+
+	// Доминирует ли инструкция a над инструкцией b (определение a
+	// выполняется раньше b на любом пути к b)
+	bool dominates(const IrInstr* a, const IrInstr* b) const;
+
+	// Тело цикла с заголовком header: блоки, из которых обратная дуга
+	// (переход в header из блока, над которым он доминирует) достижима
+	// без прохода через заголовок. Возвращает false, если обратных дуг нет.
+	bool findLoop(const IrBlock* header, vector<char>& inLoop) const;
+
+private:
+	vector<IrBlock*> order_;		// обратный порядок после обхода
+	vector<int> number_;			// номер блока в order_ (-1 - недостижим)
+	vector<IrBlock*> idom_;			// непосредственные доминаторы
+	vector< vector<IrBlock*> > children_;	// дети в дереве доминаторов
+	vector<int> enter_;			// время входа при обходе дерева
+	vector<int> leave_;			// время выхода при обходе дерева
+};
+
+#endif
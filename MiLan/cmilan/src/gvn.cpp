@@ -0,0 +1,275 @@
+#include "gvn.h"
+#include <algorithm>
+
+// Коды сравнения команды COMPARE, не зависящие от порядка операндов
+enum
+{
+	CMP_EQ,
+	CMP_NE
+};
+
+bool GlobalValueNumbering::Key::operator<(const Key& other) const
+{
+	if(opcode != other.opcode) {
+		return opcode < other.opcode;
+	}
+	if(value != other.value) {
+		return value < other.value;
+	}
+	if(left != other.left) {
+		return left < other.left;
+	}
+	return right < other.right;
+}
+
+// Выражение, которое вычисляет инструкция; false, если повторное
+// вычисление может дать другой результат
+static bool makeKey(const IrInstr* instr, const vector<int>& number, int& left, int& right)
+{
+	left = (instr->operands.size() > 0) ? number[instr->operands[0]->id] : -1;
+	right = (instr->operands.size() > 1) ? number[instr->operands[1]->id] : -1;
+	switch(instr->opcode) {
+		case IR_ADD:
+		case IR_MULT:
+			break;
+
+		case IR_COMPARE:
+			if(instr->value != CMP_EQ && instr->value != CMP_NE) {
+				return true;
+			}
+			break;
+
+		case IR_SUB:
+		case IR_DIV:
+		case IR_NEG:
+		case IR_CHECK:
+		case IR_LOAD:
+		case IR_BLOAD:
+			return true;
+
+		default:
+			return false;
+	}
+	// Операция коммутативна
+	if(left > right) {
+		swap(left, right);
+	}
+	return true;
+}
+
+// Повторное вычисление не дороже хранения значения во временной ячейке:
+// чтение ячейки или операция над значениями, которые не нужно вычислять
+// (виртуальная машина выполняет LOAD x; PUSH c; ADD как одну команду)
+static bool isCheap(const IrInstr* instr)
+{
+	switch(instr->opcode) {
+		case IR_LOAD:
+			return true;
+
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_NEG:
+		case IR_COMPARE:
+			break;
+
+		default:
+			return false;
+	}
+	for(size_t i = 0; i < instr->operands.size(); ++i) {
+		IrOpcode opcode = instr->operands[i]->opcode;
+		if(opcode != IR_CONST && opcode != IR_PHI && opcode != IR_LOAD && opcode != IR_INPUT) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Индекс, который виртуальная машина получает не дороже, чем значение из
+// временной ячейки
+static bool isCheapIndex(const IrInstr* index)
+{
+	IrOpcode opcode = index->opcode;
+	return opcode == IR_CONST || opcode == IR_PHI || opcode == IR_LOAD || opcode == IR_INPUT
+		|| isCheap(index);
+}
+
+bool GlobalValueNumbering::run(IrFunction& function)
+{
+	function_ = &function;
+	DominatorTree dominators(function);
+	table_.clear();
+	changes_.clear();
+	number_.resize(function.getInstrCount());
+	for(size_t i = 0; i < number_.size(); ++i) {
+		number_[i] = i;
+	}
+
+	// Обход дерева доминаторов в глубину; для каждого блока запоминается
+	// размер журнала изменений таблицы до его обработки
+	bool changed = false;
+	vector< pair<IrBlock*, size_t> > stack;
+	vector<size_t> marks;
+	stack.push_back(make_pair(function.getEntry(), (size_t)0));
+	marks.push_back(0);
+	if(visit(function.getEntry())) {
+		changed = true;
+	}
+	while(!stack.empty()) {
+		IrBlock* block = stack.back().first;
+		size_t next = stack.back().second;
+		const vector<IrBlock*>& children = dominators.getChildren(block);
+		if(next < children.size()) {
+			++stack.back().second;
+			stack.push_back(make_pair(children[next], (size_t)0));
+			marks.push_back(changes_.size());
+			if(visit(children[next])) {
+				changed = true;
+			}
+		}
+		else {
+			undo(marks.back());
+			marks.pop_back();
+			stack.pop_back();
+		}
+	}
+	function_ = 0;
+	return changed;
+}
+
+bool GlobalValueNumbering::visit(IrBlock* block)
+{
+	bool changed = false;
+	vector<IrInstr*> instrs = block->instrs;
+	for(size_t i = 0; i < instrs.size(); ++i) {
+		IrInstr* instr = instrs[i];
+		Key key;
+
+		// Записанное значение известно до следующей записи
+		if(instr->opcode == IR_STORE || instr->opcode == IR_BSTORE) {
+			key.opcode = (instr->opcode == IR_STORE) ? IR_LOAD : IR_BLOAD;
+			key.value = instr->value;
+			key.left = (instr->opcode == IR_STORE) ? -1 : number_[instr->operands[1]->id];
+			key.right = -1;
+			define(key, instr->operands[0], instr);
+			continue;
+		}
+
+		key.opcode = instr->opcode;
+		key.value = instr->value;
+		if(!makeKey(instr, number_, key.left, key.right)) {
+			continue;
+		}
+		if(instr->opcode == IR_CHECK) {
+			// Значение проверки равно индексу
+			number_[instr->id] = number_[instr->operands[0]->id];
+		}
+		map<Key, Entry>::iterator found = table_.find(key);
+		if(found == table_.end()) {
+			define(key, instr, instr);
+			continue;
+		}
+		bool memory = (instr->opcode == IR_LOAD || instr->opcode == IR_BLOAD);
+		if(memory && clobbered(found->second.position, instr)) {
+			define(key, instr, instr);
+			continue;
+		}
+		if(isCheap(instr)) {
+			// Инструкция остается, но выражения с ней совпадают с выражениями
+			// с найденным значением
+			number_[instr->id] = number_[found->second.value->id];
+			continue;
+		}
+		if(instr->opcode == IR_BLOAD && found->second.position->block != block
+			&& isCheapIndex(instr->operands[0])) {
+			// Значение, сохраненное в другом блоке, хранилось бы во временной
+			// ячейке и на путях, где не используется: элемент с простым
+			// индексом читается заново
+			number_[instr->id] = number_[found->second.value->id];
+			define(key, instr, instr);
+			continue;
+		}
+		// Индекс повторной проверки остается там, где вычислен
+		function_->replaceAllUses(instr, (instr->opcode == IR_CHECK) ? instr->operands[0] : found->second.value);
+		function_->remove(instr);
+		changed = true;
+	}
+	return changed;
+}
+
+void GlobalValueNumbering::define(const Key& key, IrInstr* value, IrInstr* position)
+{
+	Change change;
+	change.key = key;
+	map<Key, Entry>::iterator found = table_.find(key);
+	change.existed = (found != table_.end());
+	if(change.existed) {
+		change.old = found->second;
+	}
+	changes_.push_back(change);
+
+	Entry& entry = table_[key];
+	entry.value = value;
+	entry.position = position;
+}
+
+void GlobalValueNumbering::undo(size_t size)
+{
+	while(changes_.size() > size) {
+		const Change& change = changes_.back();
+		if(change.existed) {
+			table_[change.key] = change.old;
+		}
+		else {
+			table_.erase(change.key);
+		}
+		changes_.pop_back();
+	}
+}
+
+// Может ли память, прочитанная reader, измениться между инструкцией from
+// и reader (блок from доминирует над блоком reader)
+bool GlobalValueNumbering::clobbered(IrInstr* from, IrInstr* reader) const
+{
+	IrBlock* start = from->block;
+	IrBlock* end = reader->block;
+	const vector<IrInstr*>& first = start->instrs;
+	size_t fromIndex = find(first.begin(), first.end(), from) - first.begin();
+	size_t readerIndex = find(end->instrs.begin(), end->instrs.end(), reader) - end->instrs.begin();
+	if(start == end) {
+		return clobberedIn(start, fromIndex + 1, readerIndex, reader);
+	}
+	if(clobberedIn(start, fromIndex + 1, first.size(), reader)
+		|| clobberedIn(end, 0, readerIndex, reader)) {
+		return true;
+	}
+
+	// Блоки на путях из start в end: из них end достижим без прохода
+	// через start (повторный вход в start снова выполнил бы from)
+	vector<char> visited(function_->getBlockCount(), 0);
+	vector<IrBlock*> work(end->preds.begin(), end->preds.end());
+	while(!work.empty()) {
+		IrBlock* block = work.back();
+		work.pop_back();
+		if(block == start || visited[block->id]) {
+			continue;
+		}
+		visited[block->id] = 1;
+		if(clobberedIn(block, 0, block->instrs.size(), reader)) {
+			return true;
+		}
+		work.insert(work.end(), block->preds.begin(), block->preds.end());
+	}
+	return false;
+}
+
+bool GlobalValueNumbering::clobberedIn(IrBlock* block, size_t start, size_t end,
+	IrInstr* reader) const
+{
+	for(size_t i = start; i < end; ++i) {
+		if(function_->clobbers(block->instrs[i], reader)) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,84 @@
+#ifndef CMILAN_GVN_H
+#define CMILAN_GVN_H
+
+#include "passes.h"
+#include "dominators.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Исключение общих подвыражений (нумерация значений по дереву доминаторов).
+//
+// Блоки обходятся в глубину по дереву доминаторов; таблица выражений,
+// вычисленных в доминирующих блоках, восстанавливается при возврате из
+// поддерева. Инструкция, совпадающая с уже вычисленной (та же операция и те
+// же операнды, для сложения, умножения и сравнения на равенство - в любом
+// порядке), заменяется ее значением. Повторная проверка того же индекса
+// с тем же размером и деление на то же значение не могут завершиться
+// ошибкой, раз первые выполнились, поэтому тоже заменяются.
+//
+// Чтение ячейки (IR_LOAD) или элемента (IR_BLOAD) заменяется прочитанным
+// ранее или записанным (IR_STORE, IR_BSTORE) значением, если ни на одном
+// пути между ними память не может измениться (IrFunction::clobbers). При
+// нижнем уровне общее значение остается в стеке (DUP) или сохраняется во
+// временной ячейке. Чтение ячейки и операция над значениями, которые не
+// вычисляются (i + 1, n - 1), повторяются: сохранение обошлось бы дороже,
+// но выражения с ними (a[i + 1]) считаются одинаковыми.
+
+class GlobalValueNumbering : public IrPass
+{
+public:
+	GlobalValueNumbering()
+		: function_(0)
+	{
+	}
+
+	const char* getName() const
+	{
+		return "gvn";
+	}
+
+	bool run(IrFunction& function);
+
+private:
+	// Выражение: операция, значение поля value и номера операндов
+	struct Key
+	{
+		int opcode;
+		int value;
+		int left;
+		int right;
+
+		bool operator<(const Key& other) const;
+	};
+
+	// Известное значение выражения и инструкция, после которой оно
+	// известно (для чтений памяти - начало участка без записей)
+	struct Entry
+	{
+		IrInstr* value;
+		IrInstr* position;
+	};
+
+	// Изменение таблицы для отмены при выходе из поддерева
+	struct Change
+	{
+		Key key;
+		Entry old;
+		bool existed;
+	};
+
+	bool visit(IrBlock* block);
+	void define(const Key& key, IrInstr* value, IrInstr* position);
+	void undo(size_t size);
+	bool clobbered(IrInstr* from, IrInstr* to) const;
+	bool clobberedIn(IrBlock* block, size_t start, size_t end, IrInstr* reader) const;
+
+	IrFunction* function_;
+	vector<int> number_;		// номер значения инструкции (номер равной ей инструкции)
+	map<Key, Entry> table_;		// выражения, вычисленные в доминаторах
+	vector<Change> changes_;	// изменения таблицы в текущей ветви дерева
+};
+
+#endif
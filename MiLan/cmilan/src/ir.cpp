@@ -0,0 +1,508 @@
+#include "ir.h"
+#include <climits>
+#include <sstream>
+#include <algorithm>
+
+bool IrInstr::hasSideEffects() const
+{
+	switch(opcode) {
+		case IR_DIV:
+			// Деление на ненулевую константу не может завершиться ошибкой
+			return !operands[1]->isConst() || operands[1]->value == 0;
+
+		case IR_INPUT:
+		case IR_PRINT:
+		case IR_STORE:
+		case IR_CHECK:
+		case IR_BSTORE:
+		case IR_RAW:
+		case IR_JUMP:
+		case IR_BRANCH:
+		case IR_STOP:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+bool irFold(IrOpcode opcode, int cmp, int a, int b, int& result)
+{
+	// Переполнение - по модулю 2^32, как в виртуальной машине
+	switch(opcode) {
+		case IR_ADD:
+			result = (int)((unsigned)a + (unsigned)b);
+			return true;
+		case IR_SUB:
+			result = (int)((unsigned)a - (unsigned)b);
+			return true;
+		case IR_MULT:
+			result = (int)((unsigned)a * (unsigned)b);
+			return true;
+		case IR_DIV:
+			if(b == 0) {
+				return false;
+			}
+			result = (b == -1) ? (int)(0u - (unsigned)a) : a / b;
+			return true;
+		case IR_NEG:
+			result = (int)(0u - (unsigned)a);
+			return true;
+		case IR_COMPARE:
+			switch(cmp) {
+				case 0: result = (a == b); return true;
+				case 1: result = (a != b); return true;
+				case 2: result = (a < b); return true;
+				case 3: result = (a > b); return true;
+				case 4: result = (a <= b); return true;
+				case 5: result = (a >= b); return true;
+				default: return false;
+			}
+		default:
+			return false;
+	}
+}
+
+// Удаление одного вхождения value из вектора
+template<class T>
+static void eraseOne(vector<T*>& items, T* value)
+{
+	typename vector<T*>::iterator it = find(items.begin(), items.end(), value);
+	if(it != items.end()) {
+		items.erase(it);
+	}
+}
+
+IrFunction::IrFunction(int memoryUsed)
+	: exposedBase_(INT_MAX), memoryUsed_(memoryUsed)
+{
+}
+
+IrFunction::~IrFunction()
+{
+	for(size_t i = 0; i < allInstrs_.size(); ++i) {
+		delete allInstrs_[i];
+	}
+	for(size_t i = 0; i < allBlocks_.size(); ++i) {
+		delete allBlocks_[i];
+	}
+}
+
+IrBlock* IrFunction::newBlock()
+{
+	IrBlock* block = new IrBlock();
+	block->id = allBlocks_.size();
+	allBlocks_.push_back(block);
+	return block;
+}
+
+IrInstr* IrFunction::newInstr(IrOpcode opcode, int value)
+{
+	IrInstr* instr = new IrInstr();
+	instr->opcode = opcode;
+	instr->value = value;
+	instr->id = allInstrs_.size();
+	instr->block = 0;
+	allInstrs_.push_back(instr);
+	return instr;
+}
+
+IrInstr* IrFunction::constant(int value)
+{
+	map<int, IrInstr*>::iterator it = constants_.find(value);
+	if(it != constants_.end() && it->second->block != 0) {
+		return it->second;
+	}
+	IrInstr* instr = newInstr(IR_CONST, value);
+	IrBlock* entry = getEntry();
+	instr->block = entry;
+	entry->instrs.insert(entry->instrs.begin(), instr);
+	constants_[value] = instr;
+	return instr;
+}
+
+void IrFunction::append(IrBlock* block, IrInstr* instr)
+{
+	instr->block = block;
+	block->instrs.push_back(instr);
+}
+
+void IrFunction::insertBefore(IrInstr* before, IrInstr* instr)
+{
+	IrBlock* block = before->block;
+	instr->block = block;
+	block->instrs.insert(find(block->instrs.begin(), block->instrs.end(), before), instr);
+}
+
+void IrFunction::moveBefore(IrInstr* instr, IrInstr* before)
+{
+	eraseOne(instr->block->instrs, instr);
+	insertBefore(before, instr);
+}
+
+void IrFunction::addOperand(IrInstr* instr, IrInstr* operand)
+{
+	instr->operands.push_back(operand);
+	operand->users.push_back(instr);
+}
+
+void IrFunction::setOperand(IrInstr* instr, int index, IrInstr* operand)
+{
+	eraseOne(instr->operands[index]->users, instr);
+	instr->operands[index] = operand;
+	operand->users.push_back(instr);
+}
+
+void IrFunction::removeOperand(IrInstr* instr, int index)
+{
+	eraseOne(instr->operands[index]->users, instr);
+	instr->operands.erase(instr->operands.begin() + index);
+}
+
+void IrFunction::replaceAllUses(IrInstr* from, IrInstr* to)
+{
+	vector<IrInstr*> users;
+	users.swap(from->users);
+	for(size_t i = 0; i < users.size(); ++i) {
+		IrInstr* user = users[i];
+		for(size_t j = 0; j < user->operands.size(); ++j) {
+			if(user->operands[j] == from) {
+				user->operands[j] = to;
+				to->users.push_back(user);
+			}
+		}
+	}
+}
+
+void IrFunction::remove(IrInstr* instr)
+{
+	for(size_t i = 0; i < instr->operands.size(); ++i) {
+		eraseOne(instr->operands[i]->users, instr);
+	}
+	instr->operands.clear();
+	eraseOne(instr->block->instrs, instr);
+	instr->block = 0;
+}
+
+void IrFunction::addEdge(IrBlock* from, IrBlock* to)
+{
+	from->succs.push_back(to);
+	to->preds.push_back(from);
+}
+
+void IrFunction::removeEdge(IrBlock* from, IrBlock* to)
+{
+	int index = find(to->preds.begin(), to->preds.end(), from) - to->preds.begin();
+	for(size_t i = 0; i < to->instrs.size() && to->instrs[i]->opcode == IR_PHI; ++i) {
+		removeOperand(to->instrs[i], index);
+	}
+	to->preds.erase(to->preds.begin() + index);
+	eraseOne(from->succs, to);
+}
+
+IrBlock* IrFunction::splitEdge(IrBlock* from, IrBlock* to)
+{
+	IrBlock* block = newBlock();
+	append(block, newInstr(IR_JUMP));
+	*find(from->succs.begin(), from->succs.end(), to) = block;
+	*find(to->preds.begin(), to->preds.end(), from) = block;
+	block->preds.push_back(from);
+	block->succs.push_back(to);
+	return block;
+}
+
+bool IrFunction::removeUnreachableBlocks()
+{
+	vector<IrBlock*> order;
+	getReversePostorder(order);
+	if(order.size() == blocks_.size()) {
+		return false;
+	}
+
+	vector<char> reachable(allBlocks_.size(), 0);
+	for(size_t i = 0; i < order.size(); ++i) {
+		reachable[order[i]->id] = 1;
+	}
+	vector<IrBlock*> blocks;
+	for(size_t i = 0; i < blocks_.size(); ++i) {
+		IrBlock* block = blocks_[i];
+		if(reachable[block->id]) {
+			blocks.push_back(block);
+			continue;
+		}
+		while(!block->succs.empty()) {
+			removeEdge(block, block->succs.back());
+		}
+	}
+	// Значения недостижимых блоков используются только в недостижимых блоках
+	for(size_t i = 0; i < blocks_.size(); ++i) {
+		IrBlock* block = blocks_[i];
+		if(reachable[block->id]) {
+			continue;
+		}
+		for(size_t j = 0; j < block->instrs.size(); ++j) {
+			IrInstr* instr = block->instrs[j];
+			for(size_t k = 0; k < instr->operands.size(); ++k) {
+				eraseOne(instr->operands[k]->users, instr);
+			}
+			instr->operands.clear();
+			instr->users.clear();
+			instr->block = 0;
+		}
+		block->instrs.clear();
+		block->preds.clear();
+	}
+	blocks_.swap(blocks);
+	return true;
+}
+
+void IrFunction::getReversePostorder(vector<IrBlock*>& order) const
+{
+	order.clear();
+	vector<char> visited(allBlocks_.size(), 0);
+	vector< pair<IrBlock*, size_t> > stack;
+	stack.push_back(make_pair(getEntry(), (size_t)0));
+	visited[getEntry()->id] = 1;
+	while(!stack.empty()) {
+		IrBlock* block = stack.back().first;
+		size_t next = stack.back().second;
+		if(next < block->succs.size()) {
+			++stack.back().second;
+			IrBlock* succ = block->succs[next];
+			if(!visited[succ->id]) {
+				visited[succ->id] = 1;
+				stack.push_back(make_pair(succ, (size_t)0));
+			}
+		}
+		else {
+			order.push_back(block);
+			stack.pop_back();
+		}
+	}
+	reverse(order.begin(), order.end());
+}
+
+void IrFunction::addArray(int address, int sizeAddress, int size)
+{
+	IrArray array;
+	array.address = address;
+	array.sizeAddress = sizeAddress;
+	array.size = size;
+	arrayIndex_[address] = arrays_.size();
+	arrays_.push_back(array);
+}
+
+const IrArray* IrFunction::findArray(int address) const
+{
+	map<int, int>::const_iterator it = arrayIndex_.find(address);
+	return (it != arrayIndex_.end()) ? &arrays_[it->second] : 0;
+}
+
+int IrFunction::addRaw(const IrRaw& raw)
+{
+	raws_.push_back(raw);
+	return raws_.size() - 1;
+}
+
+// Элементы массивов и отдельные ячейки не пересекаются, индекс проверяется
+// перед каждым обращением к элементу. Фрагмент кода пишет в свой массив и
+// во временную область.
+
+bool IrFunction::writesCell(const IrInstr* writer, int address) const
+{
+	switch(writer->opcode) {
+		case IR_STORE:
+			return writer->value == address;
+		case IR_RAW:
+			return address >= exposedBase_;
+		default:
+			return false;
+	}
+}
+
+bool IrFunction::writesArray(const IrInstr* writer, int address) const
+{
+	switch(writer->opcode) {
+		case IR_BSTORE:
+			return writer->value == address;
+		case IR_RAW:
+			return address == raws_[writer->value].destAddress || address >= exposedBase_;
+		default:
+			return false;
+	}
+}
+
+bool IrFunction::clobbers(const IrInstr* writer, const IrInstr* reader) const
+{
+	if(reader->opcode == IR_LOAD) {
+		return writesCell(writer, reader->value);
+	}
+	if(reader->opcode == IR_BLOAD) {
+		// Элементы с разными константными индексами различны
+		if(writer->opcode == IR_BSTORE && writer->operands[1]->isConst()
+			&& reader->operands[0]->isConst()
+			&& writer->operands[1]->value != reader->operands[0]->value) {
+			return false;
+		}
+		return writesArray(writer, reader->value);
+	}
+	return false;
+}
+
+// Число операндов инструкции (-1 - любое)
+static int operandCount(IrOpcode opcode)
+{
+	switch(opcode) {
+		case IR_PHI:
+			return -1;
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_DIV:
+		case IR_COMPARE:
+		case IR_CHECK:
+		case IR_BSTORE:
+			return 2;
+		case IR_NEG:
+		case IR_PRINT:
+		case IR_STORE:
+		case IR_BLOAD:
+		case IR_BRANCH:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+// Число преемников блока с завершающей инструкцией opcode
+static int successorCount(IrOpcode opcode)
+{
+	switch(opcode) {
+		case IR_JUMP:
+			return 1;
+		case IR_BRANCH:
+			return 2;
+		default:
+			return 0;
+	}
+}
+
+bool IrFunction::verify(string& error) const
+{
+	ostringstream msg;
+	for(size_t i = 0; i < blocks_.size() && msg.str().empty(); ++i) {
+		const IrBlock* block = blocks_[i];
+		if(block->instrs.empty() || !block->getTerminator()->isTerminator()) {
+			msg << "b" << block->id << ": no terminator";
+			break;
+		}
+		if((int)block->succs.size() != successorCount(block->getTerminator()->opcode)) {
+			msg << "b" << block->id << ": wrong number of successors";
+			break;
+		}
+		for(size_t j = 0; j < block->succs.size(); ++j) {
+			const vector<IrBlock*>& preds = block->succs[j]->preds;
+			if(count(preds.begin(), preds.end(), block) == 0) {
+				msg << "b" << block->id << ": missing pred edge";
+			}
+		}
+		for(size_t j = 0; j < block->preds.size(); ++j) {
+			const vector<IrBlock*>& succs = block->preds[j]->succs;
+			if(count(succs.begin(), succs.end(), block) == 0) {
+				msg << "b" << block->id << ": missing succ edge";
+			}
+		}
+		bool phis = true;
+		for(size_t j = 0; j < block->instrs.size(); ++j) {
+			const IrInstr* instr = block->instrs[j];
+			if(instr->block != block) {
+				msg << "%" << instr->id << ": wrong block";
+			}
+			if(instr->isTerminator() != (j + 1 == block->instrs.size())) {
+				msg << "%" << instr->id << ": misplaced terminator";
+			}
+			if(instr->opcode == IR_PHI) {
+				if(!phis) {
+					msg << "%" << instr->id << ": misplaced phi";
+				}
+				if(instr->operands.size() != block->preds.size()) {
+					msg << "%" << instr->id << ": wrong number of phi operands";
+				}
+			}
+			else {
+				phis = false;
+				if(operandCount(instr->opcode) != (int)instr->operands.size()) {
+					msg << "%" << instr->id << ": wrong number of operands";
+				}
+			}
+			for(size_t k = 0; k < instr->operands.size(); ++k) {
+				const IrInstr* operand = instr->operands[k];
+				if(operand->block == 0 || !operand->hasValue()) {
+					msg << "%" << instr->id << ": bad operand %" << operand->id;
+				}
+				if(count(operand->users.begin(), operand->users.end(), instr)
+					!= count(instr->operands.begin(), instr->operands.end(), operand)) {
+					msg << "%" << instr->id << ": inconsistent users of %" << operand->id;
+				}
+			}
+			if(!msg.str().empty()) {
+				break;
+			}
+		}
+	}
+	error = msg.str();
+	return error.empty();
+}
+
+static const char* opcodeName(IrOpcode opcode)
+{
+	static const char* const names[] = {
+		"const", "phi", "add", "sub", "mult", "div", "neg", "compare",
+		"input", "print", "load", "store", "check", "bload", "bstore", "raw",
+		"jump", "branch", "stop"
+	};
+	return names[opcode];
+}
+
+void IrFunction::print(ostream& os) const
+{
+	for(size_t i = 0; i < blocks_.size(); ++i) {
+		const IrBlock* block = blocks_[i];
+		os << "b" << block->id << ":";
+		if(!block->preds.empty()) {
+			os << "\t; preds";
+			for(size_t j = 0; j < block->preds.size(); ++j) {
+				os << " b" << block->preds[j]->id;
+			}
+		}
+		os << endl;
+		for(size_t j = 0; j < block->instrs.size(); ++j) {
+			const IrInstr* instr = block->instrs[j];
+			os << "\t";
+			if(instr->hasValue()) {
+				os << "%" << instr->id << " = ";
+			}
+			os << opcodeName(instr->opcode);
+			switch(instr->opcode) {
+				case IR_CONST:
+				case IR_COMPARE:
+				case IR_LOAD:
+				case IR_STORE:
+				case IR_BLOAD:
+				case IR_BSTORE:
+				case IR_RAW:
+					os << " [" << instr->value << "]";
+					break;
+				default:
+					break;
+			}
+			for(size_t k = 0; k < instr->operands.size(); ++k) {
+				os << (k == 0 ? " " : ", ") << "%" << instr->operands[k]->id;
+			}
+			for(size_t k = 0; k < block->succs.size() && instr->isTerminator(); ++k) {
+				os << (k == 0 ? " -> " : ", ") << "b" << block->succs[k]->id;
+			}
+			os << endl;
+		}
+	}
+}
@@ -0,0 +1,265 @@
+#ifndef CMILAN_IR_H
+#define CMILAN_IR_H
+
+#include "codegen.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+// Промежуточное представление (IR) программы на Милане для оптимизатора.
+//
+// Программа - это граф базовых блоков (IrBlock). Блок содержит
+// последовательность инструкций (IrInstr): сначала phi-функции, затем
+// обычные инструкции, последней - переход (IR_JUMP, IR_BRANCH) или IR_STOP.
+// Инструкция, вычисляющая значение, сама является этим значением (форма SSA:
+// значение определяется ровно один раз); операнды - ссылки на другие
+// инструкции. Для каждой инструкции известен список ее использований.
+//
+// Переменные, которые не видны операциям над массивами целиком, переводятся
+// в форму SSA и в памяти не хранятся. Остальные ячейки (IR_LOAD, IR_STORE) и
+// элементы массивов (IR_BLOAD, IR_BSTORE) остаются в памяти данных, см.
+// IrFunction::writesCell и IrFunction::writesArray.
+
+enum IrOpcode
+{
+	IR_CONST,	// константа value
+	IR_PHI,		// phi-функция: i-й операнд - значение при переходе из i-го предшественника
+	IR_ADD,		// op0 + op1
+	IR_SUB,		// op0 - op1
+	IR_MULT,	// op0 * op1
+	IR_DIV,		// op0 / op1 (деление на 0 - ошибка времени исполнения)
+	IR_NEG,		// -op0
+	IR_COMPARE,	// op0 cmp op1 (1 или 0), value - код сравнения команды COMPARE
+	IR_INPUT,	// чтение числа со стандартного ввода
+	IR_PRINT,	// печать op0
+	IR_LOAD,	// значение ячейки value
+	IR_STORE,	// запись op0 в ячейку value
+	IR_CHECK,	// проверка 0 <= op0 < op1 (иначе аварийный останов); значение - op0
+	IR_BLOAD,	// элемент op0 массива с адресом value
+	IR_BSTORE,	// запись op0 в элемент op1 массива с адресом value
+	IR_RAW,		// готовый фрагмент кода IrFunction::getRaw(value)
+	IR_JUMP,	// переход к successors[0]
+	IR_BRANCH,	// переход к successors[0], если op0 != 0, иначе к successors[1]
+	IR_STOP		// остановка программы
+};
+
+struct IrBlock;
+
+struct IrInstr
+{
+	IrOpcode opcode;		// операция
+	int value;			// константа, адрес или код сравнения
+	int id;				// номер инструкции в функции
+	IrBlock* block;			// блок, которому принадлежит инструкция (0, если удалена)
+	vector<IrInstr*> operands;	// операнды
+	vector<IrInstr*> users;		// инструкции, использующие значение (с повторениями)
+
+	// Вычисляет ли инструкция значение
+	bool hasValue() const
+	{
+		return opcode != IR_PRINT && opcode != IR_STORE && opcode != IR_BSTORE
+			&& opcode != IR_RAW && opcode < IR_JUMP;
+	}
+
+	// Завершает ли инструкция блок
+	bool isTerminator() const
+	{
+		return opcode >= IR_JUMP;
+	}
+
+	bool isConst() const
+	{
+		return opcode == IR_CONST;
+	}
+
+	// Может ли инструкция остановить программу, изменить память или
+	// выполнить ввод-вывод (такие инструкции нельзя удалять и переставлять)
+	bool hasSideEffects() const;
+};
+
+// Вычисление значения арифметической операции или сравнения opcode
+// (cmp - код сравнения) над константами a и b (для IR_NEG b не
+// используется) по правилам виртуальной машины. Возвращает false, если
+// значение не определено (деление на 0) или операция не арифметическая.
+bool irFold(IrOpcode opcode, int cmp, int a, int b, int& result);
+
+struct IrBlock
+{
+	int id;				// номер блока в функции
+	vector<IrInstr*> instrs;	// phi-функции, инструкции и завершающий переход
+	vector<IrBlock*> preds;		// предшественники (в порядке операндов phi-функций)
+	vector<IrBlock*> succs;		// преемники
+
+	IrInstr* getTerminator() const
+	{
+		return instrs.back();
+	}
+};
+
+// Массив программы
+struct IrArray
+{
+	int address;		// адрес первого элемента
+	int sizeAddress;	// адрес ячейки с текущим размером
+	int size;		// объявленный размер
+};
+
+// Фрагмент кода, который оптимизатор переносит в программу без изменений
+// (поэлементные операции, объединение и пересечение массивов). Переходы
+// внутри фрагмента отсчитываются от его начала.
+struct IrRaw
+{
+	vector<Command> code;	// команды фрагмента
+	int destAddress;	// адрес массива, в который записывается результат
+};
+
+// Программа в промежуточном представлении. Владеет всеми блоками и
+// инструкциями; удаленные инструкции освобождаются вместе с функцией.
+
+class IrFunction
+{
+public:
+	// Конструктор
+	//     int memoryUsed - число слов памяти, занятых переменными и массивами
+	explicit IrFunction(int memoryUsed);
+	~IrFunction();
+
+	// Блоки в порядке размещения в программе; первый - входной
+	vector<IrBlock*>& getBlocks()
+	{
+		return blocks_;
+	}
+
+	IrBlock* getEntry() const
+	{
+		return blocks_.front();
+	}
+
+	// Новый блок (в порядок размещения не добавляется)
+	IrBlock* newBlock();
+
+	// Новая инструкция без операндов (в блок не добавляется)
+	IrInstr* newInstr(IrOpcode opcode, int value = 0);
+
+	// Константа value из входного блока
+	IrInstr* constant(int value);
+
+	// Добавление инструкции в конец блока block или перед инструкцией before
+	void append(IrBlock* block, IrInstr* instr);
+	void insertBefore(IrInstr* before, IrInstr* instr);
+
+	// Перенос инструкции из ее блока перед инструкцией before (операнды
+	// и использования сохраняются)
+	void moveBefore(IrInstr* instr, IrInstr* before);
+
+	// Операнды
+	void addOperand(IrInstr* instr, IrInstr* operand);
+	void setOperand(IrInstr* instr, int index, IrInstr* operand);
+	void removeOperand(IrInstr* instr, int index);
+
+	// Замена всех использований from на to
+	void replaceAllUses(IrInstr* from, IrInstr* to);
+
+	// Удаление инструкции из блока вместе с ее операндами. Значение
+	// инструкции не должно использоваться.
+	void remove(IrInstr* instr);
+
+	// Дуги графа потока управления. При удалении дуги удаляются и
+	// соответствующие операнды phi-функций преемника.
+	void addEdge(IrBlock* from, IrBlock* to);
+	void removeEdge(IrBlock* from, IrBlock* to);
+
+	// Разбиение дуги from -> to новым блоком с единственным переходом к to.
+	// Новый блок занимает место from среди предшественников to (операнды
+	// phi-функций не меняются); в порядок размещения он не добавляется.
+	IrBlock* splitEdge(IrBlock* from, IrBlock* to);
+
+	// Удаление блоков, недостижимых из входного. Возвращает true, если
+	// что-то удалено.
+	bool removeUnreachableBlocks();
+
+	// Обход блоков в обратном порядке после обхода в глубину
+	void getReversePostorder(vector<IrBlock*>& order) const;
+
+	// Число блоков и инструкций, созданных в функции (номера id меньше
+	// этих чисел и не меняются, их можно использовать как индексы массивов)
+	int getBlockCount() const
+	{
+		return allBlocks_.size();
+	}
+
+	int getInstrCount() const
+	{
+		return allInstrs_.size();
+	}
+
+	// Массивы программы
+	void addArray(int address, int sizeAddress, int size);
+	const IrArray* findArray(int address) const;
+
+	const vector<IrArray>& getArrays() const
+	{
+		return arrays_;
+	}
+
+	// Фрагменты кода IR_RAW
+	int addRaw(const IrRaw& raw);
+
+	const IrRaw& getRaw(int index) const
+	{
+		return raws_[index];
+	}
+
+	// Начало области памяти, которую фрагменты объединения и пересечения
+	// используют как временную (ячейки за ней могут быть перезаписаны)
+	int getExposedBase() const
+	{
+		return exposedBase_;
+	}
+
+	void setExposedBase(int address)
+	{
+		exposedBase_ = address;
+	}
+
+	int getMemoryUsed() const
+	{
+		return memoryUsed_;
+	}
+
+	// Может ли инструкция writer изменить ячейку address
+	bool writesCell(const IrInstr* writer, int address) const;
+
+	// Может ли инструкция writer изменить элементы массива с адресом address
+	bool writesArray(const IrInstr* writer, int address) const;
+
+	// Может ли инструкция writer изменить значение, прочитанное reader
+	// (IR_LOAD или IR_BLOAD)
+	bool clobbers(const IrInstr* writer, const IrInstr* reader) const;
+
+	// Проверка корректности представления; описание первой ошибки
+	// записывается в error
+	bool verify(string& error) const;
+
+	// Печать в текстовом виде (для отладки)
+	void print(ostream& os) const;
+
+private:
+	IrFunction(const IrFunction&);
+	IrFunction& operator=(const IrFunction&);
+
+	vector<IrBlock*> blocks_;		// блоки в порядке размещения
+	vector<IrBlock*> allBlocks_;		// все созданные блоки
+	vector<IrInstr*> allInstrs_;		// все созданные инструкции
+	map<int, IrInstr*> constants_;		// константы входного блока
+	vector<IrArray> arrays_;		// массивы
+	map<int, int> arrayIndex_;		// индекс массива в arrays_ по адресу
+	vector<IrRaw> raws_;			// фрагменты кода
+	int exposedBase_;			// начало временной области фрагментов
+	int memoryUsed_;			// число занятых слов памяти
+};
+
+#endif
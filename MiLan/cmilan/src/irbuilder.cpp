@@ -0,0 +1,379 @@
+#include "irbuilder.h"
+#include "astgen.h"
+#include <algorithm>
+
+void IrBuilder::build(const AstNode* program)
+{
+	prepare(program);
+
+	IrBlock* entry = function_->newBlock();
+	startBlock(entry);
+	sealBlock(entry);
+	statementList(program);
+	emit(IR_STOP);
+}
+
+// Размеры массивов, которые читает код поэлементных операций, начало
+// временной области объединения и пересечения, объявленные массивы
+void IrBuilder::prepare(const AstNode* node)
+{
+	for(; node != 0; node = node->next) {
+		switch(node->kind) {
+			case AST_SET_ASSIGN:
+				function_->setExposedBase(min(function_->getExposedBase(), node->tempAddress));
+				memoryCells_[node->sizeAddress] = true;
+				memoryCells_[node->left->sizeAddress] = true;
+				memoryCells_[node->right->sizeAddress] = true;
+				break;
+
+			case AST_ARRAY_ASSIGN: {
+				memoryCells_[node->sizeAddress] = true;
+				vector<const AstNode*> stack(1, node->left);
+				while(!stack.empty()) {
+					const AstNode* operand = stack.back();
+					stack.pop_back();
+					if(operand->kind == AST_ARRAY) {
+						memoryCells_[operand->sizeAddress] = true;
+					}
+					else {
+						stack.push_back(operand->left);
+						if(operand->right != 0) {
+							stack.push_back(operand->right);
+						}
+					}
+				}
+				break;
+			}
+
+			case AST_IF:
+				prepare(node->right);
+				prepare(node->third);
+				break;
+
+			case AST_WHILE:
+				prepare(node->right);
+				break;
+
+			case AST_DECLARE:
+				function_->addArray(node->address, node->sizeAddress, node->value);
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+void IrBuilder::statementList(const AstNode* node)
+{
+	for(; node != 0; node = node->next) {
+		statement(node);
+	}
+}
+
+void IrBuilder::statement(const AstNode* node)
+{
+	switch(node->kind) {
+		case AST_ASSIGN:
+			writeCell(node->address, expression(node->left));
+			break;
+
+		case AST_ELEMENT_ASSIGN: {
+			IrInstr* index = expression(node->left);
+			index = emit(IR_CHECK, 0, index, readCell(node->sizeAddress));
+			IrInstr* value = expression(node->right);
+			emit(IR_BSTORE, node->address, value, index);
+			break;
+		}
+
+		// Поэлементные операции, объединение и пересечение переносятся в
+		// программу в том виде, в каком их формирует AstCodeGen
+		case AST_ARRAY_ASSIGN:
+		case AST_SET_ASSIGN: {
+			CodeGen codegen;
+			AstCodeGen generator(&codegen);
+			generator.statement(node);
+			IrRaw raw;
+			raw.code = codegen.getCommands();
+			raw.destAddress = node->address;
+			emit(IR_RAW, function_->addRaw(raw));
+			break;
+		}
+
+		case AST_IF: {
+			IrInstr* condition = expression(node->left);
+			IrBlock* thenBlock = function_->newBlock();
+			IrBlock* elseBlock = (node->value != 0) ? function_->newBlock() : 0;
+			IrBlock* join = function_->newBlock();
+			branch(condition, thenBlock, (elseBlock != 0) ? elseBlock : join);
+			sealBlock(thenBlock);
+			startBlock(thenBlock);
+			statementList(node->right);
+			jump(join);
+			if(elseBlock != 0) {
+				sealBlock(elseBlock);
+				startBlock(elseBlock);
+				statementList(node->third);
+				jump(join);
+			}
+			sealBlock(join);
+			startBlock(join);
+			break;
+		}
+
+		// Заголовок цикла запечатывается, когда известен переход из конца тела
+		case AST_WHILE: {
+			IrBlock* header = function_->newBlock();
+			jump(header);
+			startBlock(header);
+			IrInstr* condition = expression(node->left);
+			IrBlock* body = function_->newBlock();
+			IrBlock* exit = function_->newBlock();
+			branch(condition, body, exit);
+			sealBlock(body);
+			startBlock(body);
+			statementList(node->right);
+			jump(header);
+			sealBlock(header);
+			sealBlock(exit);
+			startBlock(exit);
+			break;
+		}
+
+		case AST_WRITE:
+			emit(IR_PRINT, 0, expression(node->left));
+			break;
+
+		case AST_DECLARE:
+			writeCell(node->sizeAddress, function_->constant(node->value));
+			break;
+
+		// Проверка 0 <= size - 1 < size равносильна size > 0
+		case AST_DELETE: {
+			IrInstr* size = readCell(node->sizeAddress);
+			IrInstr* last = emit(IR_SUB, 0, size, function_->constant(1));
+			last = emit(IR_CHECK, 0, last, size);
+			writeCell(node->sizeAddress, last);
+			emit(IR_BSTORE, node->address, function_->constant(0), last);
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+IrInstr* IrBuilder::expression(const AstNode* node)
+{
+	switch(node->kind) {
+		case AST_NUMBER:
+			return function_->constant(node->value);
+
+		case AST_VARIABLE:
+			return readCell(node->address);
+
+		case AST_ELEMENT: {
+			IrInstr* index = expression(node->left);
+			index = emit(IR_CHECK, 0, index, readCell(node->sizeAddress));
+			return emit(IR_BLOAD, node->address, index);
+		}
+
+		case AST_READ:
+			return emit(IR_INPUT);
+
+		case AST_NEGATE:
+			return emit(IR_NEG, 0, expression(node->left));
+
+		case AST_BINARY: {
+			IrInstr* left = expression(node->left);
+			IrInstr* right = expression(node->right);
+			switch(node->value) {
+				case A_PLUS:
+					return emit(IR_ADD, 0, left, right);
+				case A_MINUS:
+					return emit(IR_SUB, 0, left, right);
+				case A_MULTIPLY:
+					return emit(IR_MULT, 0, left, right);
+				default:
+					return emit(IR_DIV, 0, left, right);
+			}
+		}
+
+		default: {
+			IrInstr* left = expression(node->left);
+			IrInstr* right = expression(node->right);
+			return emit(IR_COMPARE, AstCodeGen::compareCode((Cmp)node->value), left, right);
+		}
+	}
+}
+
+IrInstr* IrBuilder::emit(IrOpcode opcode, int value, IrInstr* first, IrInstr* second)
+{
+	IrInstr* instr = function_->newInstr(opcode, value);
+	if(first != 0) {
+		function_->addOperand(instr, first);
+	}
+	if(second != 0) {
+		function_->addOperand(instr, second);
+	}
+	function_->append(current_, instr);
+	return instr;
+}
+
+void IrBuilder::startBlock(IrBlock* block)
+{
+	grow();
+	function_->getBlocks().push_back(block);
+	current_ = block;
+}
+
+void IrBuilder::jump(IrBlock* target)
+{
+	emit(IR_JUMP);
+	function_->addEdge(current_, target);
+}
+
+void IrBuilder::branch(IrInstr* condition, IrBlock* yes, IrBlock* no)
+{
+	emit(IR_BRANCH, 0, condition);
+	function_->addEdge(current_, yes);
+	function_->addEdge(current_, no);
+}
+
+IrInstr* IrBuilder::readCell(int address)
+{
+	if(address >= function_->getExposedBase() || memoryCells_.count(address) != 0) {
+		return emit(IR_LOAD, address);
+	}
+	return readVariable(address, current_);
+}
+
+void IrBuilder::writeCell(int address, IrInstr* value)
+{
+	if(address >= function_->getExposedBase() || memoryCells_.count(address) != 0) {
+		emit(IR_STORE, address, value);
+	}
+	else {
+		definitions_[current_->id][address] = value;
+	}
+}
+
+IrInstr* IrBuilder::readVariable(int address, IrBlock* block)
+{
+	map<int, IrInstr*>::iterator it = definitions_[block->id].find(address);
+	if(it != definitions_[block->id].end()) {
+		return resolve(it->second);
+	}
+	return readVariableRecursive(address, block);
+}
+
+IrInstr* IrBuilder::readVariableRecursive(int address, IrBlock* block)
+{
+	IrInstr* value;
+	if(!sealed_[block->id]) {
+		// Предшественники еще не известны: операнды добавит sealBlock
+		IrInstr* phi = newPhi(address, block);
+		incompletePhis_[block->id].push_back(make_pair(address, phi));
+		value = phi;
+	}
+	else if(block->preds.empty()) {
+		// Ячейки памяти данных в начале программы равны нулю
+		value = function_->constant(0);
+	}
+	else if(block->preds.size() == 1) {
+		value = readVariable(address, block->preds[0]);
+	}
+	else {
+		// Phi-функция записывается до чтения операндов, чтобы не зациклиться
+		IrInstr* phi = newPhi(address, block);
+		definitions_[block->id][address] = phi;
+		value = addPhiOperands(address, phi);
+	}
+	definitions_[block->id][address] = value;
+	return value;
+}
+
+IrInstr* IrBuilder::newPhi(int address, IrBlock* block)
+{
+	IrInstr* phi = function_->newInstr(IR_PHI, address);
+	phi->block = block;
+	block->instrs.insert(block->instrs.begin(), phi);
+	return phi;
+}
+
+IrInstr* IrBuilder::addPhiOperands(int address, IrInstr* phi)
+{
+	IrBlock* block = phi->block;
+	for(size_t i = 0; i < block->preds.size(); ++i) {
+		function_->addOperand(phi, readVariable(address, block->preds[i]));
+	}
+	return tryRemoveTrivialPhi(phi);
+}
+
+IrInstr* IrBuilder::tryRemoveTrivialPhi(IrInstr* phi)
+{
+	IrInstr* same = 0;
+	for(size_t i = 0; i < phi->operands.size(); ++i) {
+		IrInstr* operand = phi->operands[i];
+		if(operand == same || operand == phi) {
+			continue;
+		}
+		if(same != 0) {
+			return phi;
+		}
+		same = operand;
+	}
+	if(same == 0) {
+		// Блок недостижим или значение не определено ни на одном пути
+		same = function_->constant(0);
+	}
+
+	vector<IrInstr*> users;
+	for(size_t i = 0; i < phi->users.size(); ++i) {
+		IrInstr* user = phi->users[i];
+		if(user != phi && find(users.begin(), users.end(), user) == users.end()) {
+			users.push_back(user);
+		}
+	}
+	replaced_[phi] = same;
+	function_->replaceAllUses(phi, same);
+	function_->remove(phi);
+
+	// Phi-функции, использовавшие удаленную, могли стать тривиальными
+	for(size_t i = 0; i < users.size(); ++i) {
+		if(users[i]->opcode == IR_PHI && users[i]->block != 0) {
+			tryRemoveTrivialPhi(users[i]);
+		}
+	}
+	return resolve(same);
+}
+
+void IrBuilder::sealBlock(IrBlock* block)
+{
+	grow();
+	vector< pair<int, IrInstr*> > phis;
+	phis.swap(incompletePhis_[block->id]);
+	for(size_t i = 0; i < phis.size(); ++i) {
+		addPhiOperands(phis[i].first, phis[i].second);
+	}
+	sealed_[block->id] = 1;
+}
+
+void IrBuilder::grow()
+{
+	if((int)sealed_.size() < function_->getBlockCount()) {
+		sealed_.resize(function_->getBlockCount(), 0);
+		definitions_.resize(function_->getBlockCount());
+		incompletePhis_.resize(function_->getBlockCount());
+	}
+}
+
+IrInstr* IrBuilder::resolve(IrInstr* value)
+{
+	map<IrInstr*, IrInstr*>::iterator it = replaced_.find(value);
+	while(it != replaced_.end()) {
+		value = it->second;
+		it = replaced_.find(value);
+	}
+	return value;
+}
@@ -0,0 +1,75 @@
+#ifndef CMILAN_IRBUILDER_H
+#define CMILAN_IRBUILDER_H
+
+#include "ir.h"
+#include "ast.h"
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// Построение промежуточного представления по синтаксическому дереву.
+//
+// Переменные переводятся в форму SSA прямо при обходе дерева (алгоритм
+// Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form"): значение переменной ищется от текущего блока вверх
+// по предшественникам, phi-функции создаются по мере надобности, а
+// тривиальные (все операнды которых совпадают) сразу удаляются.
+//
+// В памяти остаются ячейки, которые читает код поэлементных операций над
+// массивами (размеры участвующих в них массивов), и все ячейки начиная
+// с временной области объединения и пересечения массивов: эти операции
+// переносятся в программу готовыми фрагментами (IR_RAW).
+
+class IrBuilder
+{
+public:
+	explicit IrBuilder(IrFunction* function)
+		: function_(function), current_(0)
+	{
+	}
+
+	// Построение функции по списку операторов program
+	void build(const AstNode* program);
+
+private:
+	void prepare(const AstNode* node); // поиск ячеек, которые остаются в памяти
+	void statementList(const AstNode* node);
+	void statement(const AstNode* node);
+	IrInstr* expression(const AstNode* node);
+
+	// Добавление инструкции в текущий блок
+	IrInstr* emit(IrOpcode opcode, int value = 0, IrInstr* first = 0, IrInstr* second = 0);
+
+	// Новый текущий блок (добавляется в порядок размещения)
+	void startBlock(IrBlock* block);
+
+	// Переход из текущего блока
+	void jump(IrBlock* target);
+	void branch(IrInstr* condition, IrBlock* yes, IrBlock* no);
+
+	// Чтение и запись ячейки памяти данных: переменные в форме SSA или
+	// IR_LOAD/IR_STORE для ячеек, которые остаются в памяти
+	IrInstr* readCell(int address);
+	void writeCell(int address, IrInstr* value);
+
+	// Построение SSA
+	IrInstr* readVariable(int address, IrBlock* block);
+	IrInstr* readVariableRecursive(int address, IrBlock* block);
+	IrInstr* newPhi(int address, IrBlock* block); // новая phi-функция в начале блока
+	IrInstr* addPhiOperands(int address, IrInstr* phi);
+	IrInstr* tryRemoveTrivialPhi(IrInstr* phi);
+	void sealBlock(IrBlock* block);
+	IrInstr* resolve(IrInstr* value); // значение, которым заменена удаленная phi-функция
+	void grow(); // расширение массивов, индексируемых номером блока
+
+	IrFunction* function_;		// строящаяся функция
+	IrBlock* current_;		// текущий блок
+	map<int, bool> memoryCells_;	// ячейки, которые читают фрагменты кода
+	vector< map<int, IrInstr*> > definitions_;	// текущие значения переменных в блоках (по номеру блока)
+	vector< vector< pair<int, IrInstr*> > > incompletePhis_;	// phi-функции незапечатанных блоков
+	vector<char> sealed_;		// известны ли все предшественники блока
+	map<IrInstr*, IrInstr*> replaced_;	// удаленные phi-функции и их замены
+};
+
+#endif
@@ -0,0 +1,491 @@
+#include "irlower.h"
+#include <algorithm>
+
+void IrLowering::lower()
+{
+	prepare();
+	findRemat();
+
+	vector<IrBlock*>& blocks = function_->getBlocks();
+	int count = function_->getInstrCount();
+	stackUse_.assign(count, -2);
+	stacked_.assign(count, 0);
+	needsSlot_.assign(count, 0);
+	lastUse_.assign(count, -1);
+	slot_.assign(count, -1);
+
+	vector< vector<Op> > ops(blocks.size());
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		block_ = blocks[i];
+		buildOps(blocks[i], ops[i]);
+		stackify(ops[i]);
+		markSources(ops[i]);
+	}
+
+	// Значения, которые используются в разных блоках, получают
+	// собственные ячейки, остальные - ячейки, общие для всех блоков
+	globalCount_ = 0;
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		for(size_t j = 0; j < blocks[i]->instrs.size(); ++j) {
+			IrInstr* instr = blocks[i]->instrs[j];
+			if(needsSlot_[instr->id] && global_[instr->id]) {
+				slot_[instr->id] = globalCount_++;
+			}
+		}
+	}
+	localCount_ = 0;
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		assignSlots(ops[i]);
+	}
+	tempCount_ = globalCount_ + localCount_;
+
+	blockAddress_.assign(function_->getBlockCount(), 0);
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		block_ = blocks[i];
+		emitBlock(ops[i], (i + 1 < blocks.size()) ? blocks[i + 1] : 0);
+	}
+	for(size_t i = 0; i < fixups_.size(); ++i) {
+		int address = fixups_[i].first;
+		Instruction instruction = codegen_->getCommands()[address].getInstruction();
+		codegen_->emitAt(address, instruction, blockAddress_[fixups_[i].second->id]);
+	}
+}
+
+void IrLowering::prepare()
+{
+	function_->removeUnreachableBlocks();
+	vector<IrBlock*>& blocks = function_->getBlocks();
+
+	// Phi-функция блока с единственным предшественником равна своему операнду
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		while(block->preds.size() == 1 && block->instrs.front()->opcode == IR_PHI) {
+			IrInstr* phi = block->instrs.front();
+			function_->replaceAllUses(phi, phi->operands[0]);
+			function_->remove(phi);
+		}
+	}
+
+	// Копирование в конце предшественника с несколькими преемниками
+	// выполнялось бы на всех путях из него: такие дуги разбиваются блоком,
+	// который размещается перед преемником
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		if(block->preds.size() < 2 || block->instrs.front()->opcode != IR_PHI) {
+			continue;
+		}
+		for(size_t j = 0; j < block->preds.size(); ++j) {
+			if(block->preds[j]->succs.size() > 1) {
+				IrBlock* split = function_->splitEdge(block->preds[j], block);
+				blocks.insert(blocks.begin() + i, split);
+				++i;
+			}
+		}
+	}
+
+	// Значения, которые используются вне своего блока (phi-функция
+	// используется в конце предшественника, из которого получен операнд)
+	global_.assign(function_->getInstrCount(), 0);
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		for(size_t j = 0; j < block->instrs.size(); ++j) {
+			IrInstr* instr = block->instrs[j];
+			if(instr->opcode == IR_PHI) {
+				global_[instr->id] = 1;
+				for(size_t k = 0; k < instr->operands.size(); ++k) {
+					if(instr->operands[k]->block != block->preds[k]) {
+						global_[instr->operands[k]->id] = 1;
+					}
+				}
+			}
+			else {
+				for(size_t k = 0; k < instr->operands.size(); ++k) {
+					if(instr->operands[k]->block != block) {
+						global_[instr->operands[k]->id] = 1;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Константы и чтения ячеек с единственным использованием в том же блоке,
+// если до использования ячейка не изменяется
+void IrLowering::findRemat()
+{
+	remat_.assign(function_->getInstrCount(), 0);
+	vector<IrBlock*>& blocks = function_->getBlocks();
+	for(size_t i = 0; i < blocks.size(); ++i) {
+		IrBlock* block = blocks[i];
+		for(size_t j = 0; j < block->instrs.size(); ++j) {
+			IrInstr* instr = block->instrs[j];
+			if(instr->opcode == IR_CONST) {
+				remat_[instr->id] = 1;
+			}
+			if(instr->opcode != IR_LOAD || instr->users.size() != 1) {
+				continue;
+			}
+			IrInstr* user = instr->users[0];
+			if(user->block != block || user->opcode == IR_PHI) {
+				continue;
+			}
+			size_t k = j + 1;
+			while(block->instrs[k] != user && !function_->clobbers(block->instrs[k], instr)) {
+				++k;
+			}
+			remat_[instr->id] = (block->instrs[k] == user);
+		}
+	}
+}
+
+void IrLowering::buildOps(IrBlock* block, vector<Op>& ops)
+{
+	for(size_t i = 0; i < block->instrs.size(); ++i) {
+		IrInstr* instr = block->instrs[i];
+		if(instr->opcode == IR_PHI || remat_[instr->id]) {
+			continue;
+		}
+
+		// Копирование значений phi-функций преемника перед переходом
+		if(instr->isTerminator() && block->succs.size() == 1) {
+			IrBlock* succ = block->succs[0];
+			int pred = find(succ->preds.begin(), succ->preds.end(), block) - succ->preds.begin();
+			Op copy;
+			copy.instr = 0;
+			copy.special = 0;
+			for(size_t j = 0; j < succ->instrs.size() && succ->instrs[j]->opcode == IR_PHI; ++j) {
+				IrInstr* phi = succ->instrs[j];
+				IrInstr* value = phi->operands[pred];
+				if(value == phi) {
+					continue;
+				}
+				bool used = false;
+				for(size_t k = 0; k < phi->users.size() && !used; ++k) {
+					used = (phi->users[k] != phi);
+				}
+				if(used) {
+					copy.operands.push_back(value);
+					copy.phis.push_back(phi);
+				}
+			}
+			if(!copy.phis.empty()) {
+				ops.push_back(copy);
+			}
+		}
+
+		Op op;
+		op.instr = instr;
+		op.special = 0;
+		op.operands = instr->operands;
+		if(instr->opcode == IR_CHECK) {
+			op.special = op.operands[1];
+			op.operands.pop_back();
+		}
+		ops.push_back(op);
+	}
+}
+
+// Значение остается в стеке, если к операции, которая первой его
+// использует, оно оказывается на вершине стека в нужном порядке. Иначе
+// оно сохраняется во временной ячейке.
+void IrLowering::stackify(const vector<Op>& ops)
+{
+	for(size_t k = 0; k < ops.size(); ++k) {
+		const Op& op = ops[k];
+		for(size_t i = 0; i <= op.operands.size(); ++i) {
+			IrInstr* value = (i < op.operands.size()) ? op.operands[i] : op.special;
+			if(value == 0 || value->block != block_ || stackUse_[value->id] != -2) {
+				continue;
+			}
+			bool candidate = (i < op.operands.size()) && value->opcode != IR_PHI && !remat_[value->id];
+			stackUse_[value->id] = candidate ? (int)k : -1;
+			stacked_[value->id] = candidate;
+		}
+	}
+
+	vector<IrInstr*> pending;
+	for(size_t k = 0; k < ops.size(); ++k) {
+		const Op& op = ops[k];
+		const vector<IrInstr*>& operands = op.operands;
+
+		// Наибольшее число первых операндов, лежащих на вершине стека
+		size_t matched = min(operands.size(), pending.size());
+		for(; matched > 0; --matched) {
+			size_t base = pending.size() - matched;
+			size_t i = 0;
+			while(i < matched && pending[base + i] == operands[i] && stackUse_[operands[i]->id] == (int)k) {
+				++i;
+			}
+			if(i == matched) {
+				break;
+			}
+		}
+		pending.resize(pending.size() - matched);
+
+		// Остальные ожидавшие этой операции значения сохраняются в ячейках
+		for(size_t i = matched; i < operands.size(); ++i) {
+			IrInstr* value = operands[i];
+			if(value->block == block_ && stackUse_[value->id] == (int)k && stacked_[value->id]
+				&& find(operands.begin(), operands.begin() + matched, value) == operands.begin() + matched) {
+				stacked_[value->id] = 0;
+				pending.erase(find(pending.begin(), pending.end(), value));
+			}
+		}
+
+		if(op.instr != 0 && op.instr->hasValue() && stacked_[op.instr->id]) {
+			pending.push_back(op.instr);
+		}
+	}
+}
+
+IrLowering::Source IrLowering::getSource(const Op& op, int opIndex, size_t i) const
+{
+	IrInstr* value = op.operands[i];
+	if(value->block == block_ && stacked_[value->id] && stackUse_[value->id] == opIndex
+		&& find(op.operands.begin(), op.operands.end(), value) == op.operands.begin() + i) {
+		return FROM_STACK;
+	}
+	if(i > 0 && op.operands[i - 1] == value) {
+		return FROM_DUP;
+	}
+	return remat_[value->id] ? FROM_REMAT : FROM_SLOT;
+}
+
+void IrLowering::markSources(const vector<Op>& ops)
+{
+	for(size_t k = 0; k < ops.size(); ++k) {
+		const Op& op = ops[k];
+		for(size_t i = 0; i < op.operands.size(); ++i) {
+			if(getSource(op, k, i) == FROM_SLOT) {
+				needsSlot_[op.operands[i]->id] = 1;
+				lastUse_[op.operands[i]->id] = k;
+			}
+		}
+		if(op.special != 0 && !remat_[op.special->id]) {
+			needsSlot_[op.special->id] = 1;
+			lastUse_[op.special->id] = k;
+		}
+		for(size_t i = 0; i < op.phis.size(); ++i) {
+			needsSlot_[op.phis[i]->id] = 1;
+		}
+	}
+}
+
+// Ячейка значения, используемого только в своем блоке, освобождается после
+// последнего чтения и может быть занята следующим значением
+void IrLowering::assignSlots(const vector<Op>& ops)
+{
+	vector<int> free;
+	int used = 0;
+	for(size_t k = 0; k < ops.size(); ++k) {
+		const Op& op = ops[k];
+		for(size_t i = 0; i <= op.operands.size(); ++i) {
+			IrInstr* value = (i < op.operands.size()) ? op.operands[i] : op.special;
+			if(value != 0 && !global_[value->id] && lastUse_[value->id] == (int)k) {
+				free.push_back(slot_[value->id]);
+				lastUse_[value->id] = -1;
+			}
+		}
+		IrInstr* instr = op.instr;
+		if(instr != 0 && instr->hasValue() && needsSlot_[instr->id] && !global_[instr->id]) {
+			if(free.empty()) {
+				slot_[instr->id] = globalCount_ + used++;
+			}
+			else {
+				slot_[instr->id] = free.back();
+				free.pop_back();
+			}
+		}
+	}
+	localCount_ = max(localCount_, used);
+}
+
+void IrLowering::emitBlock(const vector<Op>& ops, IrBlock* next)
+{
+	blockAddress_[block_->id] = codegen_->getCurrentAddress();
+	for(size_t k = 0; k < ops.size(); ++k) {
+		const Op& op = ops[k];
+		for(size_t i = 0; i < op.operands.size(); ++i) {
+			pushOperand(op, k, i);
+		}
+
+		IrInstr* instr = op.instr;
+		if(instr == 0) {
+			for(size_t i = op.phis.size(); i > 0; --i) {
+				codegen_->emit(STORE, tempAddress(op.phis[i - 1]));
+			}
+			continue;
+		}
+
+		switch(instr->opcode) {
+			case IR_ADD:
+				codegen_->emit(ADD);
+				break;
+			case IR_SUB:
+				codegen_->emit(SUB);
+				break;
+			case IR_MULT:
+				codegen_->emit(MULT);
+				break;
+			case IR_DIV:
+				codegen_->emit(DIV);
+				break;
+			case IR_NEG:
+				codegen_->emit(INVERT);
+				break;
+			case IR_COMPARE:
+				codegen_->emit(COMPARE, instr->value);
+				break;
+			case IR_INPUT:
+				codegen_->emit(INPUT);
+				break;
+			case IR_PRINT:
+				codegen_->emit(PRINT);
+				break;
+			case IR_LOAD:
+				codegen_->emit(LOAD, shift(instr->value));
+				break;
+			case IR_STORE:
+				codegen_->emit(STORE, shift(instr->value));
+				break;
+			case IR_BLOAD:
+				codegen_->emit(BLOAD, shift(instr->value));
+				break;
+			case IR_BSTORE:
+				codegen_->emit(BSTORE, shift(instr->value));
+				break;
+
+			// Та же последовательность команд, что формирует AstCodeGen
+			case IR_CHECK:
+				codegen_->emit(DUP);
+				codegen_->emit(DUP);
+				materialize(op.special);
+				codegen_->emit(COMPARE, 2);
+				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+				codegen_->emit(JUMP, -1);
+				codegen_->emit(PUSH, 0);
+				codegen_->emit(COMPARE, 5);
+				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
+				codegen_->emit(JUMP, -1);
+				break;
+
+			case IR_RAW:
+				emitRaw(function_->getRaw(instr->value));
+				break;
+
+			case IR_JUMP:
+				if(block_->succs[0] != next) {
+					fixups_.push_back(make_pair(codegen_->getCurrentAddress(), block_->succs[0]));
+					codegen_->emit(JUMP, 0);
+				}
+				break;
+
+			case IR_BRANCH: {
+				IrBlock* yes = block_->succs[0];
+				IrBlock* no = block_->succs[1];
+				if(yes == no) {
+					codegen_->emit(POP);
+				}
+				else if(yes == next) {
+					fixups_.push_back(make_pair(codegen_->getCurrentAddress(), no));
+					codegen_->emit(JUMP_NO, 0);
+					break;
+				}
+				else {
+					fixups_.push_back(make_pair(codegen_->getCurrentAddress(), yes));
+					codegen_->emit(JUMP_YES, 0);
+				}
+				if(no != next) {
+					fixups_.push_back(make_pair(codegen_->getCurrentAddress(), no));
+					codegen_->emit(JUMP, 0);
+				}
+				break;
+			}
+
+			case IR_STOP:
+				codegen_->emit(STOP);
+				break;
+
+			default:
+				break;
+		}
+
+		if(instr->hasValue()) {
+			defineValue(instr);
+		}
+	}
+}
+
+void IrLowering::pushOperand(const Op& op, int opIndex, size_t i)
+{
+	switch(getSource(op, opIndex, i)) {
+		case FROM_STACK:
+			break;
+		case FROM_DUP:
+			codegen_->emit(DUP);
+			break;
+		default:
+			materialize(op.operands[i]);
+			break;
+	}
+}
+
+void IrLowering::materialize(IrInstr* value)
+{
+	if(!remat_[value->id]) {
+		codegen_->emit(LOAD, tempAddress(value));
+	}
+	else if(value->opcode == IR_CONST) {
+		codegen_->emit(PUSH, value->value);
+	}
+	else {
+		codegen_->emit(LOAD, shift(value->value));
+	}
+}
+
+void IrLowering::defineValue(IrInstr* value)
+{
+	if(stacked_[value->id]) {
+		if(needsSlot_[value->id]) {
+			codegen_->emit(DUP);
+			codegen_->emit(STORE, tempAddress(value));
+		}
+	}
+	else if(needsSlot_[value->id]) {
+		codegen_->emit(STORE, tempAddress(value));
+	}
+	else {
+		codegen_->emit(POP);
+	}
+}
+
+// Переходы фрагмента отсчитываются от его начала, адреса ячеек программы
+// сдвигаются; служебные ячейки 0..2 остаются на месте
+void IrLowering::emitRaw(const IrRaw& raw)
+{
+	int start = codegen_->getCurrentAddress();
+	for(size_t i = 0; i < raw.code.size(); ++i) {
+		Instruction instruction = raw.code[i].getInstruction();
+		int arg = raw.code[i].getArg();
+		switch(instruction) {
+			case JUMP:
+			case JUMP_YES:
+			case JUMP_NO:
+				codegen_->emit(instruction, (arg >= 0) ? arg + start : arg);
+				break;
+			case LOAD:
+			case STORE:
+			case BLOAD:
+			case BSTORE:
+				codegen_->emit(instruction, shift(arg));
+				break;
+			case PUSH:
+			case COMPARE:
+				codegen_->emit(instruction, arg);
+				break;
+			default:
+				codegen_->emit(instruction);
+				break;
+		}
+	}
+}
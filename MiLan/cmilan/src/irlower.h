@@ -0,0 +1,104 @@
+#ifndef CMILAN_IRLOWER_H
+#define CMILAN_IRLOWER_H
+
+#include "ir.h"
+#include "codegen.h"
+#include <vector>
+
+using namespace std;
+
+// Перевод промежуточного представления в команды виртуальной машины.
+//
+// Блоки размещаются в порядке IrFunction::getBlocks(); переход к следующему
+// по порядку блоку не формируется. Phi-функции заменяются копированием
+// значений в конце предшественников (критические дуги предварительно
+// разбиваются).
+//
+// Значение, которое используется один раз в том же блоке и к моменту
+// использования оказывается на вершине стека, остается в стеке. Константы
+// и чтения ячеек, не измененных до единственного использования, повторяются
+// в месте использования. Остальные значения хранятся во временных ячейках,
+// которые занимают адреса 3, 4, ... (сразу за служебными ячейками 0..2);
+// переменные и массивы программы сдвигаются на число временных ячеек.
+
+class IrLowering
+{
+public:
+	IrLowering(IrFunction* function, CodeGen* codegen)
+		: function_(function), codegen_(codegen), block_(0), tempCount_(0),
+		  globalCount_(0), localCount_(0)
+	{
+	}
+
+	// Формирование программы
+	void lower();
+
+	// Число временных ячеек (на столько же сдвинуты адреса программы)
+	int getTempCount() const
+	{
+		return tempCount_;
+	}
+
+private:
+	static const int FIRST_TEMP = 3;	// адрес первой временной ячейки
+
+	// Способ получения операнда
+	enum Source
+	{
+		FROM_STACK,	// значение уже на вершине стека
+		FROM_DUP,	// копия предыдущего операнда (DUP)
+		FROM_REMAT,	// повторное вычисление (PUSH или LOAD)
+		FROM_SLOT	// чтение временной ячейки
+	};
+
+	// Операция блока: инструкция или копирование значений phi-функций
+	// преемника (instr == 0)
+	struct Op
+	{
+		IrInstr* instr;			// инструкция
+		vector<IrInstr*> operands;	// операнды, помещаемые в стек перед операцией
+		IrInstr* special;		// размер массива для IR_CHECK (вычисляется внутри проверки)
+		vector<IrInstr*> phis;		// phi-функции, которым присваиваются operands
+	};
+
+	void prepare();			// упрощение phi-функций и разбиение критических дуг
+	void findRemat();		// значения, вычисляемые в месте использования
+	void buildOps(IrBlock* block, vector<Op>& ops);
+	void stackify(const vector<Op>& ops);	// какие значения остаются в стеке
+	void markSources(const vector<Op>& ops);	// какие значения нужны во временных ячейках
+	void assignSlots(const vector<Op>& ops);	// временные ячейки блока
+	void emitBlock(const vector<Op>& ops, IrBlock* next);
+	Source getSource(const Op& op, int opIndex, size_t i) const;
+	void pushOperand(const Op& op, int opIndex, size_t i);
+	void materialize(IrInstr* value);
+	void defineValue(IrInstr* value);	// сохранение вычисленного значения
+	void emitRaw(const IrRaw& raw);
+
+	int shift(int address) const	// адрес ячейки программы после размещения временных
+	{
+		return (address >= FIRST_TEMP) ? address + tempCount_ : address;
+	}
+
+	int tempAddress(IrInstr* value) const
+	{
+		return FIRST_TEMP + slot_[value->id];
+	}
+
+	IrFunction* function_;
+	CodeGen* codegen_;
+	IrBlock* block_;		// обрабатываемый блок
+	int tempCount_;			// число временных ячеек
+	vector<char> remat_;		// значение вычисляется в месте использования
+	vector<int> stackUse_;		// номер операции блока, берущей значение из стека (-1 - нет)
+	vector<char> stacked_;		// значение остается в стеке до stackUse_
+	vector<char> needsSlot_;	// значение читается из временной ячейки
+	vector<char> global_;		// значение используется в других блоках
+	vector<int> lastUse_;		// последняя операция блока, читающая временную ячейку
+	vector<int> slot_;		// номер временной ячейки
+	int globalCount_;		// число ячеек для значений, используемых в разных блоках
+	int localCount_;		// число ячеек, общих для всех блоков
+	vector<int> blockAddress_;	// адреса начала блоков
+	vector< pair<int, IrBlock*> > fixups_;	// переходы, адрес которых еще не известен
+};
+
+#endif
@@ -0,0 +1,661 @@
+#include "jit.h"
+#include "stackdepth.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define CMILAN_JIT
+#include <sys/mman.h>
+#endif
+
+// Контекст исполнения. Сгенерированный код получает его адрес в регистре r14.
+struct JitContext
+{
+	istream* input;		// входной поток команды INPUT
+	ostream* output;	// выходной поток команды PRINT
+	int address;		// адрес инструкции, на которой остановилась программа
+	int inputValue;		// число, прочитанное командой INPUT
+};
+
+// Функции, которые вызывает сгенерированный код
+
+static void jitPrint(JitContext* context, int value)
+{
+	*context->output << value << '\n';
+}
+
+static int jitInput(JitContext* context)
+{
+	int value;
+	if(!(*context->input >> value)) {
+		return 0;
+	}
+	context->inputValue = value;
+	return 1;
+}
+
+#ifdef CMILAN_JIT
+
+// Регистры x86-64
+enum Register
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Коды условий для команд Jcc и SETcc
+enum Condition
+{
+	CC_AE = 0x3,
+	CC_E = 0x4,
+	CC_NE = 0x5,
+	CC_L = 0xC,
+	CC_GE = 0xD,
+	CC_LE = 0xE,
+	CC_G = 0xF
+};
+
+// Операнд r/m: регистр или слово в памяти по адресу base + index * 4 + disp
+struct Operand
+{
+	int reg;	// регистр или -1 для операнда в памяти
+	int base;	// базовый регистр
+	int index;	// индексный регистр или -1
+	int disp;	// смещение
+
+	static Operand direct(int reg)
+	{
+		Operand op = { reg, -1, -1, 0 };
+		return op;
+	}
+
+	static Operand memory(int base, int disp, int index = -1)
+	{
+		Operand op = { -1, base, index, disp };
+		return op;
+	}
+
+	bool isRegister() const
+	{
+		return reg >= 0;
+	}
+};
+
+// Простейший ассемблер x86-64: кодирует только те команды, которые нужны
+// для трансляции инструкций виртуальной машины.
+
+class Assembler
+{
+public:
+	size_t size() const
+	{
+		return code_.size();
+	}
+
+	const vector<unsigned char>& getCode() const
+	{
+		return code_;
+	}
+
+	void byte(int b)
+	{
+		code_.push_back((unsigned char)b);
+	}
+
+	void dword(int value)
+	{
+		unsigned v = (unsigned)value;
+		for(int i = 0; i < 4; ++i) {
+			byte((v >> (8 * i)) & 0xFF);
+		}
+	}
+
+	// Команда с операндом r/m.
+	//     bool wide - 64-битный размер операнда (REX.W)
+	//     opcode, opcode2 - код операции (второй байт, если не 0)
+	//     int reg - поле reg байта ModRM (регистр или расширение кода операции)
+	void op(bool wide, int opcode, int opcode2, int reg, const Operand& rm)
+	{
+		int b = rm.isRegister() ? rm.reg : rm.base;
+		int x = (!rm.isRegister() && rm.index >= 0) ? rm.index : 0;
+		int rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((x >> 3) & 1) << 1 | ((b >> 3) & 1);
+		if(rex != 0x40) {
+			byte(rex);
+		}
+		byte(opcode);
+		if(opcode2 != 0) {
+			byte(opcode2);
+		}
+
+		if(rm.isRegister()) {
+			byte(0xC0 | (reg & 7) << 3 | (rm.reg & 7));
+		}
+		else if(rm.index >= 0) {
+			byte(0x80 | (reg & 7) << 3 | 4);
+			byte(0x80 | (rm.index & 7) << 3 | (rm.base & 7));
+			dword(rm.disp);
+		}
+		else {
+			byte(0x80 | (reg & 7) << 3 | (rm.base & 7));
+			if((rm.base & 7) == RSP) {
+				byte(0x24);
+			}
+			dword(rm.disp);
+		}
+	}
+
+	// mov r32, r/m32
+	void movLoad(int reg, const Operand& rm)
+	{
+		if(!(rm.isRegister() && rm.reg == reg)) {
+			op(false, 0x8B, 0, reg, rm);
+		}
+	}
+
+	// mov r/m32, r32
+	void movStore(const Operand& rm, int reg)
+	{
+		if(!(rm.isRegister() && rm.reg == reg)) {
+			op(false, 0x89, 0, reg, rm);
+		}
+	}
+
+	// mov r/m32, imm32
+	void movImm(const Operand& rm, int value)
+	{
+		op(false, 0xC7, 0, 0, rm);
+		dword(value);
+	}
+
+	// mov r64, r64
+	void movReg64(int dst, int src)
+	{
+		op(true, 0x8B, 0, dst, Operand::direct(src));
+	}
+
+	// mov rax, imm64
+	void movRaxImm64(const void* value)
+	{
+		unsigned long long v = (unsigned long long)value;
+		byte(0x48);
+		byte(0xB8);
+		for(int i = 0; i < 8; ++i) {
+			byte((v >> (8 * i)) & 0xFF);
+		}
+	}
+
+	void push(int reg)
+	{
+		if(reg >= 8) {
+			byte(0x41);
+		}
+		byte(0x50 | (reg & 7));
+	}
+
+	void pop(int reg)
+	{
+		if(reg >= 8) {
+			byte(0x41);
+		}
+		byte(0x58 | (reg & 7));
+	}
+
+	// add/sub r64, imm32
+	void addRsp(int value)
+	{
+		op(true, 0x81, 0, 0, Operand::direct(RSP));
+		dword(value);
+	}
+
+	void subRsp(int value)
+	{
+		op(true, 0x81, 0, 5, Operand::direct(RSP));
+		dword(value);
+	}
+
+	// Переходы с 32-битным смещением. Возвращают позицию смещения для patch().
+	size_t jmp()
+	{
+		byte(0xE9);
+		dword(0);
+		return size() - 4;
+	}
+
+	size_t jcc(int condition)
+	{
+		byte(0x0F);
+		byte(0x80 | condition);
+		dword(0);
+		return size() - 4;
+	}
+
+	// Запись в позицию position смещения перехода на адрес target
+	void patch(size_t position, size_t target)
+	{
+		int rel = (int)(target - (position + 4));
+		for(int i = 0; i < 4; ++i) {
+			code_[position + i] = (unsigned char)(((unsigned)rel >> (8 * i)) & 0xFF);
+		}
+	}
+
+private:
+	vector<unsigned char> code_;
+};
+
+// Транслятор программы виртуальной машины в машинный код
+
+class JitCompiler
+{
+public:
+	JitCompiler(const vector<Command>& program, int memorySize, int stackSize)
+		: program_(program), count_(program.size()), memorySize_(memorySize),
+		  analysis_(program, memorySize, stackSize)
+	{
+	}
+
+	// Анализ глубины стека и трансляция. Возвращает false, если программу
+	// нельзя скомпилировать.
+	bool compile();
+
+	const vector<unsigned char>& getCode() const
+	{
+		return asm_.getCode();
+	}
+
+private:
+	// Число регистров, в которых хранятся нижние слова стека
+	static const int STACK_REGISTERS = 4;
+
+	// Переход на обработчик ошибки времени исполнения
+	struct Stub
+	{
+		size_t position;	// позиция смещения перехода
+		int address;		// адрес инструкции
+		VmStatus status;	// код ошибки
+	};
+
+	int emit(int address);
+
+	// Место слова стека с номером slot (считая от дна стека)
+	Operand slot(int slot) const
+	{
+		static const int registers[STACK_REGISTERS] = { RBX, RBP, R12, R13 };
+		if(slot < STACK_REGISTERS) {
+			return Operand::direct(registers[slot]);
+		}
+		return Operand::memory(RSP, 4 * (slot - STACK_REGISTERS));
+	}
+
+	// Ячейка памяти данных
+	Operand cell(int address) const
+	{
+		return Operand::memory(R15, 4 * address);
+	}
+
+	// Поле контекста исполнения
+	Operand context(size_t offset) const
+	{
+		return Operand::memory(R14, (int)offset);
+	}
+
+	void emitExit(int address, VmStatus status);
+	void emitJump(int condition, int target, int address);
+	void emitCall(const void* function);
+
+	const vector<Command>& program_;
+	const int count_;
+	const int memorySize_;
+	StackDepth analysis_;		// глубина стека перед инструкциями
+	vector<long> labels_;		// смещение кода инструкции (-1 - не сгенерирован)
+	vector<pair<size_t, int> > fixups_;	// переходы на инструкции
+	vector<Stub> stubs_;		// переходы на обработчики ошибок
+	vector<size_t> exits_;		// переходы на эпилог
+	Assembler asm_;
+};
+
+// Выход из сгенерированного кода с кодом status на инструкции address
+void JitCompiler::emitExit(int address, VmStatus status)
+{
+	asm_.movImm(context(offsetof(JitContext, address)), address);
+	asm_.movImm(Operand::direct(RAX), status);
+	exits_.push_back(asm_.jmp());
+}
+
+// Переход (условный, если condition >= 0) на инструкцию target, выполняемый
+// инструкцией address. Переход за пределы программы - ошибка VM_ABORT.
+void JitCompiler::emitJump(int condition, int target, int address)
+{
+	size_t position = (condition >= 0) ? asm_.jcc(condition) : asm_.jmp();
+	if(analysis_.isValidTarget(target)) {
+		fixups_.push_back(make_pair(position, target));
+	}
+	else {
+		Stub stub = { position, address, VM_ABORT };
+		stubs_.push_back(stub);
+	}
+}
+
+void JitCompiler::emitCall(const void* function)
+{
+	asm_.movReg64(RDI, R14);
+	asm_.movRaxImm64(function);
+	asm_.op(false, 0xFF, 0, 2, Operand::direct(RAX));
+}
+
+// Трансляция достижимой инструкции address. Возвращает адрес инструкции,
+// на которую управление переходит без перехода, или -1.
+int JitCompiler::emit(int address)
+{
+	static const int conditions[] = { CC_E, CC_NE, CC_L, CC_G, CC_LE, CC_GE };
+
+	const Command& command = program_[address];
+	const int depth = analysis_.getDepth(address);
+	const int arg = command.getArg();
+	const int top = depth - 1;
+
+	VmStatus failure = analysis_.getFailure(address);
+	if(failure != VM_OK) {
+		emitExit(address, failure);
+		return -1;
+	}
+
+	switch(command.getInstruction()) {
+		case NOP:
+			break;
+
+		case STOP:
+			emitExit(address, VM_OK);
+			return -1;
+
+		case LOAD:
+			if(slot(depth).isRegister()) {
+				asm_.movLoad(slot(depth).reg, cell(arg));
+			}
+			else {
+				asm_.movLoad(RAX, cell(arg));
+				asm_.movStore(slot(depth), RAX);
+			}
+			break;
+
+		case STORE:
+			if(slot(top).isRegister()) {
+				asm_.movStore(cell(arg), slot(top).reg);
+			}
+			else {
+				asm_.movLoad(RAX, slot(top));
+				asm_.movStore(cell(arg), RAX);
+			}
+			break;
+
+		case BLOAD:
+		case BSTORE: {
+			// eax = arg + индекс; при выходе за пределы памяти - ошибка
+			asm_.movLoad(RAX, slot(top));
+			if(arg != 0) {
+				asm_.op(false, 0x81, 0, 0, Operand::direct(RAX));
+				asm_.dword(arg);
+			}
+			asm_.op(false, 0x81, 0, 7, Operand::direct(RAX));
+			asm_.dword(memorySize_);
+			Stub stub = { asm_.jcc(CC_AE), address, VM_BAD_ADDRESS };
+			stubs_.push_back(stub);
+
+			if(command.getInstruction() == BLOAD) {
+				asm_.movLoad(RAX, Operand::memory(R15, 0, RAX));
+				asm_.movStore(slot(top), RAX);
+			}
+			else {
+				asm_.movLoad(RCX, slot(top - 1));
+				asm_.movStore(Operand::memory(R15, 0, RAX), RCX);
+			}
+			break;
+		}
+
+		case PUSH:
+			asm_.movImm(slot(depth), arg);
+			break;
+
+		case POP:
+			break;
+
+		case DUP:
+			if(slot(depth).isRegister()) {
+				asm_.movLoad(slot(depth).reg, slot(top));
+			}
+			else {
+				asm_.movLoad(RAX, slot(top));
+				asm_.movStore(slot(depth), RAX);
+			}
+			break;
+
+		case ADD:
+		case SUB:
+		case MULT: {
+			int opcode = (command.getInstruction() == ADD) ? 0x03 :
+				(command.getInstruction() == SUB) ? 0x2B : 0x0F;
+			int opcode2 = (command.getInstruction() == MULT) ? 0xAF : 0;
+			Operand left = slot(top - 1);
+			int reg = left.isRegister() ? left.reg : RAX;
+			asm_.movLoad(reg, left);
+			asm_.op(false, opcode, opcode2, reg, slot(top));
+			asm_.movStore(left, reg);
+			break;
+		}
+
+		case DIV: {
+			// Деление на -1 выполняется как изменение знака, чтобы INT_MIN / -1
+			// не вызывало аппаратное исключение
+			asm_.movLoad(RCX, slot(top));
+			asm_.op(false, 0x85, 0, RCX, Operand::direct(RCX));
+			Stub stub = { asm_.jcc(CC_E), address, VM_DIVISION_BY_ZERO };
+			stubs_.push_back(stub);
+			asm_.movLoad(RAX, slot(top - 1));
+			asm_.op(false, 0x81, 0, 7, Operand::direct(RCX));
+			asm_.dword(-1);
+			size_t divide = asm_.jcc(CC_NE);
+			asm_.op(false, 0xF7, 0, 3, Operand::direct(RAX));
+			size_t done = asm_.jmp();
+			asm_.patch(divide, asm_.size());
+			asm_.byte(0x99);
+			asm_.op(false, 0xF7, 0, 7, Operand::direct(RCX));
+			asm_.patch(done, asm_.size());
+			asm_.movStore(slot(top - 1), RAX);
+			break;
+		}
+
+		case INVERT:
+			asm_.op(false, 0xF7, 0, 3, slot(top));
+			break;
+
+		case COMPARE: {
+			Operand left = slot(top - 1);
+			int reg = left.isRegister() ? left.reg : RAX;
+			asm_.movLoad(reg, left);
+			asm_.op(false, 0x3B, 0, reg, slot(top));
+
+			// COMPARE; JUMP_YES|JUMP_NO транслируются в cmp; jcc
+			if(address + 1 < count_ && analysis_.getTargetCount(address + 1) == 0
+				&& (program_[address + 1].getInstruction() == JUMP_YES
+					|| program_[address + 1].getInstruction() == JUMP_NO)) {
+				int condition = conditions[arg];
+				if(program_[address + 1].getInstruction() == JUMP_NO) {
+					condition ^= 1;
+				}
+				emitJump(condition, program_[address + 1].getArg(), address + 1);
+				labels_[address + 1] = -2;	// инструкция уже сгенерирована
+				return address + 2;
+			}
+
+			asm_.op(false, 0x0F, 0x90 | conditions[arg], 0, Operand::direct(RAX));
+			asm_.op(false, 0x0F, 0xB6, RAX, Operand::direct(RAX));
+			asm_.movStore(left, RAX);
+			break;
+		}
+
+		case JUMP:
+			emitJump(-1, arg, address);
+			return -1;
+
+		case JUMP_YES:
+		case JUMP_NO: {
+			Operand value = slot(top);
+			if(value.isRegister()) {
+				asm_.op(false, 0x85, 0, value.reg, value);
+			}
+			else {
+				asm_.op(false, 0x81, 0, 7, value);
+				asm_.dword(0);
+			}
+			emitJump((command.getInstruction() == JUMP_YES) ? CC_NE : CC_E, arg, address);
+			break;
+		}
+
+		case INPUT: {
+			emitCall((const void*)&jitInput);
+			asm_.op(false, 0x85, 0, RAX, Operand::direct(RAX));
+			Stub stub = { asm_.jcc(CC_E), address, VM_INPUT_ERROR };
+			stubs_.push_back(stub);
+			asm_.movLoad(RAX, context(offsetof(JitContext, inputValue)));
+			asm_.movStore(slot(depth), RAX);
+			break;
+		}
+
+		case PRINT:
+			asm_.movLoad(RSI, slot(top));
+			emitCall((const void*)&jitPrint);
+			break;
+
+		default:
+			break;
+	}
+	return address + 1;
+}
+
+bool JitCompiler::compile()
+{
+	if(!analysis_.analyze()) {
+		return false;
+	}
+
+	// Пролог: сохранение регистров, выделение кадра для слов стека,
+	// не поместившихся в регистры (rsp остается выровненным на 16 байт)
+	static const int saved[] = { RBX, RBP, R12, R13, R14, R15 };
+	int spilled = max(0, analysis_.getMaxDepth() - STACK_REGISTERS);
+	int frame = (4 * spilled + 15) / 16 * 16 + 8;
+	for(int i = 0; i < 6; ++i) {
+		asm_.push(saved[i]);
+	}
+	asm_.subRsp(frame);
+	asm_.movReg64(R14, RDI);
+	asm_.movReg64(R15, RSI);
+
+	labels_.assign(count_, -1);
+	for(int address = 0; address < count_; ++address) {
+		if(analysis_.getDepth(address) < 0 || labels_[address] == -2) {
+			continue;
+		}
+		labels_[address] = asm_.size();
+
+		// Выход за конец программы: ошибка относится к последней инструкции
+		if(emit(address) == count_) {
+			emitExit(count_ - 1, VM_ABORT);
+		}
+	}
+	if(count_ == 0) {
+		emitExit(0, VM_ABORT);
+	}
+
+	for(size_t i = 0; i < fixups_.size(); ++i) {
+		asm_.patch(fixups_[i].first, labels_[fixups_[i].second]);
+	}
+	for(size_t i = 0; i < stubs_.size(); ++i) {
+		asm_.patch(stubs_[i].position, asm_.size());
+		emitExit(stubs_[i].address, stubs_[i].status);
+	}
+
+	// Эпилог
+	for(size_t i = 0; i < exits_.size(); ++i) {
+		asm_.patch(exits_[i], asm_.size());
+	}
+	asm_.addRsp(frame);
+	for(int i = 5; i >= 0; --i) {
+		asm_.pop(saved[i]);
+	}
+	asm_.byte(0xC3);
+	return true;
+}
+
+#endif
+
+Jit::~Jit()
+{
+	release();
+}
+
+void Jit::release()
+{
+#ifdef CMILAN_JIT
+	if(code_ != 0) {
+		munmap(code_, codeSize_);
+	}
+#endif
+	code_ = 0;
+	codeSize_ = 0;
+}
+
+bool Jit::isSupported()
+{
+#ifdef CMILAN_JIT
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Jit::compile(const vector<Command>& program)
+{
+	release();
+	fill(memory_.begin(), memory_.end(), 0);
+	address_ = 0;
+
+#ifdef CMILAN_JIT
+	JitCompiler compiler(program, memory_.size(), stackSize_);
+	if(!compiler.compile()) {
+		return false;
+	}
+
+	const vector<unsigned char>& code = compiler.getCode();
+	void* memory = mmap(0, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED) {
+		return false;
+	}
+	memcpy(memory, &code[0], code.size());
+	if(mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, code.size());
+		return false;
+	}
+	code_ = memory;
+	codeSize_ = code.size();
+	return true;
+#else
+	(void)program;
+	return false;
+#endif
+}
+
+VmStatus Jit::run()
+{
+	typedef int (*Entry)(JitContext* context, int* memory);
+
+	if(code_ == 0) {
+		return VM_BAD_INSTRUCTION;
+	}
+
+	JitContext context = { &input_, &output_, 0, 0 };
+	Entry entry = reinterpret_cast<Entry>(code_);
+	VmStatus status = (VmStatus)entry(&context, &memory_[0]);
+	address_ = context.address;
+	output_.flush();
+	return status;
+}
@@ -0,0 +1,85 @@
+#ifndef CMILAN_JIT_H
+#define CMILAN_JIT_H
+
+#include "codegen.h"
+#include "vm.h"
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// JIT-компилятор программ виртуальной машины Милана в машинный код x86-64.
+//
+// Альтернатива интерпретатору VirtualMachine с той же семантикой: команды
+// PRINT и INPUT работают с переданными потоками, ошибки времени исполнения
+// (в том числе JUMP -1) сообщаются теми же кодами VmStatus и с теми же адресами.
+//
+// При компиляции для каждой достижимой инструкции вычисляется глубина стека.
+// Поэтому проверки переполнения стека выполняются во время компиляции, а слова
+// стека отображаются на фиксированные места: нижние слова хранятся в регистрах,
+// остальные - в кадре машинного стека. Память данных адресуется относительно
+// базового регистра.
+//
+// Если программу нельзя скомпилировать (другая архитектура, разная глубина
+// стека в точках слияния, слишком глубокий стек), compile() возвращает false,
+// и программу следует исполнить интерпретатором.
+
+class Jit
+{
+public:
+	// Конструктор
+	//     istream& input - поток, из которого читает команда INPUT
+	//     ostream& output - поток, в который печатает команда PRINT
+	Jit(istream& input, ostream& output,
+		int memorySize = VirtualMachine::DEFAULT_MEMORY_SIZE,
+		int stackSize = VirtualMachine::DEFAULT_STACK_SIZE)
+		: input_(input), output_(output), memory_(memorySize, 0), stackSize_(stackSize),
+		  code_(0), codeSize_(0), address_(0)
+	{
+	}
+
+	~Jit();
+
+	// Доступен ли JIT-компилятор на этой платформе
+	static bool isSupported();
+
+	// Компиляция программы. Память данных при этом обнуляется.
+	// Возвращает false, если программу нельзя исполнить JIT-компилятором.
+	bool compile(const vector<Command>& program);
+
+	// Исполнение скомпилированной программы с адреса 0
+	VmStatus run();
+
+	// Адрес инструкции, на которой остановилась программа
+	int getAddress() const
+	{
+		return address_;
+	}
+
+	// Чтение и запись ячейки памяти данных
+	int getMemory(int address) const
+	{
+		return memory_[address];
+	}
+
+	void setMemory(int address, int value)
+	{
+		memory_[address] = value;
+	}
+
+private:
+	Jit(const Jit&);
+	Jit& operator=(const Jit&);
+
+	void release(); // освобождение исполняемой памяти
+
+	istream& input_;	// входной поток команды INPUT
+	ostream& output_;	// выходной поток команды PRINT
+	vector<int> memory_;	// память данных
+	int stackSize_;		// размер стека в словах
+	void* code_;		// исполняемый код
+	size_t codeSize_;	// размер отображенной области кода
+	int address_;		// адрес инструкции, на которой остановилась программа
+};
+
+#endif
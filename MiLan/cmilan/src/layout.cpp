@@ -0,0 +1,41 @@
+#include "layout.h"
+#include "dominators.h"
+#include <algorithm>
+
+bool BlockLayout::run(IrFunction& function)
+{
+	DominatorTree dominators(function);
+	const vector<IrBlock*>& order = dominators.getOrder();
+	vector<IrBlock*>& blocks = function.getBlocks();
+	bool changed = false;
+
+	for(size_t i = 0; i < order.size(); ++i) {
+		IrBlock* header = order[i];
+		vector<char> inLoop;
+		if(!dominators.findLoop(header, inLoop)) {
+			continue;
+		}
+
+		// Условие цикла с одним переходом внутрь и одним наружу
+		IrInstr* terminator = header->getTerminator();
+		if(terminator->opcode != IR_BRANCH
+			|| inLoop[header->succs[0]->id] == inLoop[header->succs[1]->id]) {
+			continue;
+		}
+
+		// Тело должно занимать непрерывный участок сразу за заголовком
+		size_t first = find(blocks.begin(), blocks.end(), header) - blocks.begin();
+		size_t last = first;
+		while(last + 1 < blocks.size() && inLoop[blocks[last + 1]->id]) {
+			++last;
+		}
+		size_t size = count(inLoop.begin(), inLoop.end(), 1);
+		if(last == first || last - first + 1 != size) {
+			continue;
+		}
+
+		rotate(blocks.begin() + first, blocks.begin() + first + 1, blocks.begin() + last + 1);
+		changed = true;
+	}
+	return changed;
+}
@@ -0,0 +1,32 @@
+#ifndef CMILAN_LAYOUT_H
+#define CMILAN_LAYOUT_H
+
+#include "passes.h"
+
+// Размещение блоков (разворот циклов).
+//
+// Цикл WHILE строится как заголовок с условием, тело и выход; при
+// размещении в этом порядке каждая итерация выполняет два перехода: JUMP_NO
+// на выход (не выполняется) и JUMP в конце тела на заголовок. Проход
+// переносит заголовок за последний блок тела, если тело размещено сразу за
+// ним и заголовок завершается ветвлением внутрь цикла и наружу. Тогда тело
+// переходит в условие без команды перехода, условие переходит в начало тела
+// одной командой JUMP_YES (или JUMP_NO), а выход из цикла оказывается
+// следующим по порядку блоком. Перед первой итерацией выполняется один
+// переход на условие.
+//
+// Порядок остальных блоков не меняется: ветвь THEN размещается сразу за
+// условием, ELSE - за ней.
+
+class BlockLayout : public IrPass
+{
+public:
+	const char* getName() const
+	{
+		return "layout";
+	}
+
+	bool run(IrFunction& function);
+};
+
+#endif
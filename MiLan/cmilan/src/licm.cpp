@@ -0,0 +1,207 @@
+#include "licm.h"
+
+// Коды сравнения команды COMPARE, не зависящие от порядка операндов
+enum
+{
+	CMP_EQ,
+	CMP_NE
+};
+
+// Вычисляют ли инструкции одно и то же значение из одних и тех же операндов
+static bool isSameValue(const IrInstr* first, const IrInstr* second)
+{
+	if(first->opcode != second->opcode || first->value != second->value
+		|| first->operands.size() != second->operands.size()) {
+		return false;
+	}
+	if(first->operands == second->operands) {
+		return true;
+	}
+	bool commutative = first->opcode == IR_ADD || first->opcode == IR_MULT
+		|| (first->opcode == IR_COMPARE && (first->value == CMP_EQ || first->value == CMP_NE));
+	return commutative && first->operands.size() == 2
+		&& first->operands[0] == second->operands[1] && first->operands[1] == second->operands[0];
+}
+
+bool LoopInvariantCodeMotion::run(IrFunction& function)
+{
+	DominatorTree dominators(function);
+	const vector<IrBlock*>& order = dominators.getOrder();
+	bool changed = false;
+
+	// Заголовок вложенного цикла следует в порядке обхода за заголовком
+	// внешнего, поэтому обход с конца обрабатывает внутренние циклы первыми
+	for(size_t i = order.size(); i-- > 0;) {
+		IrBlock* header = order[i];
+		vector<char> inLoop;
+		if(!dominators.findLoop(header, inLoop)) {
+			continue;
+		}
+		if(hoist(function, dominators, header, inLoop)) {
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool LoopInvariantCodeMotion::hoist(IrFunction& function, const DominatorTree& dominators,
+	IrBlock* header, const vector<char>& inLoop)
+{
+	// Единственный вход в цикл, из которого управление всегда переходит
+	// в заголовок
+	IrBlock* preheader = 0;
+	for(size_t i = 0; i < header->preds.size(); ++i) {
+		IrBlock* pred = header->preds[i];
+		if(inLoop[pred->id]) {
+			continue;
+		}
+		if(preheader != 0) {
+			return false;
+		}
+		preheader = pred;
+	}
+	if(preheader == 0 || preheader->succs.size() != 1) {
+		return false;
+	}
+
+	const vector<IrBlock*>& order = dominators.getOrder();
+	writers_.clear();
+	for(size_t i = 0; i < order.size(); ++i) {
+		if(!inLoop[order[i]->id]) {
+			continue;
+		}
+		const vector<IrInstr*>& instrs = order[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			IrOpcode opcode = instrs[j]->opcode;
+			if(opcode == IR_STORE || opcode == IR_BSTORE || opcode == IR_RAW) {
+				writers_.push_back(instrs[j]);
+			}
+		}
+	}
+
+	// Операнды определяются раньше использований в порядке обхода
+	invariant_.assign(function.getInstrCount(), 0);
+	vector<IrInstr*> candidates;
+	for(size_t i = 0; i < order.size(); ++i) {
+		if(!inLoop[order[i]->id]) {
+			continue;
+		}
+		const vector<IrInstr*>& instrs = order[i]->instrs;
+		for(size_t j = 0; j < instrs.size(); ++j) {
+			if(isInvariant(function, instrs[j], inLoop)) {
+				invariant_[instrs[j]->id] = 1;
+				candidates.push_back(instrs[j]);
+			}
+		}
+	}
+
+	bool changed = false;
+	for(size_t i = 0; i < candidates.size(); ++i) {
+		IrInstr* instr = candidates[i];
+		if(instr->opcode == IR_LOAD) {
+			// Чтение ячейки само по себе не дороже чтения временной
+			// ячейки; оно выносится вместе с использующими его вычислениями
+			bool used = false;
+			for(size_t j = 0; j < instr->users.size() && !used; ++j) {
+				used = invariant_[instr->users[j]->id] != 0;
+			}
+			if(!used) {
+				continue;
+			}
+		}
+		IrInstr* existing = findHoisted(function, preheader, instr);
+		if(existing != 0) {
+			function.replaceAllUses(instr, existing);
+			function.remove(instr);
+		}
+		else {
+			function.moveBefore(instr, preheader->getTerminator());
+		}
+		changed = true;
+	}
+	return changed;
+}
+
+// Значение, равное instr, уже вычисленное в конце предшественника
+// (например, вынесенное раньше одинаковое выражение: нумерация значений
+// оставляет в цикле повторы дешевых выражений вроде n * 3)
+IrInstr* LoopInvariantCodeMotion::findHoisted(const IrFunction& function, IrBlock* preheader,
+	const IrInstr* instr) const
+{
+	const vector<IrInstr*>& instrs = preheader->instrs;
+	for(size_t i = instrs.size(); i-- > 0;) {
+		if(isSameValue(instrs[i], instr)) {
+			return instrs[i];
+		}
+		if(function.clobbers(instrs[i], instr)) {
+			break;
+		}
+	}
+	return 0;
+}
+
+bool LoopInvariantCodeMotion::isInvariant(const IrFunction& function, const IrInstr* instr,
+	const vector<char>& inLoop) const
+{
+	switch(instr->opcode) {
+		case IR_ADD:
+		case IR_SUB:
+		case IR_MULT:
+		case IR_NEG:
+			break;
+
+		case IR_COMPARE: {
+			// Сравнение, по которому сразу выполняется переход, виртуальная
+			// машина объединяет с чтением операндов и переходом
+			bool branchOnly = true;
+			for(size_t i = 0; i < instr->users.size() && branchOnly; ++i) {
+				branchOnly = instr->users[i]->opcode == IR_BRANCH;
+			}
+			if(branchOnly) {
+				return false;
+			}
+			break;
+		}
+
+		case IR_DIV:
+			if(!instr->operands[1]->isConst() || instr->operands[1]->value == 0) {
+				return false;
+			}
+			break;
+
+		case IR_LOAD:
+			for(size_t i = 0; i < writers_.size(); ++i) {
+				if(function.writesCell(writers_[i], instr->value)) {
+					return false;
+				}
+			}
+			break;
+
+		case IR_BLOAD: {
+			// Элемент в пределах объявленного размера можно прочитать
+			// и до цикла: адрес заведомо допустим
+			const IrInstr* index = instr->operands[0];
+			const IrArray* array = function.findArray(instr->value);
+			if(!index->isConst() || array == 0 || index->value < 0 || index->value >= array->size) {
+				return false;
+			}
+			for(size_t i = 0; i < writers_.size(); ++i) {
+				if(function.writesArray(writers_[i], instr->value)) {
+					return false;
+				}
+			}
+			break;
+		}
+
+		default:
+			return false;
+	}
+
+	for(size_t i = 0; i < instr->operands.size(); ++i) {
+		const IrInstr* operand = instr->operands[i];
+		if(inLoop[operand->block->id] && !invariant_[operand->id]) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,51 @@
+#ifndef CMILAN_LICM_H
+#define CMILAN_LICM_H
+
+#include "passes.h"
+#include "dominators.h"
+#include <vector>
+
+using namespace std;
+
+// Вынос инвариантных вычислений из циклов.
+//
+// Цикл образуют обратные дуги B -> H, где заголовок H доминирует над B.
+// Инструкция инвариантна, если ее операнды определены вне цикла или сами
+// инвариантны. Из цикла выносятся арифметические операции (деление - только
+// на ненулевую константу), чтения ячеек, в которые цикл не пишет (в том числе
+// размеров массивов), и чтения элементов по константному индексу в пределах
+// объявленного размера, если цикл не изменяет массив. Такие инструкции
+// не вызывают ошибок, поэтому их можно выполнить до цикла, даже если тело
+// ни разу не исполнится. Проверки индексов и другие инструкции с побочным
+// эффектом остаются на месте.
+//
+// Инструкции переносятся в конец единственного внешнего предшественника
+// заголовка (до условия цикла WHILE); при нижнем уровне их значения хранятся
+// во временных ячейках компилятора. Внутренние циклы обрабатываются раньше
+// внешних, поэтому вынесенное из вложенного цикла может быть вынесено дальше.
+// Инструкция, равная уже вычисленной в конце предшественника (те же операция
+// и операнды), не переносится, а заменяется ее значением.
+
+class LoopInvariantCodeMotion : public IrPass
+{
+public:
+	const char* getName() const
+	{
+		return "licm";
+	}
+
+	bool run(IrFunction& function);
+
+private:
+	bool hoist(IrFunction& function, const DominatorTree& dominators, IrBlock* header,
+		const vector<char>& inLoop);
+	bool isInvariant(const IrFunction& function, const IrInstr* instr,
+		const vector<char>& inLoop) const;
+	IrInstr* findHoisted(const IrFunction& function, IrBlock* preheader,
+		const IrInstr* instr) const;
+
+	vector<IrInstr*> writers_;		// записи в память внутри цикла
+	vector<char> invariant_;		// инвариантные инструкции цикла
+};
+
+#endif
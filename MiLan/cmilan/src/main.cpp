@@ -1,32 +1,317 @@
-#include "parser.h"
+#include "compiler.h"
+#include "vm.h"
+#include "jit.h"
+#include "csource.h"
+#include "bytecode.h"
+#include "textloader.h"
+#include "mappedfile.h"
+#include "batch.h"
+#include "server.h"
+#include "cache.h"
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 
 void printHelp()
 {
-	cout << "Usage: cmilan input_file" << endl;
+	cout << "Usage: cmilan [--run | --jit | --emit-c | --emit-binary] input_file" << endl;
+	cout << "  --run          execute the program instead of printing it" << endl;
+	cout << "  --jit          execute the program compiled to native code" << endl;
+	cout << "  --emit-c       print the program translated to C" << endl;
+	cout << "  --emit-binary  print the program in binary bytecode format" << endl;
+	cout << "  --lexer ahead  split the whole source into tokens before parsing" << endl;
+	cout << "  --lexer thread split the source into tokens in a separate thread" << endl;
+	cout << "  -O             optimize the generated code" << endl;
+	cout << "  --time-passes  print the time spent in each optimizer pass" << endl;
+	cout << "  --verify-ir    check the intermediate code after each optimizer pass" << endl;
+	cout << "With --run and --jit input_file may be a compiled program in text" << endl;
+	cout << "or binary bytecode format." << endl;
+	cout << endl;
+	cout << "       cmilan --batch [-j threads] [-O] [--emit-binary] [--manifest file] input_file..." << endl;
+	cout << "  compiles every input_file.mil to input_file.o (input_file.mlb with" << endl;
+	cout << "  --emit-binary) in parallel. Each manifest line holds an input file" << endl;
+	cout << "  and an optional output file." << endl;
+	cout << endl;
+	cout << "  --cache dir       reuse compiled programs stored in dir (keyed by" << endl;
+	cout << "                    a hash of the source and compiler version)" << endl;
+	cout << "  --cache-size MB   limit the cache size (default 256 MB)" << endl;
+	cout << endl;
+	cout << "       cmilan --serve socket_path" << endl;
+	cout << "  serves compile and run requests over a Unix domain socket" << endl;
+	cout << "  (see server.h for the protocol)." << endl;
+}
+
+// Печать сообщения об ошибке времени исполнения
+int reportStatus(VmStatus status, int address)
+{
+	if(status != VM_OK) {
+		cout.flush();
+		cerr << "Runtime error at address " << address << ": "
+		     << vmStatusToString(status) << endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Печать времени работы этапов оптимизатора
+void printPassTimes(ostream& out, const vector<PassTime>& times)
+{
+	double total = 0;
+	for(size_t i = 0; i < times.size(); ++i) {
+		total += times[i].seconds;
+	}
+	for(size_t i = 0; i < times.size(); ++i) {
+		out << "pass " << times[i].name << ": " << times[i].seconds * 1000 << " ms" << endl;
+	}
+	out << "total: " << total * 1000 << " ms" << endl;
+}
+
+// Размер памяти данных для программы, которой нужно used слов
+int memorySizeFor(int used)
+{
+	return max((int)VirtualMachine::DEFAULT_MEMORY_SIZE, used);
+}
+
+// Исполнение программы с начальным содержимым памяти data. Если JIT-компилятор
+// недоступен или не может скомпилировать программу, она исполняется интерпретатором.
+int execute(const vector<Command>& code, const vector<DataWord>& data, int memorySize, bool jit)
+{
+	if(jit) {
+		Jit compiled(cin, cout, memorySize);
+		if(compiled.compile(code)) {
+			for(size_t i = 0; i < data.size(); ++i) {
+				compiled.setMemory(data[i].address, data[i].value);
+			}
+			VmStatus status = compiled.run();
+			return reportStatus(status, compiled.getAddress());
+		}
+	}
+
+	VirtualMachine vm(cin, cout, memorySize);
+	vm.load(code);
+	for(size_t i = 0; i < data.size(); ++i) {
+		vm.setMemory(data[i].address, data[i].value);
+	}
+	VmStatus status = vm.run();
+	return reportStatus(status, vm.getAddress());
+}
+
+// Исполнение программы из двоичного файла. Интерпретатор загружает программу
+// прямо из отображенного файла, JIT-компилятору (только для точки входа 0)
+// она передается в виде последовательности команд.
+int execute(const char* fileName, bool jit)
+{
+	BytecodeFile image;
+	if(!image.open(fileName)) {
+		cerr << "Cannot load '" << fileName << "': " << image.getError() << endl;
+		return EXIT_FAILURE;
+	}
+
+	int memorySize = memorySizeFor(image.getMemorySize());
+	if(jit && image.getEntry() == 0) {
+		vector<Command> code;
+		image.getCommands(code);
+		return execute(code, vector<DataWord>(), memorySize, true);
+	}
+
+	VirtualMachine vm(cin, cout, memorySize);
+	vm.load(image);
+	VmStatus status = vm.run();
+	return reportStatus(status, vm.getAddress());
 }
 
 int main(int argc, char** argv)
 {
-	if(argc < 2) {
+	bool run = false;
+	bool jit = false;
+	bool emitC = false;
+	bool emitBinary = false;
+	bool batch = false;
+	int threads = 0;
+	vector<const char*> manifests;
+	vector<const char*> files;
+	const char* socketPath = 0;
+	const char* cacheDirectory = 0;
+	size_t cacheSize = CompileCache::DEFAULT_MAX_BYTES;
+	LexMode lexMode = LEX_ON_DEMAND;
+	bool optimize = false;
+	bool timePasses = false;
+	bool verifyIr = false;
+
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "--run") == 0) {
+			run = true;
+		}
+		else if(strcmp(argv[i], "--jit") == 0) {
+			run = true;
+			jit = true;
+		}
+		else if(strcmp(argv[i], "--emit-c") == 0) {
+			emitC = true;
+		}
+		else if(strcmp(argv[i], "--emit-binary") == 0) {
+			emitBinary = true;
+		}
+		else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+			socketPath = argv[++i];
+		}
+		else if(strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+			cacheDirectory = argv[++i];
+		}
+		else if(strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+			cacheSize = (size_t)atol(argv[++i]) << 20;
+		}
+		else if(strcmp(argv[i], "--lexer") == 0 && i + 1 < argc) {
+			++i;
+			if(strcmp(argv[i], "ahead") == 0) {
+				lexMode = LEX_AHEAD;
+			}
+			else if(strcmp(argv[i], "thread") == 0) {
+				lexMode = LEX_THREAD;
+			}
+			else if(strcmp(argv[i], "demand") == 0) {
+				lexMode = LEX_ON_DEMAND;
+			}
+			else {
+				printHelp();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "-O") == 0) {
+			optimize = true;
+		}
+		else if(strcmp(argv[i], "--time-passes") == 0) {
+			timePasses = true;
+		}
+		else if(strcmp(argv[i], "--verify-ir") == 0) {
+			verifyIr = true;
+		}
+		else if(strcmp(argv[i], "--batch") == 0) {
+			batch = true;
+		}
+		else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+			manifests.push_back(argv[++i]);
+		}
+		else if(argv[i][0] == '-' && argv[i][1] != '\0') {
+			printHelp();
+			return EXIT_FAILURE;
+		}
+		else {
+			files.push_back(argv[i]);
+		}
+	}
+
+	// Кэш используется, только если задан его каталог
+	CompileCache cache(cacheDirectory != 0 ? cacheDirectory : "", cacheSize);
+
+	if(socketPath != 0) {
+		if(batch || run || emitC || emitBinary || !files.empty() || !manifests.empty()) {
+			printHelp();
+			return EXIT_FAILURE;
+		}
+		CompileServer server(socketPath);
+		server.serve(cerr);
+		return EXIT_FAILURE;
+	}
+
+	if(batch) {
+		if(run || emitC || (files.empty() && manifests.empty())) {
+			printHelp();
+			return EXIT_FAILURE;
+		}
+		BatchCompiler compiler(threads, emitBinary);
+		compiler.setOptimize(optimize);
+		for(size_t i = 0; i < manifests.size(); ++i) {
+			if(!compiler.addManifest(manifests[i])) {
+				cerr << "File '" << manifests[i] << "' not found" << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		for(size_t i = 0; i < files.size(); ++i) {
+			compiler.add(files[i]);
+		}
+		if(cacheDirectory != 0) {
+			compiler.setCache(&cache);
+		}
+		return (compiler.run(cerr) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if(files.size() != 1 || !manifests.empty()) {
 		printHelp();
 		return EXIT_FAILURE;
 	}
+	const char* fileName = files[0];
 
-	ifstream input;
-        input.open(argv[1]);
+	if(run && BytecodeFile::isBytecode(fileName)) {
+		return execute(fileName, jit);
+	}
+	if(run && TextLoader::isProgramText(fileName)) {
+		TextLoader loader;
+		if(!loader.load(fileName)) {
+			cerr << "Cannot load '" << fileName << "': ";
+			if(loader.getErrorLine() > 0) {
+				cerr << "line " << loader.getErrorLine() << ": ";
+			}
+			cerr << loader.getError() << endl;
+			return EXIT_FAILURE;
+		}
+		return execute(loader.getCode(), loader.getData(), memorySizeFor(loader.getMemoryUsed()), jit);
+	}
 
-	if(input) {
-		Parser p(argv[1], input);
-		p.parse();
+	MappedFile source;
+	if(!source.open(fileName)) {
+		cerr << "File '" << fileName << "' not found" << endl;
+		return EXIT_FAILURE;
+	}
+
+	Compiler compiler;
+	compiler.setLexMode(lexMode);
+	compiler.setOptimize(optimize);
+	compiler.setVerify(verifyIr);
+	CompileResult result;
+	bool ok = true;
+	string key;
+	if(cacheDirectory != 0) {
+		key = CompileCache::makeKey(source.getData(), source.getData() + source.getSize(),
+			compiler.getOptions());
+	}
+	if(cacheDirectory == 0 || !cache.lookup(key, result)) {
+		ok = compiler.compile(source.getData(), source.getData() + source.getSize(), result, fileName);
+		if(cacheDirectory != 0) {
+			cache.store(key, result);
+		}
+	}
+	source.close();
+	printDiagnostics(cerr, result.diagnostics);
+	if(timePasses && !result.passTimes.empty()) {
+		printPassTimes(cerr, result.passTimes);
+	}
+
+	if(!run && !emitBinary && !emitC) {
+		// Печать программы в текстовом формате
+		for(size_t address = 0; address < result.code.size(); ++address) {
+			result.code[address].print(address, cout);
+		}
+		cout.flush();
 		return EXIT_SUCCESS;
 	}
-	else {
-		cerr << "File '" << argv[1] << "' not found" << endl;
+	if(!ok) {
 		return EXIT_FAILURE;
 	}
+	if(emitBinary) {
+		BytecodeFile::write(cout, result.code, result.memorySize);
+		return EXIT_SUCCESS;
+	}
+	if(emitC) {
+		CSourceGen generator(cout, memorySizeFor(result.memorySize));
+		generator.generate(result.code);
+		return EXIT_SUCCESS;
+	}
+	return execute(result.code, vector<DataWord>(), memorySizeFor(result.memorySize), jit);
 }
-
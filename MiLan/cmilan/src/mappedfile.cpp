@@ -0,0 +1,78 @@
+#include "mappedfile.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CMILAN_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+void MappedFile::close()
+{
+	if(data_ != 0) {
+#ifdef CMILAN_MMAP
+		if(mapped_) {
+			munmap(data_, size_);
+		}
+		else
+#endif
+		{
+			delete[] data_;
+		}
+	}
+	data_ = 0;
+	size_ = 0;
+	mapped_ = false;
+}
+
+bool MappedFile::open(const char* fileName)
+{
+	close();
+
+#ifdef CMILAN_MMAP
+	int fd = ::open(fileName, O_RDONLY);
+	if(fd < 0) {
+		error_ = "cannot open file";
+		return false;
+	}
+	struct stat info;
+	if(fstat(fd, &info) != 0) {
+		::close(fd);
+		error_ = "cannot read file";
+		return false;
+	}
+	size_ = info.st_size;
+	if(size_ > 0 && size_ % sysconf(_SC_PAGESIZE) != 0) {
+		void* data = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data != MAP_FAILED) {
+			data_ = (char*)data;
+			mapped_ = true;
+		}
+	}
+	::close(fd);
+	if(mapped_) {
+		return true;
+	}
+#endif
+
+	// Чтение файла целиком
+	ifstream input(fileName, ios::binary);
+	if(!input) {
+		error_ = "cannot open file";
+		return false;
+	}
+	input.seekg(0, ios::end);
+	size_t size = input.tellg();
+	input.seekg(0, ios::beg);
+	data_ = new char[size + 1];
+	size_ = size;
+	if(!input.read(data_, size)) {
+		close();
+		error_ = "cannot read file";
+		return false;
+	}
+	data_[size] = '\0';
+	return true;
+}
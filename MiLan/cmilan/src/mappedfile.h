@@ -0,0 +1,61 @@
+#ifndef CMILAN_MAPPEDFILE_H
+#define CMILAN_MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// Файл, отображенный в память только для чтения.
+//
+// На платформах без mmap (или если отобразить файл не удалось) содержимое
+// файла читается в буфер целиком. Данные действительны, пока файл открыт.
+//
+// За последним байтом файла всегда находится нулевой байт (см. Scanner):
+// при отображении это остаток последней страницы, который система заполняет
+// нулями, а если размер файла кратен размеру страницы, файл читается в буфер.
+
+class MappedFile
+{
+public:
+	MappedFile()
+		: data_(0), size_(0), mapped_(false)
+	{
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	// Открытие файла. При ошибке возвращает false, описание ошибки возвращает getError().
+	bool open(const char* fileName);
+
+	void close();
+
+	const char* getData() const
+	{
+		return data_;
+	}
+
+	size_t getSize() const
+	{
+		return size_;
+	}
+
+	const string& getError() const
+	{
+		return error_;
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	char* data_;		// содержимое файла
+	size_t size_;		// размер файла
+	bool mapped_;		// отображен ли файл в память (иначе data_ выделен new[])
+	string error_;		// описание последней ошибки
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "nametable.h"
+
+static const size_t INITIAL_SLOTS = 64;	// начальный размер хеш-таблицы (степень двойки)
+
+NameTable::NameTable()
+	: slots_(INITIAL_SLOTS, -1)
+{
+	for(int i = 0; i < MAX_SEGMENTS; ++i) {
+		segments_[i] = 0;
+	}
+}
+
+NameTable::~NameTable()
+{
+	for(int i = 0; i < MAX_SEGMENTS; ++i) {
+		delete[] segments_[i];
+	}
+}
+
+unsigned NameTable::hashName(const char* name, size_t length)
+{
+	unsigned hash = HASH_BASIS;
+	for(size_t i = 0; i < length; ++i) {
+		hash = hashChar(hash, name[i]);
+	}
+	return hash;
+}
+
+// Совпадает ли имя из таблицы (в нижнем регистре) с именем из текста.
+// Имена состоят из букв и цифр, поэтому c | 0x20 переводит букву в нижний
+// регистр и не меняет цифру.
+static bool sameName(const string& stored, const char* name, size_t length)
+{
+	if(stored.size() != length) {
+		return false;
+	}
+	for(size_t i = 0; i < length; ++i) {
+		if(stored[i] != (char)(name[i] | 0x20)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int NameTable::intern(const char* name, size_t length, unsigned hash)
+{
+	size_t mask = slots_.size() - 1;
+	size_t slot = hash & mask;
+	while(slots_[slot] >= 0) {
+		int id = slots_[slot];
+		if(hashes_[id] == hash && sameName(getName(id), name, length)) {
+			return id;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	int id = hashes_.size();
+	unsigned index = id + FIRST_SEGMENT;
+	int segment = highestBit(index) - FIRST_SEGMENT_BITS;
+	if(segments_[segment] == 0) {
+		segments_[segment] = new string[FIRST_SEGMENT << segment];
+	}
+	string& stored = segments_[segment][index - (FIRST_SEGMENT << segment)];
+	stored.assign(name, length);
+	for(size_t i = 0; i < length; ++i) {
+		stored[i] |= 0x20;
+	}
+	hashes_.push_back(hash);
+	slots_[slot] = id;
+
+	// Таблица заполняется не более чем наполовину
+	if(hashes_.size() * 2 > slots_.size()) {
+		grow();
+	}
+	return id;
+}
+
+void NameTable::grow()
+{
+	slots_.assign(slots_.size() * 2, -1);
+	size_t mask = slots_.size() - 1;
+	for(size_t id = 0; id < hashes_.size(); ++id) {
+		size_t slot = hashes_[id] & mask;
+		while(slots_[slot] >= 0) {
+			slot = (slot + 1) & mask;
+		}
+		slots_[slot] = id;
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef CMILAN_NAMETABLE_H
+#define CMILAN_NAMETABLE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// Таблица имен (интернирование идентификаторов).
+//
+// Каждому различному имени присваивается номер - 0, 1, 2, ... в порядке
+// первого появления. Имена в Милане не зависят от регистра букв, поэтому
+// хранятся в нижнем регистре, а "Abc" и "abc" получают один номер.
+//
+// Номера ищутся в хеш-таблице с открытой адресацией; хеш имени сканер
+// вычисляет тем же проходом, которым выделяет идентификатор (см. hashChar).
+// Таблица не синхронизирована: у каждой компиляции она своя.
+//
+// Имена хранятся в сегментах, которые не перемещаются при добавлении новых
+// имен (сегмент k вмещает FIRST_SEGMENT << k имен). Поэтому, когда сканер
+// работает в отдельном потоке (см. TokenRing), парсер может читать имена,
+// номера которых уже получил, одновременно с добавлением новых имен.
+
+class NameTable
+{
+public:
+	static const unsigned HASH_BASIS = 2166136261u;	// начальное значение хеша (FNV-1a)
+
+	NameTable();
+	~NameTable();
+
+	// Добавление к хешу hash очередного символа имени (буквы или цифры)
+	static unsigned hashChar(unsigned hash, char c)
+	{
+		return (hash ^ (unsigned char)(c | 0x20)) * 16777619u;
+	}
+
+	// Хеш имени [name, name + length)
+	static unsigned hashName(const char* name, size_t length);
+
+	// Номер имени [name, name + length) с хешем hash. Если имя встретилось
+	// впервые, оно добавляется в таблицу.
+	int intern(const char* name, size_t length, unsigned hash);
+
+	int intern(const char* name, size_t length)
+	{
+		return intern(name, length, hashName(name, length));
+	}
+
+	// Имя с номером id (в нижнем регистре)
+	const string& getName(int id) const
+	{
+		unsigned index = id + FIRST_SEGMENT;
+		int segment = highestBit(index) - FIRST_SEGMENT_BITS;
+		return segments_[segment][index - (FIRST_SEGMENT << segment)];
+	}
+
+	// Число различных имен (только для потока, который добавляет имена)
+	int getCount() const
+	{
+		return hashes_.size();
+	}
+
+private:
+	NameTable(const NameTable&);
+	NameTable& operator=(const NameTable&);
+
+	static const int FIRST_SEGMENT_BITS = 6;
+	static const unsigned FIRST_SEGMENT = 1u << FIRST_SEGMENT_BITS;	// размер первого сегмента
+	static const int MAX_SEGMENTS = 32 - FIRST_SEGMENT_BITS;
+
+	// Номер старшего единичного бита x (x > 0)
+	static int highestBit(unsigned x)
+	{
+#ifdef __GNUC__
+		return 31 - __builtin_clz(x);
+#else
+		int bit = 0;
+		while(x >>= 1) {
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	void grow(); // увеличение хеш-таблицы вдвое
+
+	vector<int> slots_;		// хеш-таблица: номер имени или -1
+	vector<unsigned> hashes_;	// хеши имен по номерам
+	string* segments_[MAX_SEGMENTS];	// сегменты с именами (0, если не выделен)
+};
+
+#endif
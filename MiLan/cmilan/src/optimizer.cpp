@@ -0,0 +1,70 @@
+#include "optimizer.h"
+#include "ir.h"
+#include "irbuilder.h"
+#include "irlower.h"
+#include "peephole.h"
+#include "constprop.h"
+#include "gvn.h"
+#include "boundscheck.h"
+#include "dce.h"
+#include "licm.h"
+#include "layout.h"
+#include "vm.h"
+#include <chrono>
+#include <algorithm>
+
+Optimizer::Optimizer()
+{
+	passes_.add(new ConstantPropagation());
+	passes_.add(new GlobalValueNumbering());
+	passes_.add(new BoundsCheckElimination());
+	passes_.add(new DeadCodeElimination());
+	passes_.add(new LoopInvariantCodeMotion());
+	// Выражения, вынесенные из соседних циклов, вычисляются один раз
+	passes_.add(new GlobalValueNumbering());
+	passes_.add(new DeadCodeElimination());
+	passes_.add(new BlockLayout());
+}
+
+// Время, прошедшее с момента start
+static PassTime elapsed(const char* name, chrono::steady_clock::time_point start)
+{
+	PassTime time;
+	time.name = name;
+	time.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return time;
+}
+
+int Optimizer::generate(const AstNode* program, int memoryUsed, CodeGen* codegen)
+{
+	IrFunction function(memoryUsed);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	IrBuilder builder(&function);
+	builder.build(program);
+	times_.push_back(elapsed("build", start));
+
+	if(!passes_.run(function, times_, error_)) {
+		return -1;
+	}
+
+	start = chrono::steady_clock::now();
+	IrLowering lowering(&function, codegen);
+	lowering.lower();
+	times_.push_back(elapsed("lower", start));
+
+	start = chrono::steady_clock::now();
+	vector<Command> code;
+	codegen->swapCommands(code);
+	Peephole peephole(code);
+	peephole.run();
+	codegen->swapCommands(code);
+	times_.push_back(elapsed("peephole", start));
+
+	// Временные ячейки размещаются перед переменными программы, поэтому
+	// память увеличивается на их число (не меньше, чем было бы без них)
+	int temps = lowering.getTempCount();
+	if(temps == 0) {
+		return memoryUsed;
+	}
+	return max((int)VirtualMachine::DEFAULT_MEMORY_SIZE, memoryUsed) + temps;
+}
@@ -0,0 +1,62 @@
+#ifndef CMILAN_OPTIMIZER_H
+#define CMILAN_OPTIMIZER_H
+
+#include "ast.h"
+#include "codegen.h"
+#include "passes.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Версия оптимизатора. Изменяется при любом изменении кода, который
+// формируется с оптимизацией (входит в ключ кэша, см. Compiler::getOptions).
+static const char* const OPTIMIZER_VERSION = "opt-8";
+
+// Оптимизирующая генерация кода (cmilan -O).
+//
+// Синтаксическое дерево переводится в промежуточное представление
+// (IrBuilder), над ним выполняются проходы оптимизатора (PassManager), и
+// результат переводится в команды виртуальной машины (IrLowering), которые
+// затем улучшаются оптимизатором по окну (Peephole).
+
+class Optimizer
+{
+public:
+	// Конструктор создает стандартную последовательность проходов
+	Optimizer();
+
+	// Проверка представления после каждого прохода
+	void setVerify(bool verify)
+	{
+		passes_.setVerify(verify);
+	}
+
+	// Формирование кода программы program в codegen.
+	//     int memoryUsed - число слов памяти, занятых переменными и массивами
+	// Возвращает число слов памяти, которое нужно программе, или -1, если
+	// проверка представления нашла ошибку (см. getError).
+	int generate(const AstNode* program, int memoryUsed, CodeGen* codegen);
+
+	// Время работы построения представления, проходов и генерации кода
+	const vector<PassTime>& getTimes() const
+	{
+		return times_;
+	}
+
+	// Описание ошибки, найденной проверкой представления
+	const string& getError() const
+	{
+		return error_;
+	}
+
+private:
+	Optimizer(const Optimizer&);
+	Optimizer& operator=(const Optimizer&);
+
+	PassManager passes_;		// проходы оптимизатора
+	vector<PassTime> times_;	// время работы этапов
+	string error_;			// ошибка проверки представления
+};
+
+#endif
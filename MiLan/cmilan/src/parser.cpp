@@ -3,302 +3,283 @@
 
 //Выполняем синтаксический разбор блока program. Если во время разбора не обнаруживаем 
 //никаких ошибок, то выводим последовательность команд стек-машины
-void Parser::parse()
+void Parser::parse(ostream& output, ostream& errors)
 {
-	program(); 
-	if(!error_) {
-		codegen_->flush();
+	if(compile()) {
+		codegen_->flush(output);
+	}
+	else {
+		printDiagnostics(errors, diagnostics_);
 	}
 }
 
-void Parser::program()
+void printDiagnostics(ostream& errors, const vector<Diagnostic>& diagnostics)
+{
+	for(size_t i = 0; i < diagnostics.size(); ++i) {
+		errors << "Line " << diagnostics[i].line << ": " << diagnostics[i].message << endl;
+	}
+}
+
+bool Parser::compile()
+{
+	if(lexMode_ == LEX_AHEAD) {
+		tokens_ = new TokenArray();
+		tokens_->lex(*scanner_);
+	}
+	else if(lexMode_ == LEX_THREAD) {
+		ring_ = new TokenRing();
+		lexer_ = new thread(&TokenRing::produce, ring_, ref(*scanner_));
+	}
+	next();
+	AstNode* tree = program();
+	stopLexer();
+	if(!error_ && optimizer_ != 0) {
+		memorySize_ = optimizer_->generate(tree, lastVar_, codegen_);
+		if(memorySize_ < 0) {
+			reportError("internal error: " + optimizer_->getError());
+		}
+	}
+	else if(!error_) {
+		AstCodeGen generator(codegen_);
+		generator.generate(tree);
+	}
+	return !error_;
+}
+
+void Parser::stopLexer()
+{
+	if(lexer_ != 0) {
+		ring_->stop();
+		lexer_->join();
+		delete lexer_;
+		lexer_ = 0;
+	}
+	delete ring_;
+	ring_ = 0;
+}
+
+AstNode* Parser::program()
 {
 	mustBe(T_BEGIN);
-	statementList();
+	AstNode* list = statementList();
 	mustBe(T_END);
-	codegen_->emit(STOP);
+	return list;
 }
 
-void Parser::statementList()
+AstNode* Parser::statementList()
 {
 	//	  Если список операторов пуст, очередной лексемой будет одна из возможных "закрывающих скобок": END, OD, ELSE, FI.
 	//	  В этом случае результатом разбора будет пустой блок (его список операторов равен null).
 	//	  Если очередная лексема не входит в этот список, то ее мы считаем началом оператора и вызываем метод statement. 
 	//    Признаком последнего оператора является отсутствие после оператора точки с запятой.
+	AstNode* first = 0;
+	AstNode* last = 0;
 	if(see(T_END) || see(T_OD) || see(T_ELSE) || see(T_FI)) {
-		return;
+		return first;
 	}
 	else {
 		bool more = true;
 		while(more) {
-			statement();
+			AstNode* node = statement();
+			if(node != 0) {
+				if(last == 0) {
+					first = node;
+				}
+				else {
+					last->next = node;
+				}
+				last = node;
+			}
 			more = match(T_SEMICOLON);
 		}
 	}
+	return first;
 }
 
-void Parser::statement()
+AstNode* Parser::statement()
 {
+	int line = line_;
 	// Если встречаем переменную, то запоминаем ее адрес или добавляем новую если не встретили. 
-	// Следующей лексемой должно быть присваивание. Затем идет блок expression, который возвращает значение на вершину стека.
-	// Записываем это значение по адресу нашей переменной
+	// Следующей лексемой должно быть присваивание. Затем идет блок expression, который вычисляет
+	// присваиваемое значение.
 	if(see(T_IDENTIFIER)) {
-		string ident = scanner_->getStringValue();
+		int ident = symbolValue();
 		next();
 		if (match(T_LQPAREN)) {
 			int address = findArray(ident);
 			if (address == -1) {
 				std::ostringstream msg;
-				msg << "no such array: " << ident << ".";
+				msg << "no such array: " << scanner_->getName(ident) << ".";
 				reportError(msg.str());
 				recover(T_ASSIGN);
 				expression();
+				return 0;
 			}
-			else {
-				expression();
-				mustBe(T_RQPAREN);
-				codegen_->emit(DUP); //дублируем значение индекса для сравнения с 0
-				codegen_->emit(DUP); //дублируем значение индекса для сравнения с размером массива
-				int sizeAddress = findSize(ident);
-				codegen_->emit(LOAD, sizeAddress);
-				codegen_->emit(COMPARE, 2);
-				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-				codegen_->emit(JUMP, -1);
-				codegen_->emit(PUSH, 0);
-				codegen_->emit(COMPARE, 5);
-				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-				codegen_->emit(JUMP, -1);
-				codegen_->emit(STORE, reserveAddress_);
-				mustBe(T_ASSIGN);
-				expression();
-				codegen_->emit(LOAD, reserveAddress_);
-				codegen_->emit(BSTORE, address);
-			}
+			AstNode* node = arena_.make(AST_ELEMENT_ASSIGN, line);
+			node->address = address;
+			node->sizeAddress = findSize(ident);
+			node->left = expression();
+			mustBe(T_RQPAREN);
+			mustBe(T_ASSIGN);
+			node->right = expression();
+			return node;
 		}
-		else {
-			int addr = findArray(ident);
-			//необходимо определить имеем дело с переменной или с массивом
-			if (addr == -1) {
-				int varAddress = findOrAddVariable(ident);
-				mustBe(T_ASSIGN);
-				expression();
-				codegen_->emit(STORE, varAddress);
+
+		int addr = findArray(ident);
+		//необходимо определить имеем дело с переменной или с массивом
+		if (addr == -1) {
+			AstNode* node = arena_.make(AST_ASSIGN, line);
+			node->address = findOrAddVariable(ident);
+			mustBe(T_ASSIGN);
+			node->left = expression();
+			return node;
+		}
+
+		mustBe(T_ASSIGN);
+		if (match(T_LQPAREN)) {
+			AstNode* node = arena_.make(AST_SET_ASSIGN, line);
+			node->address = addr;
+			node->sizeAddress = findSize(ident);
+			node->value = A_PLUS;
+			node->left = setOperand("the first argument must be array.");
+			next();
+			if (see(T_ARROP)) {
+				node->value = arithmeticValue();
 			}
 			else {
-				mustBe(T_ASSIGN);
-				if (match(T_LQPAREN)) {
-					codegen_->emit(PUSH, 0);
-					codegen_->emit(STORE, reserveAddress_); //хранит индекс первого массива
-					codegen_->emit(PUSH, 0);
-					codegen_->emit(STORE, reserveAddress_ + 1); //хранит вспомагательный индекс
-					codegen_->emit(PUSH, 0);
-					codegen_->emit(STORE, reserveAddress_ + 2); //хранит размер полученного массива
-					int addr1, addr2;
-					int size1, size2;
-					if (see(T_IDENTIFIER)) {
-						addr1 = findArray(scanner_->getStringValue());
-						if (addr1 == -1) {
-							reportError("the first argument must be array.");
-						}
-						else {
-							size1 = findSize(scanner_->getStringValue());
-						}
-					}
-					else {
-						std::ostringstream msg;
-						msg << "array identifier expected but found " << tokenToString(scanner_->token()) << '.';
-						reportError(msg.str());
-					}
-					next();
-					Arithmetic op;
-					if (see(T_ARROP)) {
-						op = scanner_->getArithmeticValue();
-					}
-					else {
-						std::ostringstream msg;
-						msg << tokenToString(T_ARROP) << " expected but found " << tokenToString(scanner_->token()) << '.';
-						reportError(msg.str());
-					}
-					next();
-					if (see(T_IDENTIFIER)) {
-						addr2 = findArray(scanner_->getStringValue());
-						if (addr2 == -1) {
-							reportError("the second argument must be array.");
-						}
-						else {
-							size2 = findSize(scanner_->getStringValue());
-						}
-					}
-					else {
-						std::ostringstream msg;
-						msg << "array identifier expected but found " << tokenToString(scanner_->token()) << '.';
-						reportError(msg.str());
-					}
-					next();
-					mustBe(T_RQPAREN);
-					if (op == A_PLUS) {
-						orCode(addr1, size1);
-						codegen_->emit(PUSH, 0);
-						codegen_->emit(STORE, reserveAddress_);
-						orCode(addr2, size2);
-					}
-					else {
-						andCode(addr1, size1, addr2, size2);
-					}
-					copyToDest(addr, findSize(ident));
-					clear();
-				}
-				else {
-					codegen_->emit(PUSH, 0);
-					codegen_->emit(STORE, reserveAddress_);
-					codegen_->emit(LOAD, findSize(ident));
-					codegen_->emit(STORE, reserveAddress_ + 1);
-					int comandAddr = codegen_->getCurrentAddress();
-					arrExpression();
-					codegen_->emit(LOAD, reserveAddress_);
-					codegen_->emit(PUSH, 1);
-					codegen_->emit(ADD);
-					codegen_->emit(DUP);
-					codegen_->emit(STORE, reserveAddress_);
-					codegen_->emit(LOAD, reserveAddress_ + 1);
-					codegen_->emit(COMPARE, 2);
-					codegen_->emit(JUMP_YES, comandAddr);
-					codegen_->emit(LOAD, reserveAddress_);
-					codegen_->emit(PUSH, 1);
-					codegen_->emit(SUB);
-					codegen_->emit(STORE, reserveAddress_);
-					comandAddr = codegen_->getCurrentAddress();
-					codegen_->emit(LOAD, reserveAddress_);
-					codegen_->emit(BSTORE, addr);
-					codegen_->emit(LOAD, reserveAddress_);
-					codegen_->emit(PUSH, 1);
-					codegen_->emit(SUB);
-					codegen_->emit(DUP);
-					codegen_->emit(STORE, reserveAddress_);
-					codegen_->emit(PUSH, 0);
-					codegen_->emit(COMPARE, 5);
-					codegen_->emit(JUMP_YES, comandAddr);
-				}
+				std::ostringstream msg;
+				msg << tokenToString(T_ARROP) << " expected but found " << tokenToString(token_) << '.';
+				reportError(msg.str());
 			}
+			next();
+			node->right = setOperand("the second argument must be array.");
+			next();
+			mustBe(T_RQPAREN);
+			node->tempAddress = lastVar_;
+			return node;
 		}
+
+		AstNode* node = arena_.make(AST_ARRAY_ASSIGN, line);
+		node->address = addr;
+		node->sizeAddress = findSize(ident);
+		node->left = arrExpression();
+		return node;
 	}
-	// Если встретили IF, то затем должно следовать условие. На вершине стека лежит 1 или 0 в зависимости от выполнения условия.
-	// Затем зарезервируем место для условного перехода JUMP_NO к блоку ELSE (переход в случае ложного условия). Адрес перехода
-	// станет известным только после того, как будет сгенерирован код для блока THEN.
+	// Если встретили IF, то затем должно следовать условие, блок THEN и, возможно, блок ELSE.
 	else if(match(T_IF)) {
-		relation();
-		
-		int jumpNoAddress = codegen_->reserve();
-
+		AstNode* node = arena_.make(AST_IF, line);
+		node->left = relation();
 		mustBe(T_THEN);
-		statementList();
+		node->right = statementList();
 		if(match(T_ELSE)) {
-		//Если есть блок ELSE, то чтобы не выполнять его в случае выполнения THEN, 
-		//зарезервируем место для команды JUMP в конец этого блока
-			int jumpAddress = codegen_->reserve();
-		//Заполним зарезервированное место после проверки условия инструкцией перехода в начало блока ELSE.
-			codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
-			statementList();
-		//Заполним второй адрес инструкцией перехода в конец условного блока ELSE.
-			codegen_->emitAt(jumpAddress, JUMP, codegen_->getCurrentAddress());
-		}
-		else {
-		//Если блок ELSE отсутствует, то в зарезервированный адрес после проверки условия будет записана
-		//инструкция условного перехода в конец оператора IF...THEN
-			codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+			node->value = 1;
+			node->third = statementList();
 		}
-
 		mustBe(T_FI);
+		return node;
 	}
-
 	else if(match(T_WHILE)) {
-		//запоминаем адрес начала проверки условия.
-		int conditionAddress = codegen_->getCurrentAddress();
-		relation();
-		//резервируем место под инструкцию условного перехода для выхода из цикла.
-		int jumpNoAddress = codegen_->reserve();
+		AstNode* node = arena_.make(AST_WHILE, line);
+		node->left = relation();
 		mustBe(T_DO);
-		statementList();
+		node->right = statementList();
 		mustBe(T_OD);
-		//переходим по адресу проверки условия
-		codegen_->emit(JUMP, conditionAddress);
-		//заполняем зарезервированный адрес инструкцией условного перехода на следующий за циклом оператор.
-		codegen_->emitAt(jumpNoAddress, JUMP_NO, codegen_->getCurrentAddress());
+		return node;
 	}
 	else if(match(T_WRITE)) {
+		AstNode* node = arena_.make(AST_WRITE, line);
 		mustBe(T_LPAREN);
-		expression();
+		node->left = expression();
 		mustBe(T_RPAREN);
-		codegen_->emit(PRINT);
+		return node;
 	}
 	else if (match(T_ARRAY)) {
-		string ident = ""; //имя массива
+		int ident = -1; //номер имени массива
 		int size = 0; //размер массива
 		if (!see(T_IDENTIFIER)) { //после ключевого слова array должен следовать идентификатор - имя массива
 			reportError("identifier expected.");
 		}
 		else {
-			ident = scanner_->getStringValue();
+			ident = symbolValue();
 			if (findVariable(ident) != -1) {
 				reportError("variable with such name already exists.");
 			}
 		}
 		next();
 		mustBe(T_LQPAREN);
-		if (!see(T_NUMBER) || scanner_->getIntValue() <= 0) { //размер массива в [], должен быть больше 0
+		if (!see(T_NUMBER) || intValue() <= 0) { //размер массива в [], должен быть больше 0
 			reportError("positive number expected.");
 			size = 1;
 		}
 		else {
-			size = scanner_->getIntValue();
+			size = intValue();
 		}
 		next();
 		mustBe(T_RQPAREN);
-		if (!ident.empty() && size != 0) {
+		if (ident != -1 && size != 0) {
 			int arrAddress = addArray(ident, size);
 			if (arrAddress < 0) {
 				reportError("redefining an existing array.");
 			}
 			else {
-				int addr = findSize(ident);
-				codegen_->emit(PUSH, size);
-				codegen_->emit(STORE, addr);
+				AstNode* node = arena_.make(AST_DECLARE, line);
+				node->address = arrAddress;
+				node->sizeAddress = findSize(ident);
+				node->value = size;
+				return node;
 			}
 		}
+		return 0;
 	}
 	else if (match(T_DELETE)) {
 		match(T_LPAREN);
 		if (see(T_IDENTIFIER)) {
-			string ident = scanner_->getStringValue();
+			int ident = symbolValue();
 			int address = findArray(ident);
 			if (address == -1) {
 				std::ostringstream msg;
-				msg << "Unknown array " << ident << '.';
+				msg << "Unknown array " << scanner_->getName(ident) << '.';
 				reportError(msg.str());
 			}
 			next();
 			match(T_RPAREN);
-			int sizeAddress = findSize(ident);
-			codegen_->emit(LOAD, sizeAddress);
-			codegen_->emit(DUP);
-			codegen_->emit(PUSH, 0);
-			codegen_->emit(COMPARE, 3);
-			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-			codegen_->emit(JUMP, -1);
-			codegen_->emit(PUSH, 1);
-			codegen_->emit(SUB);
-			codegen_->emit(STORE, sizeAddress);
-			codegen_->emit(PUSH, 0);
-			codegen_->emit(LOAD, sizeAddress);
-			codegen_->emit(BSTORE, address);
+			AstNode* node = arena_.make(AST_DELETE, line);
+			node->address = address;
+			node->sizeAddress = findSize(ident);
+			return node;
 		}
+		return 0;
 	}
 	else {
 		reportError("statement expected.");
+		return 0;
 	}
 }
 
-void Parser::expression()
+// Операнд объединения или пересечения массивов. Текущая лексема не изымается.
+AstNode* Parser::setOperand(const char* notArray)
+{
+	AstNode* node = 0;
+	if (see(T_IDENTIFIER)) {
+		int address = findArray(symbolValue());
+		if (address == -1) {
+			reportError(notArray);
+		}
+		else {
+			node = arena_.make(AST_ARRAY, line_);
+			node->address = address;
+			node->sizeAddress = findSize(symbolValue());
+		}
+	}
+	else {
+		std::ostringstream msg;
+		msg << "array identifier expected but found " << tokenToString(token_) << '.';
+		reportError(msg.str());
+	}
+	return node;
+}
+
+AstNode* Parser::expression()
 {
 
 	 /*
@@ -308,22 +289,19 @@ void Parser::expression()
 		 терма, пока не встретим за термом символ, отличный от '+' и '-'
      */
 
-	term();
+	AstNode* left = term();
 	while(see(T_ADDOP)) {
-		Arithmetic op = scanner_->getArithmeticValue();
+		AstNode* node = arena_.make(AST_BINARY, line_);
+		node->value = arithmeticValue();
 		next();
-		term();
-
-		if(op == A_PLUS) {
-			codegen_->emit(ADD);
-		}
-		else {
-			codegen_->emit(SUB);
-		}
+		node->left = left;
+		node->right = term();
+		left = node;
 	}
+	return left;
 }
 
-void Parser::term()
+AstNode* Parser::term()
 {
 	 /*  
 		 Терм описывается следующими правилами: <term> -> <factor> | <factor> * <factor> | <factor> / <factor>
@@ -331,257 +309,184 @@ void Parser::term()
 		 удаляем его из потока и разбираем очередное слагаемое (вычитаемое). Повторяем проверку и разбор очередного 
 		 множителя, пока не встретим за ним символ, отличный от '*' и '/' 
 	*/
-	factor();
+	AstNode* left = factor();
 	while(see(T_MULOP)) {
-		Arithmetic op = scanner_->getArithmeticValue();
+		AstNode* node = arena_.make(AST_BINARY, line_);
+		node->value = arithmeticValue();
 		next();
-		factor();
-
-		if(op == A_MULTIPLY) {
-			codegen_->emit(MULT);
-		}
-		else {
-			codegen_->emit(DIV);
-		}
+		node->left = left;
+		node->right = factor();
+		left = node;
 	}
+	return left;
 }
 
-void Parser::factor()
+AstNode* Parser::factor()
 {
 	/*
 		Множитель описывается следующими правилами:
-		<factor> -> number | identifier | -<factor> | (<expression>) | READ
+		<factor> -> number | identifier | identifier[expression] | -<factor> | (<expression>) | READ
 	*/
+	int line = line_;
 	if(see(T_NUMBER)) {
-		int value = scanner_->getIntValue();
+		AstNode* node = arena_.make(AST_NUMBER, line);
+		node->value = intValue();
 		next();
-		codegen_->emit(PUSH, value);
-		//Если встретили число, то преобразуем его в целое и записываем на вершину стека
+		return node;
 	}
 	else if(see(T_IDENTIFIER)) {
-		string ident = scanner_->getStringValue();
+		int ident = symbolValue();
 		next();
 		if (match(T_LQPAREN)) {
 			int address = findArray(ident);
 			if (address == -1) {
 				std::ostringstream msg;
-				msg << "no such array: " << ident << ".";
+				msg << "no such array: " << scanner_->getName(ident) << ".";
 				reportError(msg.str());
+				return 0;
 			}
-			else {
-				expression();
-				mustBe(T_RQPAREN);
-				codegen_->emit(DUP);
-				codegen_->emit(DUP);
-				int sizeAddress = findSize(ident);
-				codegen_->emit(LOAD, sizeAddress);
-				codegen_->emit(COMPARE, 2);
-				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-				codegen_->emit(JUMP, -1);
-				codegen_->emit(PUSH, 0);
-				codegen_->emit(COMPARE, 5);
-				codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-				codegen_->emit(JUMP, -1);
-				codegen_->emit(BLOAD, address);
-			}
+			AstNode* node = arena_.make(AST_ELEMENT, line);
+			node->address = address;
+			node->sizeAddress = findSize(ident);
+			node->left = expression();
+			mustBe(T_RQPAREN);
+			return node;
 		}
 		else {
 			int isArr = findArray(ident);
 			if (isArr != -1) {
 				std::ostringstream msg;
-				msg << "inappropriate use of array: " << ident << ".";
+				msg << "inappropriate use of array: " << scanner_->getName(ident) << ".";
 				reportError(msg.str());
 			}
-			int varAddress = findOrAddVariable(ident);
-			codegen_->emit(LOAD, varAddress);
-			//Если встретили переменную, то выгружаем значение, лежащее по ее адресу, на вершину стека 
+			AstNode* node = arena_.make(AST_VARIABLE, line);
+			node->address = findOrAddVariable(ident);
+			return node;
 		}
 	}
-	else if(see(T_ADDOP) && scanner_->getArithmeticValue() == A_MINUS) {
+	else if(see(T_ADDOP) && arithmeticValue() == A_MINUS) {
 		next();
-		factor();
-		codegen_->emit(INVERT);
-		//Если встретили знак "-", и за ним <factor> то инвертируем значение, лежащее на вершине стека
+		AstNode* node = arena_.make(AST_NEGATE, line);
+		node->left = factor();
+		return node;
 	}
 	else if(match(T_LPAREN)) {
-		expression();
+		AstNode* node = expression();
 		mustBe(T_RPAREN);
-		//Если встретили открывающую скобку, тогда следом может идти любое арифметическое выражение и обязательно
-		//закрывающая скобка.
+		return node;
 	}
 	else if(match(T_READ)) {
-		codegen_->emit(INPUT);
-		//Если встретили зарезервированное слово READ, то записываем на вершину стека идет запись со стандартного ввода
+		return arena_.make(AST_READ, line);
 	}
 	else {
 		reportError("expression expected.");
+		return 0;
 	}
 }
 
-void Parser::relation()
+AstNode* Parser::relation()
 {
-	//Условие сравнивает два выражения по какому-либо из знаков. Каждый знак имеет свой номер. В зависимости от 
-	//результата сравнения на вершине стека окажется 0 или 1.
-	expression();
+	//Условие сравнивает два выражения по какому-либо из знаков.
+	AstNode* left = expression();
 	if(see(T_CMP)) {
-		Cmp cmp = scanner_->getCmpValue();
+		AstNode* node = arena_.make(AST_COMPARE, line_);
+		node->value = cmpValue();
 		next();
-		expression();
-		switch(cmp) {
-			//для знака "=" - номер 0
-			case C_EQ:
-				codegen_->emit(COMPARE, 0);
-				break;
-			//для знака "!=" - номер 1
-			case C_NE:
-				codegen_->emit(COMPARE, 1);
-				break;
-			//для знака "<" - номер 2
-			case C_LT:
-				codegen_->emit(COMPARE, 2);
-				break;
-			//для знака ">" - номер 3
-			case C_GT:
-				codegen_->emit(COMPARE, 3);
-				break;
-			//для знака "<=" - номер 4
-			case C_LE:
-				codegen_->emit(COMPARE, 4);
-				break;
-			//для знака ">=" - номер 5
-			case C_GE:
-				codegen_->emit(COMPARE, 5);
-				break;
-		};
+		node->left = left;
+		node->right = expression();
+		return node;
 	}
 	else {
 		reportError("comparison operator expected.");
+		return left;
 	}
 }
 
-void Parser::arrExpression() {
-	arrTerm();
+AstNode* Parser::arrExpression() {
+	AstNode* left = arrTerm();
 	while (see(T_ADDOP)) {
-		Arithmetic op = scanner_->getArithmeticValue();
+		AstNode* node = arena_.make(AST_BINARY, line_);
+		node->value = arithmeticValue();
 		next();
-		arrTerm();
-		if (op == A_PLUS) {
-			codegen_->emit(ADD);
-		}
-		else {
-			codegen_->emit(SUB);
-		}
+		node->left = left;
+		node->right = arrTerm();
+		left = node;
 	}
+	return left;
 }
 
-void Parser::arrTerm() {
-	arrFactor();
+AstNode* Parser::arrTerm() {
+	AstNode* left = arrFactor();
 	while (see(T_MULOP)) {
-		Arithmetic op = scanner_->getArithmeticValue();
+		AstNode* node = arena_.make(AST_BINARY, line_);
+		node->value = arithmeticValue();
 		next();
-		arrFactor();
-		if (op == A_MULTIPLY) {
-			codegen_->emit(MULT);
-		}
-		else {
-			codegen_->emit(DIV);
-		}
+		node->left = left;
+		node->right = arrFactor();
+		left = node;
 	}
+	return left;
 }
 
-void Parser::arrFactor() {
+AstNode* Parser::arrFactor() {
+	int line = line_;
 	if (see(T_IDENTIFIER)) {
-		int arrAddress = findArray(scanner_->getStringValue());
+		AstNode* node = 0;
+		int arrAddress = findArray(symbolValue());
 		if (arrAddress == -1) {
 			std::ostringstream msg;
-			msg << "Unknown array " << scanner_->getStringValue();
+			msg << "Unknown array " << scanner_->getName(symbolValue());
 			reportError(msg.str());
 		}
 		else {
-			codegen_->emit(LOAD, reserveAddress_ + 1);
-			codegen_->emit(LOAD, findSize(scanner_->getStringValue()));
-			codegen_->emit(COMPARE, 0);
-			codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-			codegen_->emit(JUMP, -1);
-			
-			codegen_->emit(LOAD, reserveAddress_);
-			codegen_->emit(BLOAD, arrAddress);
+			node = arena_.make(AST_ARRAY, line);
+			node->address = arrAddress;
+			node->sizeAddress = findSize(symbolValue());
 		}
 		next();
+		return node;
 	}
-	else if (see(T_ADDOP) && scanner_->getArithmeticValue() == A_MINUS) {
+	else if (see(T_ADDOP) && arithmeticValue() == A_MINUS) {
 		next();
-		arrFactor();
-		codegen_->emit(INVERT);
+		AstNode* node = arena_.make(AST_NEGATE, line);
+		node->left = arrFactor();
+		return node;
 	}
 	else if (match(T_LPAREN)) {
-		arrExpression();
+		AstNode* node = arrExpression();
 		mustBe(T_RPAREN);
+		return node;
 	}
 	else {
 		reportError("Array expected.");
+		return 0;
 	}
 }
 
-int Parser::findOrAddVariable(const string& var)
+int Parser::findOrAddVariable(int var)
 {
-	VarTable::iterator it = variables_.find(var);
-	if(it == variables_.end()) {
-		variables_[var] = lastVar_;
-		return lastVar_++;
-	}
-	else {
-		return it->second;
+	Symbol& entry = symbol(var);
+	if(entry.address == -1) {
+		entry.address = lastVar_++;
 	}
+	return entry.address;
 }
 
-int Parser::findVariable(const string& var)
+int Parser::addArray(int arr, int offset)
 {
-	VarTable::iterator it = variables_.find(var);
-	if (it == variables_.end()) {
-		return -1;
-	}
-	else {
-		return it->second;
-	}
-}
-
-int Parser::findArray(const string& arr) {
-	VarTable::iterator it = arrays_.find(arr);
-	if (it == arrays_.end()) {
-		return -1;
-	}
-	else {
-		return it->second;
-	}
-}
-
-int Parser::addArray(const string& arr, int offset)
-{
-	VarTable::iterator it = arrays_.find(arr);
-	if (it == arrays_.end()) {
-		arrays_[arr] = lastVar_;
-		int oldLastVar_ = lastVar_;
+	Symbol& entry = symbol(arr);
+	if (entry.arrayAddress == -1) {
+		entry.arrayAddress = lastVar_;
 		lastVar_ += offset;
-		arraySizes_[arr] = lastVar_++;
-		return oldLastVar_;
+		entry.sizeAddress = lastVar_++;
+		entry.size = offset;
+		return entry.arrayAddress;
 	}
 	else {
 		return -1; //нельзя переопределять размер массива
 	}
 }
 
-int Parser::findSize(const string& var)
-{
-	VarTable::iterator it = arraySizes_.find(var);
-	if (it == arraySizes_.end()) {
-		return -1;
-	}
-	else {
-		return it->second;
-	}
-}
-
 void Parser::mustBe(Token t)
 {
 	if(!match(t)) {
@@ -589,7 +494,7 @@ void Parser::mustBe(Token t)
 
 		// Подготовим сообщение об ошибке
 		std::ostringstream msg;
-		msg << tokenToString(scanner_->token()) << " found while " << tokenToString(t) << " expected.";
+		msg << tokenToString(token_) << " found while " << tokenToString(t) << " expected.";
 		reportError(msg.str());
 
 		// Попытка восстановления после ошибки.
@@ -597,7 +502,7 @@ void Parser::mustBe(Token t)
 	}
 }
 
-void Parser::recover(Token t, bool goToNext)
+void Parser::recover(Token t, bool /*goToNext*/)
 {
 	while (!see(t) && !see(T_EOF)) {
 		next();
@@ -608,144 +513,3 @@ void Parser::recover(Token t, bool goToNext)
 	}
 }
 
-void Parser::orCode(int arrAddress, int sizeAddress) 
-{
-	codegen_->emit(LOAD, 0);
-	codegen_->emit(BLOAD, arrAddress);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(COMPARE, 0);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 18);
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(DUP);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BLOAD, lastVar_);
-	codegen_->emit(COMPARE, 0);
-	codegen_->emit(JUMP_NO, codegen_->getCurrentAddress() + 3);
-	codegen_->emit(POP);
-	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 15);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 14);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(BSTORE, lastVar_);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(STORE, 2);
-	codegen_->emit(LOAD, 0);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 0);
-	codegen_->emit(LOAD, sizeAddress);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 36);
-}
-
-void Parser::andCode(int arrAddress1, int sizeAddress1, int arrAddress2, int sizeAddress2) {
-	codegen_->emit(LOAD, 0);
-	codegen_->emit(BLOAD, arrAddress1);
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(DUP);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BLOAD, arrAddress2);
-	codegen_->emit(COMPARE, 0);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 11);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(LOAD, sizeAddress2);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 12);
-	codegen_->emit(POP);
-	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 28);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(COMPARE, 0);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 18);
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(DUP);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BLOAD, lastVar_);
-	codegen_->emit(COMPARE, 0);
-	codegen_->emit(JUMP_NO, codegen_->getCurrentAddress() + 3);
-	codegen_->emit(POP);
-	codegen_->emit(JUMP, codegen_->getCurrentAddress() + 15);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 14);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(BSTORE, lastVar_);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(STORE, 2);
-	codegen_->emit(LOAD, 0);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 0);
-	codegen_->emit(LOAD, sizeAddress1);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 53);
-}
-
-void Parser::clear()
-{
-	//index:=0
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(STORE, 1);
-	//while index < size do mem[index]:=0; index++; done
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BSTORE, lastVar_);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 10);
-}
-
-void Parser::copyToDest(int address, int size) {
-	//if size <= arraySize then OK else JUMP -1
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(LOAD, size);
-	codegen_->emit(COMPARE, 4);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() + 2);
-	codegen_->emit(JUMP, -1);
-	//index:=0
-	codegen_->emit(PUSH, 0);
-	codegen_->emit(STORE, 1);
-	//while index < size do array[index]:=mem[index];index++; done
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BLOAD, lastVar_);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(BSTORE, address);
-	codegen_->emit(LOAD, 1);
-	codegen_->emit(PUSH, 1);
-	codegen_->emit(ADD);
-	codegen_->emit(DUP);
-	codegen_->emit(STORE, 1);
-	codegen_->emit(LOAD, 2);
-	codegen_->emit(COMPARE, 2);
-	codegen_->emit(JUMP_YES, codegen_->getCurrentAddress() - 11);
-}
\ No newline at end of file
@@ -2,11 +2,16 @@
 #define CMILAN_PARSER_H
 
 #include "scanner.h"
+#include "tokens.h"
 #include "codegen.h"
+#include "ast.h"
+#include "astgen.h"
+#include "optimizer.h"
 #include <iostream>
 #include <sstream>
 #include <string>
-#include <map>
+#include <thread>
+#include <algorithm>
 
 using namespace std;
 
@@ -14,22 +19,45 @@ using namespace std;
  *
  * Задачи:
  * - проверка корректности программы,
- * - генерация кода для виртуальной машины в процессе анализа,
+ * - построение синтаксического дерева (AstNode),
  * - простейшее восстановление после ошибок.
  *
  * Синтаксический анализатор языка Милан.
  * 
  * Парсер с помощью переданного ему при инициализации лексического анализатора
- * читает по одной лексеме и на основе грамматики Милана генерирует код для
- * стековой виртуальной машины. Синтаксический анализ выполняется методом
- * рекурсивного спуска.
+ * читает по одной лексеме и на основе грамматики Милана строит синтаксическое
+ * дерево программы. Синтаксический анализ выполняется методом рекурсивного
+ * спуска. Код для стековой виртуальной машины формируется по дереву после
+ * разбора: AstCodeGen или, если задан оптимизатор (setOptimizer), Optimizer.
  * 
- * При обнаружении ошибки парсер печатает сообщение и продолжает анализ со
- * следующего оператора, чтобы в процессе разбора найти как можно больше ошибок.
+ * При обнаружении ошибки парсер запоминает сообщение (см. getDiagnostics) и
+ * продолжает анализ со следующего оператора, чтобы в процессе разбора найти
+ * как можно больше ошибок.
  * Поскольку стратегия восстановления после ошибки очень проста, возможна печать
  * сообщений о несуществующих ("наведенных") ошибках или пропуск некоторых
  * ошибок без печати сообщений. Если в процессе разбора была найдена хотя бы
- * одна ошибка, код для виртуальной машины не печатается.*/
+ * одна ошибка, код для виртуальной машины не печатается.
+ *
+ * Парсер не использует глобальных потоков и изменяемых статических данных,
+ * поэтому разные экземпляры можно использовать одновременно в разных потоках.*/
+
+// Сообщение об ошибке в программе
+struct Diagnostic
+{
+	int line;		// номер строки
+	string message;		// текст сообщения
+};
+
+// Печать сообщений об ошибках в виде "Line N: message"
+void printDiagnostics(ostream& errors, const vector<Diagnostic>& diagnostics);
+
+// Способ получения лексем парсером
+enum LexMode
+{
+	LEX_ON_DEMAND,	// сканер читает очередную лексему по запросу парсера
+	LEX_AHEAD,	// весь текст разбивается на лексемы до начала разбора (см. TokenArray)
+	LEX_THREAD	// сканер работает в отдельном потоке одновременно с разбором (см. TokenRing)
+};
 
 class Parser 
 {
@@ -40,43 +68,105 @@ public:
 	// Конструктор создает экземпляры лексического анализатора и генератора.
 
 	Parser(const string& fileName, istream& input)
-		: output_(cout), error_(false), recovered_(true), lastVar_(3), reserveAddress_(0)
+		: tokens_(0), position_(0), ring_(0), lexer_(0), lexMode_(LEX_ON_DEMAND),
+		  optimizer_(0), error_(false), lastVar_(3), memorySize_(0)
 	{
 		scanner_ = new Scanner(fileName, input);
-		codegen_ = new CodeGen(output_);
-		next();
+		codegen_ = new CodeGen();
+	}
+
+	// Конструктор для программы, текст которой находится в буфере [begin, end)
+
+	Parser(const string& fileName, const char* begin, const char* end)
+		: tokens_(0), position_(0), ring_(0), lexer_(0), lexMode_(LEX_ON_DEMAND),
+		  optimizer_(0), error_(false), lastVar_(3), memorySize_(0)
+	{
+		scanner_ = new Scanner(fileName, begin, end);
+		codegen_ = new CodeGen();
 	}
 
 	~Parser()
 	{
+		stopLexer();
+		delete tokens_;
 		delete codegen_;
 		delete scanner_;
 	}
 
-	void parse();	//проводим синтаксический разбор 
+	//способ получения лексем (задается до разбора)
+	void setLexMode(LexMode mode)
+	{
+		lexMode_ = mode;
+	}
+
+	//оптимизирующая генерация кода (0 - код формирует AstCodeGen)
+	void setOptimizer(Optimizer* optimizer)
+	{
+		optimizer_ = optimizer;
+	}
+
+	void parse(ostream& output, ostream& errors);	//проводим синтаксический разбор, печатаем программу в output, ошибки - в errors
+
+	bool compile();	//синтаксический разбор без печати программы. Возвращает true, если ошибок не найдено
+
+	//программа, сформированная при разборе
+	const vector<Command>& getCode() const
+	{
+		return codegen_->getCommands();
+	}
+
+	//передача сформированной программы в code без копирования
+	void takeCode(vector<Command>& code)
+	{
+		codegen_->swapCommands(code);
+	}
+
+	//сообщения об ошибках, найденных при разборе
+	const vector<Diagnostic>& getDiagnostics() const
+	{
+		return diagnostics_;
+	}
+
+	//число слов памяти данных, занятых переменными и массивами (с оптимизацией -
+	//вместе с временными ячейками оптимизатора)
+	int getMemorySize() const
+	{
+		return max(lastVar_, memorySize_);
+	}
 
 private:
-	typedef map<string, int> VarTable;
+	// Описание имени программы. Таблица имен (symbols_) индексируется номером
+	// имени из NameTable. Обычно имя - либо переменная, либо массив; оба адреса
+	// заполнены, только если после ошибки имя использовали и так, и так.
+	struct Symbol
+	{
+		int address;		// адрес переменной или -1
+		int arrayAddress;	// адрес первого элемента массива или -1
+		int sizeAddress;	// адрес ячейки с текущим размером массива или -1
+		int size;		// объявленный размер массива
+
+		Symbol()
+			: address(-1), arrayAddress(-1), sizeAddress(-1), size(0)
+		{
+		}
+	};
 	//описание блоков.
-	void program(); //Разбор программы. BEGIN statementList END
-	void statementList(); // Разбор списка операторов.
-	void statement(); //разбор оператора.
-	void expression(); //разбор арифметического выражения.
-	void term(); //разбор слагаемого.
-	void factor(); //разбор множителя.
-	void relation(); //разбор условия.
-	void arrExpression();//разбор поэлементных операций над массивами
-	void arrTerm();//разбор слагаемого массивов
-	void arrFactor(); //разбор произведения массивов
-	void clear(); //очищает использованную память
-	void copyToDest(int address, int size); //копирует массив (если размер позволяет), полученный при объединении или пересечении в конечный массив
-	void orCode(int arrAddress, int sizeAddress); //формирование кода для операции объединения
-	void andCode(int arrAddress1, int sizeAddress1, int arrAddress2, int sizeAddress2); //формирование кода для операции пересечения
+	AstNode* program(); //Разбор программы. BEGIN statementList END
+	AstNode* statementList(); // Разбор списка операторов.
+	AstNode* statement(); //разбор оператора.
+	AstNode* setOperand(const char* notArray); //разбор операнда объединения или пересечения массивов
+	AstNode* expression(); //разбор арифметического выражения.
+	AstNode* term(); //разбор слагаемого.
+	AstNode* factor(); //разбор множителя.
+	AstNode* relation(); //разбор условия.
+	AstNode* arrExpression();//разбор поэлементных операций над массивами
+	AstNode* arrTerm();//разбор слагаемого массивов
+	AstNode* arrFactor(); //разбор произведения массивов
 
 	// Сравнение текущей лексемы с образцом. Текущая позиция в потоке лексем не изменяется.
 	bool see(Token t)
 	{
-		return scanner_->token() == t; 
+		return token_ == t; 
 	}
 
 	// Проверка совпадения текущей лексемы с образцом. Если лексема и образец совпадают,
@@ -84,8 +174,8 @@ private:
 
 	bool match(Token t)
 	{
-		if(scanner_->token() == t) {
-			scanner_->nextToken();
+		if(token_ == t) {
+			next();
 			return true;
 		}
 		else {
@@ -93,17 +183,54 @@ private:
 		}
 	}
 
-	// Переход к следующей лексеме.
+	// Переход к следующей лексеме. После T_EOF текущей остается T_EOF.
 
 	void next()
 	{
-		scanner_->nextToken();
+		if(tokens_ != 0) {
+			token_ = tokens_->getKind(position_);
+			value_ = tokens_->getValue(position_);
+			line_ = tokens_->getLine(position_);
+			if(position_ + 1 < tokens_->size()) {
+				++position_;
+			}
+		}
+		else if(ring_ != 0) {
+			ring_->pop(token_, value_, line_);
+		}
+		else {
+			scanner_->nextToken();
+			token_ = scanner_->token();
+			value_ = scanner_->getValue();
+			line_ = scanner_->getLineNumber();
+		}
+	}
+
+	//значение текущей лексемы (см. Scanner::getValue)
+	int intValue() const
+	{
+		return value_;
+	}
+	int symbolValue() const
+	{
+		return value_;
+	}
+	Cmp cmpValue() const
+	{
+		return (Cmp)value_;
+	}
+	Arithmetic arithmeticValue() const
+	{
+		return (Arithmetic)value_;
 	}
 
 	// Обработчик ошибок.
 	void reportError(const string& message)
 	{
-		cerr << "Line " << scanner_->getLineNumber() << ": " << message << endl;
+		Diagnostic diagnostic;
+		diagnostic.line = line_;
+		diagnostic.message = message;
+		diagnostics_.push_back(diagnostic);
 		error_ = true;
 	}
 	
@@ -111,28 +238,51 @@ private:
 	//Иначе создаем сообщение об ошибке и пробуем восстановиться
 	void recover(Token t, bool goToNext=true); //восстановление после ошибки: идем по коду до тех пор, 
 	//пока не встретим эту лексему или лексему конца файла.
-	int findOrAddVariable(const string&); //функция пробегает по variables_. 
-	//Если находит нужную переменную - возвращает ее номер, иначе добавляет ее в массив, увеличивает lastVar и возвращает его.
-	int findVariable(const string&); //функция пробегает по variables_. 
-	//Если находит нужную переменную - возвращает ее номер, иначе возвращает -1.
-	int findArray(const string&); //функция пробегает по arrays_.
-	//Если находит нужный массив - возвращает его номер, иначе возвращает -1
-	int addArray(const string&, int offset); //функция пробегает по arrays_.
-	//Если находит нужный массив - возвращает -1 (ошибка), иначе добавляет его в массив, увеличивает lastVar на offset и возвращает старое значение lastVar.
-	//Также идет добавление в arraySizes_
-	int findSize(const string&); //функция пробегает по arraySizes_. 
-	//Если находит нужный размер - возвращает его номер, иначе возвращает -1
+	void stopLexer(); //остановка потока сканера (режим LEX_THREAD)
+
+	//описание имени с номером id (таблица растет по мере появления новых имен)
+	Symbol& symbol(int id)
+	{
+		if(id >= (int)symbols_.size()) {
+			symbols_.resize(max(id + 1, 2 * (int)symbols_.size()));
+		}
+		return symbols_[id];
+	}
+
+	int findOrAddVariable(int); //если имя - переменная, возвращает ее адрес,
+	//иначе размещает переменную по адресу lastVar, увеличивает lastVar и возвращает адрес.
+	int findVariable(int id) //адрес переменной или -1
+	{
+		return symbol(id).address;
+	}
+	int findArray(int id) //адрес массива или -1
+	{
+		return symbol(id).arrayAddress;
+	}
+	int addArray(int, int offset); //если массив уже объявлен - возвращает -1 (ошибка), иначе размещает
+	//его по адресу lastVar, а ячейку размера - сразу за ним, увеличивает lastVar на offset + 1 и возвращает адрес массива.
+	int findSize(int id) //адрес ячейки размера массива или -1
+	{
+		return symbol(id).sizeAddress;
+	}
 
 	Scanner* scanner_; //лексический анализатор для конструктора
+	TokenArray* tokens_; //заранее выделенные лексемы (0 в режиме LEX_ON_DEMAND)
+	size_t position_; //индекс следующей лексемы в tokens_
+	TokenRing* ring_; //буфер лексем от потока сканера (0, если не LEX_THREAD)
+	thread* lexer_; //поток сканера
+	LexMode lexMode_; //способ получения лексем
+	Token token_; //текущая лексема
+	int value_; //значение текущей лексемы
+	int line_; //номер строки текущей лексемы
 	CodeGen* codegen_; //указатель на виртуальную машину
-	ostream& output_; //выходной поток (в данном случае используем cout)
+	AstArena arena_; //узлы синтаксического дерева
+	Optimizer* optimizer_; //оптимизатор или 0
 	bool error_; //флаг ошибки. Используется чтобы определить, выводим ли список команд после разбора или нет
-	bool recovered_; //не используется
-	VarTable variables_; //массив переменных, найденных в программе
-	VarTable arrays_; //массив массивов, найденных в программе
-	VarTable arraySizes_; //массив размеров массивов, найденных в программе
+	vector<Diagnostic> diagnostics_; //сообщения об ошибках
+	vector<Symbol> symbols_; //переменные и массивы по номерам имен
 	int lastVar_; //номер последней записанной переменной
-	int reserveAddress_; //номер зарезервированного адреса, нужно для массивов
+	int memorySize_; //память, которая нужна оптимизированной программе
 };
 
 #endif
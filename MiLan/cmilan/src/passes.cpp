@@ -0,0 +1,36 @@
+#include "passes.h"
+#include <chrono>
+
+PassManager::~PassManager()
+{
+	for(size_t i = 0; i < passes_.size(); ++i) {
+		delete passes_[i];
+	}
+}
+
+void PassManager::add(IrPass* pass)
+{
+	passes_.push_back(pass);
+}
+
+bool PassManager::run(IrFunction& function, vector<PassTime>& times, string& error)
+{
+	if(verify_ && !function.verify(error)) {
+		error = "before optimization: " + error;
+		return false;
+	}
+	for(size_t i = 0; i < passes_.size(); ++i) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		passes_[i]->run(function);
+		PassTime time;
+		time.name = passes_[i]->getName();
+		time.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		times.push_back(time);
+
+		if(verify_ && !function.verify(error)) {
+			error = string("after ") + passes_[i]->getName() + ": " + error;
+			return false;
+		}
+	}
+	return true;
+}
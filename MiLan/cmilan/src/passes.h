@@ -0,0 +1,72 @@
+#ifndef CMILAN_PASSES_H
+#define CMILAN_PASSES_H
+
+#include "ir.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Проход оптимизатора над промежуточным представлением
+
+class IrPass
+{
+public:
+	virtual ~IrPass()
+	{
+	}
+
+	// Имя прохода (для статистики)
+	virtual const char* getName() const = 0;
+
+	// Выполнение прохода. Возвращает true, если функция изменилась.
+	virtual bool run(IrFunction& function) = 0;
+};
+
+// Время работы этапа компиляции
+struct PassTime
+{
+	string name;		// имя прохода или этапа
+	double seconds;		// время в секундах
+};
+
+// Последовательность проходов.
+//
+// Проходы выполняются в порядке добавления; один и тот же проход можно
+// добавить несколько раз. Время работы каждого прохода записывается в
+// PassTime. Если включена проверка, после каждого прохода проверяется
+// корректность представления (IrFunction::verify).
+
+class PassManager
+{
+public:
+	PassManager()
+		: verify_(false)
+	{
+	}
+
+	~PassManager();
+
+	// Добавление прохода (менеджер становится его владельцем)
+	void add(IrPass* pass);
+
+	// Проверка представления после каждого прохода
+	void setVerify(bool verify)
+	{
+		verify_ = verify;
+	}
+
+	// Выполнение всех проходов над function, время работы добавляется в
+	// times. Возвращает false, если проверка нашла ошибку (ее описание
+	// записывается в error).
+	bool run(IrFunction& function, vector<PassTime>& times, string& error);
+
+private:
+	PassManager(const PassManager&);
+	PassManager& operator=(const PassManager&);
+
+	vector<IrPass*> passes_;	// проходы в порядке выполнения
+	bool verify_;			// проверять ли представление
+};
+
+#endif
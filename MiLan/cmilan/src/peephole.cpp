@@ -0,0 +1,259 @@
+#include "peephole.h"
+#include "stackdepth.h"
+
+int Peephole::run()
+{
+	int removed = 0;
+	bool changed = true;
+	while(changed) {
+		findTargets();
+		changed = threadJumps();
+		changed = rewrite() || changed;
+		changed = removeUnreachable() || changed;
+		removed += compact();
+	}
+	return removed;
+}
+
+// Является ли последовательность с адреса address стандартной проверкой
+// индекса: DUP; DUP; LOAD size | PUSH size; COMPARE 2; JUMP_YES +6; JUMP -1;
+// PUSH 0; COMPARE 5; JUMP_YES +10; JUMP -1
+static bool isBoundsCheck(const vector<Command>& program, int address)
+{
+	if(address + 10 > (int)program.size()) {
+		return false;
+	}
+	const Command* c = &program[address];
+	return c[0].getInstruction() == DUP && c[1].getInstruction() == DUP
+		&& (c[2].getInstruction() == LOAD || c[2].getInstruction() == PUSH)
+		&& c[3].getInstruction() == COMPARE && c[3].getArg() == 2
+		&& c[4].getInstruction() == JUMP_YES && c[4].getArg() == address + 6
+		&& c[5].getInstruction() == JUMP && c[5].getArg() == -1
+		&& c[6].getInstruction() == PUSH && c[6].getArg() == 0
+		&& c[7].getInstruction() == COMPARE && c[7].getArg() == 5
+		&& c[8].getInstruction() == JUMP_YES && c[8].getArg() == address + 10
+		&& c[9].getInstruction() == JUMP && c[9].getArg() == -1;
+}
+
+void Peephole::findTargets()
+{
+	int count = program_.size();
+	targets_.assign(count, 0);
+	frozen_.assign(count, 0);
+	if(count > 0) {
+		// Точка входа
+		++targets_[0];
+	}
+	for(int address = 0; address < count; ++address) {
+		const Command& command = program_[address];
+		if(StackDepth::isJump(command.getInstruction())
+			&& (unsigned)command.getArg() < (unsigned)count) {
+			++targets_[command.getArg()];
+		}
+		if(command.getInstruction() == DUP && isBoundsCheck(program_, address)) {
+			for(int i = 0; i < 10; ++i) {
+				frozen_[address + i] = 1;
+			}
+		}
+	}
+}
+
+bool Peephole::threadJumps()
+{
+	bool changed = false;
+	int count = program_.size();
+	for(int address = 0; address < count; ++address) {
+		Instruction instruction = program_[address].getInstruction();
+		if(!StackDepth::isJump(instruction) || frozen_[address]) {
+			continue;
+		}
+
+		int target = program_[address].getArg();
+		for(int step = 0; step < MAX_JUMP_CHAIN; ++step) {
+			if((unsigned)target >= (unsigned)count || program_[target].getInstruction() != JUMP
+				|| program_[target].getArg() == target) {
+				break;
+			}
+			target = program_[target].getArg();
+		}
+
+		if(instruction == JUMP && (unsigned)target < (unsigned)count
+			&& program_[target].getInstruction() == STOP) {
+			program_[address] = Command(STOP);
+			changed = true;
+		}
+		else if(target != program_[address].getArg()) {
+			program_[address] = Command(instruction, target);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+// Можно ли удалить запись в ячейку по адресу address: до чтения ячейки
+// и до переходов в нее снова выполняется запись
+bool Peephole::isDeadStore(int address) const
+{
+	int cell = program_[address].getArg();
+	int end = min((int)program_.size(), address + 1 + MAX_STORE_WINDOW);
+	for(int i = address + 1; i < end && isFree(i); ++i) {
+		const Command& command = program_[i];
+		switch(command.getInstruction()) {
+			case STORE:
+				if(command.getArg() == cell) {
+					return true;
+				}
+				break;
+
+			case LOAD:
+				if(command.getArg() == cell) {
+					return false;
+				}
+				break;
+
+			case NOP:
+			case PUSH:
+			case POP:
+			case DUP:
+			case ADD:
+			case SUB:
+			case MULT:
+			case DIV:
+			case INVERT:
+			case COMPARE:
+			case INPUT:
+			case PRINT:
+			case BSTORE:
+				break;
+
+			default:
+				return false;
+		}
+	}
+	return false;
+}
+
+bool Peephole::rewrite()
+{
+	bool changed = false;
+	int count = program_.size();
+	for(int a = 0; a < count; ++a) {
+		if(frozen_[a]) {
+			continue;
+		}
+		Command& first = program_[a];
+		Instruction instruction = first.getInstruction();
+		int arg = first.getArg();
+		int b = a + 1;
+
+		// Переход на следующую инструкцию
+		if(instruction == JUMP && arg == b) {
+			first = Command(NOP);
+			changed = true;
+			continue;
+		}
+		if((instruction == JUMP_YES || instruction == JUMP_NO) && arg == b) {
+			first = Command(POP);
+			changed = true;
+			continue;
+		}
+
+		if(!isFree(b)) {
+			continue;
+		}
+		Command& second = program_[b];
+
+		// STORE x; LOAD x -> DUP; STORE x
+		if(instruction == STORE && second.getInstruction() == LOAD && second.getArg() == arg) {
+			first = Command(DUP);
+			second = Command(STORE, arg);
+			changed = true;
+		}
+		// LOAD x; STORE x
+		else if(instruction == LOAD && second.getInstruction() == STORE && second.getArg() == arg) {
+			first = Command(NOP);
+			second = Command(NOP);
+			changed = true;
+		}
+		// PUSH n | DUP | LOAD x; POP
+		else if((instruction == PUSH || instruction == DUP || instruction == LOAD)
+			&& second.getInstruction() == POP) {
+			first = Command(NOP);
+			second = Command(NOP);
+			changed = true;
+		}
+		// DUP; STORE x; POP -> STORE x
+		else if(instruction == DUP && second.getInstruction() == STORE && isFree(b + 1)
+			&& program_[b + 1].getInstruction() == POP) {
+			first = Command(NOP);
+			program_[b + 1] = Command(NOP);
+			changed = true;
+		}
+		// JUMP_YES L; JUMP M; L: -> JUMP_NO M
+		else if((instruction == JUMP_YES || instruction == JUMP_NO) && arg == b + 1
+			&& second.getInstruction() == JUMP) {
+			first = Command((instruction == JUMP_YES) ? JUMP_NO : JUMP_YES, second.getArg());
+			second = Command(NOP);
+			changed = true;
+		}
+		// Запись, которую перекрывает следующая запись в ту же ячейку
+		else if(instruction == STORE && isDeadStore(a)) {
+			first = Command(POP);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+bool Peephole::removeUnreachable()
+{
+	bool changed = false;
+	int count = program_.size();
+	for(int address = 0; address < count; ++address) {
+		Instruction instruction = program_[address].getInstruction();
+		if(instruction != JUMP && instruction != STOP) {
+			continue;
+		}
+		while(address + 1 < count && targets_[address + 1] == 0) {
+			++address;
+			if(program_[address].getInstruction() != NOP) {
+				program_[address] = Command(NOP);
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+int Peephole::compact()
+{
+	int count = program_.size();
+	// newAddress[i] - новый адрес первой сохраняемой инструкции, начиная с i
+	vector<int> newAddress(count + 1);
+	int kept = 0;
+	for(int address = 0; address < count; ++address) {
+		newAddress[address] = kept;
+		if(program_[address].getInstruction() != NOP) {
+			++kept;
+		}
+	}
+	newAddress[count] = kept;
+	if(kept == count) {
+		return 0;
+	}
+
+	int next = 0;
+	for(int address = 0; address < count; ++address) {
+		Command command = program_[address];
+		if(command.getInstruction() == NOP) {
+			continue;
+		}
+		if(StackDepth::isJump(command.getInstruction())
+			&& command.getArg() >= 0 && command.getArg() <= count) {
+			command = Command(command.getInstruction(), newAddress[command.getArg()]);
+		}
+		program_[next++] = command;
+	}
+	program_.resize(kept, Command(NOP));
+	return count - kept;
+}
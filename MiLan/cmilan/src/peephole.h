@@ -0,0 +1,62 @@
+#ifndef CMILAN_PEEPHOLE_H
+#define CMILAN_PEEPHOLE_H
+
+#include "codegen.h"
+#include <vector>
+
+using namespace std;
+
+// Оптимизация программы виртуальной машины по "окну" из нескольких
+// соседних инструкций.
+//
+// Выполняются замены:
+// - STORE x; LOAD x            -> DUP; STORE x
+// - LOAD x; STORE x            -> (удаляются)
+// - PUSH n | DUP | LOAD x; POP -> (удаляются)
+// - DUP; STORE x; POP          -> STORE x
+// - STORE x, за которой до чтения x следует STORE x -> POP
+// - JUMP_YES L; JUMP M; L:     -> JUMP_NO M (и наоборот)
+// - переход на JUMP L          -> переход на L
+// - JUMP на STOP               -> STOP
+// - переход на следующую инструкцию -> удаляется (условный - POP)
+// Удаляются также инструкции NOP и недостижимые инструкции, следующие
+// за JUMP и STOP; адреса переходов пересчитываются.
+//
+// Окно не может содержать цели переходов (кроме первой инструкции).
+// Стандартная проверка индекса массива (см. AstCodeGen) не изменяется:
+// виртуальная машина исполняет ее как одну операцию.
+
+class Peephole
+{
+public:
+	Peephole(vector<Command>& program)
+		: program_(program)
+	{
+	}
+
+	// Оптимизация программы. Возвращает число удаленных инструкций.
+	int run();
+
+private:
+	static const int MAX_JUMP_CHAIN = 64;	// наибольшая длина цепочки переходов
+	static const int MAX_STORE_WINDOW = 16;	// окно поиска повторной записи
+
+	void findTargets();		// цели переходов и проверки индексов
+	bool threadJumps();		// замена цепочек переходов
+	bool rewrite();			// замены в окне
+	bool removeUnreachable();	// удаление инструкций после JUMP и STOP
+	bool isDeadStore(int address) const;
+	int compact();			// удаление NOP и пересчет адресов
+
+	// Можно ли изменять инструкцию, которой нет в начале окна
+	bool isFree(int address) const
+	{
+		return address < (int)program_.size() && targets_[address] == 0 && !frozen_[address];
+	}
+
+	vector<Command>& program_;
+	vector<int> targets_;	// число переходов на инструкцию
+	vector<char> frozen_;	// инструкция входит в проверку индекса
+};
+
+#endif
@@ -1,7 +1,7 @@
 #include "scanner.h"
-#include <algorithm>
 #include <iostream>
-#include <cctype>
+#include <cstring>
+#include <iterator>
 
 using namespace std;
 
@@ -35,110 +35,162 @@ static const char * tokenNames_[] = {
 	"';'",
 };
 
+// Ключевые слова, размещенные по значению совершенной хеш-функции keywordHash.
+// Функция подобрана так, что 13 ключевых слов попадают в разные ячейки.
+struct Keyword
+{
+	const char* name;
+	size_t length;
+	Token token;
+};
+
+static const Keyword keywords_[16] = {
+	{ "write", 5, T_WRITE },
+	{ "read", 4, T_READ },
+	{ "else", 4, T_ELSE },
+	{ "fi", 2, T_FI },
+	{ "od", 2, T_OD },
+	{ "do", 2, T_DO },
+	{ "end", 3, T_END },
+	{ "delete", 6, T_DELETE },
+	{ "array", 5, T_ARRAY },
+	{ 0, 0, T_IDENTIFIER },
+	{ "if", 2, T_IF },
+	{ 0, 0, T_IDENTIFIER },
+	{ "then", 4, T_THEN },
+	{ "begin", 5, T_BEGIN },
+	{ "while", 5, T_WHILE },
+	{ 0, 0, T_IDENTIFIER },
+};
+
+static const size_t MIN_KEYWORD_LENGTH = 2;
+static const size_t MAX_KEYWORD_LENGTH = 6;
+
+// Идентификаторы состоят из букв и цифр, поэтому c | 0x20 переводит букву
+// в нижний регистр и не меняет цифру.
+static inline unsigned keywordHash(const char* name, size_t length)
+{
+	return (8 * (name[0] | 0x20) + 5 * (name[1] | 0x20) + 6 * (name[length - 1] | 0x20)) & 15;
+}
+
+// Лексема ключевого слова [name, name + length) или T_IDENTIFIER
+static Token findKeyword(const char* name, size_t length)
+{
+	if(length < MIN_KEYWORD_LENGTH || length > MAX_KEYWORD_LENGTH) {
+		return T_IDENTIFIER;
+	}
+	const Keyword& keyword = keywords_[keywordHash(name, length)];
+	if(keyword.length != length) {
+		return T_IDENTIFIER;
+	}
+	for(size_t i = 0; i < length; ++i) {
+		if((name[i] | 0x20) != keyword.name[i]) {
+			return T_IDENTIFIER;
+		}
+	}
+	return keyword.token;
+}
+
+Scanner::Scanner(const string& fileName, istream& input)
+	: fileName_(fileName), lineNumber_(1)
+{
+	buffer_.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+	position_ = buffer_.c_str();
+	end_ = position_ + buffer_.size();
+	tokenBegin_ = tokenEnd_ = position_;
+	symbol_ = -1;
+}
+
 void Scanner::nextToken()
 {
-	skipSpace();
+	const char* p = position_;
 
-	// Пропускаем комментарии
+	// Пропускаем пробелы и комментарии
 	// Если встречаем "/", то за ним должна идти "*". Если "*" не встречена, считаем, что встретили операцию деления
-	// и лексему - операция типа умножения. Дальше смотрим все символы, пока не находим звездочку или символ конца файла.
+	// и лексему - операция типа умножения. Дальше ищем звездочку или конец текста.
 	// Если нашли * - проверяем на наличие "/" после нее. Если "/" не найден - ищем следующую "*".
-	while(ch_ == '/') {
-		nextChar();
-		if(ch_ == '*') {
-			nextChar();
-			bool inside = true;
-			while(inside) {
-				while(ch_ != '*' && !input_.eof()) {
-					nextChar();
-				}
-
-				if(input_.eof()) {
-					token_ = T_EOF;
-					return;
-				}
-
-				nextChar();
-				if(ch_ == '/') {
-					inside = false;
-					nextChar();
-				}
+	for(;;) {
+		while(isSpace(*p)) {
+			if(*p == '\n') {
+				++lineNumber_;
 			}
+			++p;
+		}
+		if(*p != '/' || p[1] != '*') {
+			break;
 		}
-		else {
-			token_ = T_MULOP;
-			arithmeticValue_ = A_DIVIDE;
-			return;
+		p += 2;
+		for(;;) {
+			p = (const char*)memchr(p, '*', end_ - p);
+			if(p == 0) {
+				position_ = tokenBegin_ = tokenEnd_ = end_;
+				token_ = T_EOF;
+				return;
+			}
+			++p;
+			if(*p == '/') {
+				++p;
+				break;
+			}
 		}
-	
-		skipSpace();
 	}
 
-	//Если встречен конец файла, считаем за лексему конца файла.
-	if(input_.eof()) {
+	tokenBegin_ = p;
+
+	//Если встречен конец текста (ограничитель в его конце), считаем за лексему конца файла.
+	if(*p == '\0' && p == end_) {
 		token_ = T_EOF;
-		return;
 	}
 	//Если встретили цифру, то до тех пока дальше идут цифры - считаем как продолжение числа.
-	//Запоминаем полученное целое, а за лексему считаем целочисленный литерал
-	
-	if(isdigit(ch_)) {
-		int value = 0;
-		while(isdigit(ch_)) {
-			value = value * 10 + (ch_ - '0'); //поразрядное считывание, преобразуем символьное значение к числу.
-			nextChar();
-		}
+	//Запоминаем полученное целое, а за лексему считаем целочисленный литерал.
+	//Переполнение, как и прежде, происходит по модулю 2^32.
+	else if(isDigit(*p)) {
+		unsigned value = 0;
+		do {
+			value = value * 10 + (*p - '0');
+			++p;
+		} while(isDigit(*p));
 		token_ = T_NUMBER;
-		intValue_ = value;
+		intValue_ = (int)value;
 	}
-	//Если же следующий символ - буква ЛА - тогда считываем до тех пор, пока дальше буквы ЛА или цифры. 
-	//Как только считали имя переменной, сравниваем ее со списком зарезервированных слов. Если не совпадает ни с одним из них,
-	//считаем, что получили переменную, имя которой запоминаем, а за текущую лексему считаем лексему идентификатора.
-	//Если совпадает с каким-либо словом из списка - считаем что получили лексему, соответствующую этому слову.
-	else if(isIdentifierStart(ch_)) {
-		string buffer;
-		while(isIdentifierBody(ch_)) {
-			buffer += ch_;
-			nextChar();
-		}
+	//Если же следующий символ - буква ЛА - тогда считываем до тех пор, пока дальше буквы ЛА или цифры.
+	//Если имя совпадает с каким-либо зарезервированным словом - считаем что получили лексему, соответствующую
+	//этому слову, иначе - лексему идентификатора с номером имени из таблицы имен. Хеш для таблицы имен
+	//вычисляется тем же проходом.
+	else if(isIdentifierStart(*p)) {
+		unsigned hash = NameTable::HASH_BASIS;
+		do {
+			hash = NameTable::hashChar(hash, *p);
+			++p;
+		} while(isIdentifierBody(*p));
 
-		transform(buffer.begin(), buffer.end(), buffer.begin(), ::tolower);
-
-		map<string, Token>::iterator kwd = keywords_.find(buffer);
-		if(kwd == keywords_.end()) {
-			token_ = T_IDENTIFIER;
-			stringValue_ = buffer;
-		}
-		else {
-			token_ = kwd->second;
+		size_t length = p - tokenBegin_;
+		token_ = findKeyword(tokenBegin_, length);
+		if(token_ == T_IDENTIFIER) {
+			symbol_ = names_.intern(tokenBegin_, length, hash);
 		}
 	}
-	//Символ не является буквой, цифрой, "/" или признаком конца файла
+	//Символ не является буквой, цифрой или признаком конца текста
 	else {
-		switch(ch_) {
+		switch(*p++) {
 			//Признак лексемы открывающей скобки - встретили "("
 			case '(':
 				token_ = T_LPAREN;
-				nextChar();
 				break;
 			//Признак лексемы закрывающей скобки - встретили ")"
 			case ')':
 				token_ = T_RPAREN;
-				nextChar();
 				break;
 			//Признак лексемы ";" - встретили ";"
 			case ';':
 				token_ = T_SEMICOLON;
-				nextChar();
 				break;
 			//Если встречаем ":", то дальше смотрим наличие символа "=". Если находим, то считаем что нашли лексему присваивания
 			//Иначе - лексема ошибки.
 			case ':':
-				nextChar();
-				if(ch_ == '=') {
+				if(*p == '=') {
 					token_ = T_ASSIGN;
-					nextChar();
-				
+					++p;
 				}
 				else {
 					token_ = T_ILLEGAL;
@@ -147,10 +199,9 @@ void Scanner::nextToken()
 			//Если встретили символ "<", то либо следующий символ "=", тогда лексема нестрогого сравнения. Иначе - строгого.
 			case '<':
 				token_ = T_CMP;
-				nextChar();
-				if(ch_ == '=') {
+				if(*p == '=') {
 					cmpValue_ = C_LE;
-					nextChar();
+					++p;
 				}
 				else {
 					cmpValue_ = C_LT;
@@ -159,10 +210,9 @@ void Scanner::nextToken()
 			//Аналогично предыдущему случаю
 			case '>':
 				token_ = T_CMP;
-				nextChar();
-				if(ch_ == '=') {
+				if(*p == '=') {
 					cmpValue_ = C_GE;
-					nextChar();
+					++p;
 				}
 				else {
 					cmpValue_ = C_GT;
@@ -171,9 +221,8 @@ void Scanner::nextToken()
 			//Если встретим "!", то дальше должно быть "=", тогда считаем, что получили лексему сравнения 
 			//и знак "!=" иначе считаем, что у нас лексема ошибки
 			case '!':
-				nextChar();
-				if(ch_ == '=') {
-					nextChar();
+				if(*p == '=') {
+					++p;
 					token_ = T_CMP;
 					cmpValue_ = C_NE;
 				}
@@ -185,69 +234,50 @@ void Scanner::nextToken()
 			case '=':
 				token_ = T_CMP;
 				cmpValue_ = C_EQ;
-				nextChar();
 				break;
 			//Знаки операций. Для "+"/"-" получим лексему операции типа сложнения, и соответствующую операцию.
-			//для "*" - лексему операции типа умножения
+			//для "*" и "/" - лексему операции типа умножения
 			case '+':
 				token_ = T_ADDOP;
 				arithmeticValue_ = A_PLUS;
-				nextChar();
 				break;
 
 			case '-':
 				token_ = T_ADDOP;
 				arithmeticValue_ = A_MINUS;
-				nextChar();
 				break;
 
 			case '|':
 				token_ = T_ARROP;
 				arithmeticValue_ = A_PLUS;
-				nextChar();
 				break;
 
 			case '*':
 				token_ = T_MULOP;
 				arithmeticValue_ = A_MULTIPLY;
-				nextChar();
+				break;
+			case '/':
+				token_ = T_MULOP;
+				arithmeticValue_ = A_DIVIDE;
 				break;
 			case '&':
 				token_ = T_ARROP;
 				arithmeticValue_ = A_MULTIPLY;
-				nextChar();
 				break;
 			case '[':
 				token_ = T_LQPAREN;
-				nextChar();
 				break;
 			case ']':
 				token_ = T_RQPAREN;
-				nextChar();
 				break;
-			//Иначе лексема ошибки.
+			//Иначе (в том числе для нулевого байта внутри текста) лексема ошибки.
 			default:
 				token_ = T_ILLEGAL;
-				nextChar();
 				break;
 		}
 	}
-}
-
-void Scanner::skipSpace()
-{
-	while(isspace(ch_)) {
-		if(ch_ == '\n') {
-			++lineNumber_;
-		}
-
-		nextChar();
-	}
-}
 
-void Scanner::nextChar()
-{
-	ch_ = input_.get();
+	tokenEnd_ = position_ = p;
 }
 
 const char * tokenToString(Token t)
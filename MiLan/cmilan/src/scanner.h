@@ -3,7 +3,8 @@
 
 #include <fstream>
 #include <string>
-#include <map>
+#include "nametable.h"
+#include <string_view>
 
 using namespace std;
 
@@ -60,31 +61,36 @@ enum Arithmetic {
 };
 
 // Лексический анализатор
+//
+// Текст программы целиком находится в памяти (в отображенном файле, строке
+// или внутреннем буфере), и лексемы выделяются прямым проходом указателя по
+// тексту. За последним символом текста должен находиться нулевой байт-ограничитель:
+// циклы чтения чисел, идентификаторов и пробелов останавливаются на нем без
+// отдельной проверки конца буфера. Нулевой байт внутри текста считается
+// недопустимым символом.
+//
+// Текст идентификаторов и чисел доступен в виде ссылки на исходный текст
+// (getText()) без копирования. Ключевые слова распознаются по совершенной
+// хеш-функции, остальные идентификаторы заносятся в таблицу имен (NameTable),
+// и лексема T_IDENTIFIER несет номер имени (getSymbol()).
 
 class Scanner
 {
 public:
 	// Конструктор. В качестве аргумента принимает имя файла и поток,
-        // из которого будут читаться символы транслируемой программы.
+	// из которого будут читаться символы транслируемой программы.
+	// Поток читается целиком во внутренний буфер.
 
-	explicit Scanner(const string& fileName, istream& input)
-		: fileName_(fileName), lineNumber_(1), input_(input)
-	{
-		keywords_["begin"] = T_BEGIN;
-		keywords_["end"] = T_END;
-		keywords_["if"] = T_IF;
-		keywords_["then"] = T_THEN;
-		keywords_["else"] = T_ELSE;
-		keywords_["fi"] = T_FI;
-		keywords_["while"] = T_WHILE;
-		keywords_["do"] = T_DO;
-		keywords_["od"] = T_OD;
-		keywords_["write"] = T_WRITE;
-		keywords_["read"] = T_READ;
-		keywords_["delete"] = T_DELETE;
-		keywords_["array"] = T_ARRAY;
+	Scanner(const string& fileName, istream& input);
+
+	// Конструктор для программы, текст которой уже находится в памяти
+	// (в буфере [begin, end)). Символ *end должен быть доступен для чтения
+	// и равен '\0'. Буфер должен существовать, пока идет разбор.
 
-		nextChar();
+	Scanner(const string& fileName, const char* begin, const char* end)
+		: fileName_(fileName), lineNumber_(1), symbol_(-1), position_(begin), end_(end),
+		  tokenBegin_(begin), tokenEnd_(begin)
+	{
 	}
 
 	// Деструктор
@@ -112,9 +118,40 @@ public:
 		return intValue_;
 	}
 	
-	string getStringValue() const
+	// Номер имени идентификатора в таблице имен
+	int getSymbol() const
+	{
+		return symbol_;
+	}
+
+	// Имя идентификатора (в нижнем регистре)
+	const string& getStringValue() const
+	{
+		return names_.getName(symbol_);
+	}
+
+	// Имя с номером id
+	const string& getName(int id) const
 	{
-		return stringValue_;
+		return names_.getName(id);
+	}
+
+	// Число различных имен, встреченных в тексте
+	int getNameCount() const
+	{
+		return names_.getCount();
+	}
+
+	// Число еще не прочитанных символов текста
+	size_t getRemaining() const
+	{
+		return end_ - position_;
+	}
+
+	// Текст текущей лексемы в исходном виде
+	string_view getText() const
+	{
+		return string_view(tokenBegin_, tokenEnd_ - tokenBegin_);
 	}
 	
 	Cmp getCmpValue() const
@@ -127,28 +164,55 @@ public:
 		return arithmeticValue_;
 	}
 
+	// Значение текущей лексемы одним числом: значение литерала для T_NUMBER,
+	// номер имени для T_IDENTIFIER, вид операции для T_CMP, T_ADDOP, T_MULOP
+	// и T_ARROP, 0 для остальных лексем
+	int getValue() const
+	{
+		switch(token_) {
+			case T_NUMBER:
+				return intValue_;
+			case T_IDENTIFIER:
+				return symbol_;
+			case T_CMP:
+				return cmpValue_;
+			case T_ADDOP:
+			case T_MULOP:
+			case T_ARROP:
+				return arithmeticValue_;
+			default:
+				return 0;
+		}
+	}
+
 	// Переход к следующей лексеме.
 	// Текущая лексема записывается в token_ и изымается из потока.
 	void nextToken();	
 private:
-
 	// Пропуск всех пробельные символы. 
 	// Если встречается символ перевода строки, номер текущей строки
 	// (lineNumber) увеличивается на единицу.
 	void skipSpace();
 
-
- 	void nextChar(); //переходит к следующему символу
 	//проверка переменной на первый символ (должен быть буквой латинского алфавита)
-	bool isIdentifierStart(char c)
+	static bool isIdentifierStart(char c)
 	{
 		return ((c >= 'a' && c <= 'z') ||
 			    (c >= 'A' && c <= 'Z'));
 	}
 	//проверка на остальные символы переменной (буква или цифра)
-	bool isIdentifierBody(char c)
+	static bool isIdentifierBody(char c)
+	{
+		return isIdentifierStart(c) || isDigit(c);
+	}
+	static bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+	//пробельные символы (как isspace в локали "C")
+	static bool isSpace(char c)
 	{
-		return isIdentifierStart(c) || isdigit(c);
+		return c == ' ' || (c >= '\t' && c <= '\r');
 	}
 
 
@@ -157,15 +221,17 @@ private:
 	
 	Token token_; //текущая лексема
 	int intValue_; //значение текущего целого
-	string stringValue_; //имя переменной
 	Cmp cmpValue_; //значение оператора сравнения (>, <, =, !=, >=, <=)
 	Arithmetic arithmeticValue_; //значение знака (+,-,*,/)
 
-	map<string, Token> keywords_; //ассоциативный массив с лексемами и 
-	//соответствующими им зарезервированными словами в качестве индексов
+	int symbol_; //номер имени текущего идентификатора
+	NameTable names_; //таблица имен идентификаторов
 
-	istream& input_; //входной поток для чтения из файла.
-	char ch_; //текущий символ
+	string buffer_; //текст, прочитанный из потока (пуст, если текст во внешнем буфере)
+	const char* position_; //текущий символ
+	const char* end_; //конец текста (на нем находится ограничитель '\0')
+	const char* tokenBegin_; //начало текущей лексемы
+	const char* tokenEnd_; //конец текущей лексемы
 };
 
 #endif
@@ -0,0 +1,266 @@
+#include "server.h"
+#include "bytecode.h"
+#include "vm.h"
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CMILAN_SERVER
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Чтение и запись целых чисел и блоков сообщения
+
+static void putUint32(string& buffer, uint32_t value)
+{
+	char bytes[4] = {
+		(char)(value & 0xFF), (char)((value >> 8) & 0xFF),
+		(char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF)
+	};
+	buffer.append(bytes, 4);
+}
+
+static uint32_t getUint32(const char* bytes)
+{
+	const unsigned char* p = (const unsigned char*)bytes;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void putBlock(string& buffer, const string& block)
+{
+	putUint32(buffer, block.size());
+	buffer += block;
+}
+
+// Чтение блока из request с позиции position
+static bool getBlock(const string& request, size_t& position, const char*& begin, const char*& end)
+{
+	if(request.size() - position < 4) {
+		return false;
+	}
+	uint32_t size = getUint32(request.data() + position);
+	position += 4;
+	if(request.size() - position < size) {
+		return false;
+	}
+	begin = request.data() + position;
+	end = begin + size;
+	position += size;
+	return true;
+}
+
+// Обработка запроса (без длины сообщения). Возвращает false при нарушении протокола.
+bool CompileServer::handle(const string& request, string& response)
+{
+	response.clear();
+	if(request.empty()) {
+		return false;
+	}
+	int type = (unsigned char)request[0];
+	size_t position = 1;
+	const char* source;
+	const char* sourceEnd;
+	const char* input = 0;
+	const char* inputEnd = 0;
+	if((type != SERVER_COMPILE && type != SERVER_RUN)
+		|| !getBlock(request, position, source, sourceEnd)
+		|| (type == SERVER_RUN && !getBlock(request, position, input, inputEnd))
+		|| position != request.size()) {
+		return false;
+	}
+
+	Compiler compiler;
+	CompileResult result;
+	ServerResult status = SERVER_OK;
+	string bytecode;
+	string output;
+	ostringstream diagnostics;
+
+	// Текст программы в запросе не завершен нулевым байтом
+	if(!compiler.compile(string(source, sourceEnd), result)) {
+		status = SERVER_COMPILE_ERROR;
+		printDiagnostics(diagnostics, result.diagnostics);
+	}
+	else if(type == SERVER_COMPILE) {
+		ostringstream image;
+		BytecodeFile::write(image, result.code, result.memorySize);
+		bytecode = image.str();
+	}
+	else {
+		istringstream programInput(string(input, inputEnd));
+		ostringstream programOutput;
+		VirtualMachine vm(programInput, programOutput,
+			max((int)VirtualMachine::DEFAULT_MEMORY_SIZE, result.memorySize));
+		vm.load(result.code);
+		VmStatus vmStatus = vm.run();
+		output = programOutput.str();
+		if(vmStatus != VM_OK) {
+			status = SERVER_RUNTIME_ERROR;
+			diagnostics << "Runtime error at address " << vm.getAddress() << ": "
+				<< vmStatusToString(vmStatus) << '\n';
+		}
+	}
+
+	response += (char)status;
+	putBlock(response, bytecode);
+	putBlock(response, diagnostics.str());
+	putBlock(response, output);
+	return true;
+}
+
+#ifdef CMILAN_SERVER
+
+// Чтение и запись ровно size байт
+static bool readAll(int fd, char* data, size_t size)
+{
+	while(size > 0) {
+		ssize_t n = read(fd, data, size);
+		if(n < 0 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) {
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool writeAll(int fd, const char* data, size_t size)
+{
+	while(size > 0) {
+		ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) {
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool writeMessage(int fd, const string& message)
+{
+	string header;
+	putUint32(header, message.size());
+	return writeAll(fd, header.data(), header.size())
+		&& writeAll(fd, message.data(), message.size());
+}
+
+bool CompileServer::isSupported()
+{
+	return true;
+}
+
+CompileServer::~CompileServer()
+{
+	if(socket_ >= 0) {
+		close(socket_);
+		unlink(path_.c_str());
+	}
+}
+
+// Обслуживание клиента до закрытия соединения или ошибки протокола.
+// Буферы запроса и ответа используются повторно для всех запросов соединения.
+void CompileServer::serveClient(int client)
+{
+	string request;
+	string response;
+	char header[4];
+	while(readAll(client, header, sizeof(header))) {
+		uint32_t size = getUint32(header);
+		bool valid = size <= MAX_MESSAGE_SIZE;
+		if(valid) {
+			request.resize(size);
+			if(size > 0 && !readAll(client, &request[0], size)) {
+				break;
+			}
+			valid = handle(request, response);
+		}
+		if(!valid) {
+			response.assign(1, (char)SERVER_BAD_REQUEST);
+			putBlock(response, string());
+			putBlock(response, "bad request\n");
+			putBlock(response, string());
+			writeMessage(client, response);
+			break;
+		}
+		if(!writeMessage(client, response)) {
+			break;
+		}
+	}
+	close(client);
+}
+
+bool CompileServer::serve(ostream& errors)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(path_.size() >= sizeof(address.sun_path)) {
+		errors << "Socket path '" << path_ << "' is too long" << endl;
+		return false;
+	}
+	strcpy(address.sun_path, path_.c_str());
+
+	socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(socket_ < 0) {
+		errors << "Cannot create socket: " << strerror(errno) << endl;
+		return false;
+	}
+	unlink(path_.c_str());
+	if(bind(socket_, (sockaddr*)&address, sizeof(address)) != 0 || listen(socket_, SOMAXCONN) != 0) {
+		errors << "Cannot listen on '" << path_ << "': " << strerror(errno) << endl;
+		close(socket_);
+		socket_ = -1;
+		return false;
+	}
+
+	for(;;) {
+		int client = accept(socket_, 0, 0);
+		if(client < 0) {
+			if(errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			errors << "Cannot accept connection: " << strerror(errno) << endl;
+			return false;
+		}
+		thread(&CompileServer::serveClient, client).detach();
+	}
+}
+
+#else
+
+bool CompileServer::isSupported()
+{
+	return false;
+}
+
+CompileServer::~CompileServer()
+{
+}
+
+void CompileServer::serveClient(int)
+{
+}
+
+bool CompileServer::serve(ostream& errors)
+{
+	errors << "Compile server is not supported on this platform" << endl;
+	return false;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CMILAN_SERVER_H
+#define CMILAN_SERVER_H
+
+#include "compiler.h"
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+// Сервер компиляции (cmilan --serve path).
+//
+// Принимает запросы на компиляцию и исполнение программ через локальный
+// сокет Unix, так что процесс компилятора запускается один раз. Клиенты
+// обслуживаются одновременно, каждый в своем потоке; в одном соединении
+// можно передать несколько запросов подряд.
+//
+// Протокол. Все целые числа - 32-битные беззнаковые, little-endian; "блок" -
+// длина и следующие за ней байты. Каждое сообщение начинается с длины
+// остальной части сообщения.
+//
+//     запрос:  длина, тип (1 байт), блок: текст программы,
+//              [для SERVER_RUN] блок: входные данные программы
+//     ответ:   длина, результат (1 байт), блок: программа в двоичном формате
+//              (BytecodeFile, только для SERVER_COMPILE), блок: сообщения об
+//              ошибках ("Line N: message", по одному в строке), блок: вывод
+//              программы (только для SERVER_RUN)
+//
+// При нарушении протокола сервер отвечает SERVER_BAD_REQUEST и закрывает
+// соединение.
+
+enum ServerRequest
+{
+	SERVER_COMPILE = 1,	// компиляция
+	SERVER_RUN = 2		// компиляция и исполнение интерпретатором
+};
+
+enum ServerResult
+{
+	SERVER_OK = 0,			// программа скомпилирована (и исполнена)
+	SERVER_COMPILE_ERROR = 1,	// в программе есть ошибки
+	SERVER_RUNTIME_ERROR = 2,	// ошибка времени исполнения
+	SERVER_BAD_REQUEST = 3		// неверный запрос
+};
+
+class CompileServer
+{
+public:
+	static const unsigned MAX_MESSAGE_SIZE = 64 << 20;	// наибольшая длина запроса
+
+	// Конструктор
+	//     const string& path - путь к сокету
+	explicit CompileServer(const string& path)
+		: path_(path), socket_(-1)
+	{
+	}
+
+	~CompileServer();
+
+	// Доступен ли сервер на этой платформе
+	static bool isSupported();
+
+	// Создание сокета и обслуживание клиентов. Возвращает управление
+	// только при ошибке; описание ошибки печатается в errors.
+	bool serve(ostream& errors);
+
+private:
+	CompileServer(const CompileServer&);
+	CompileServer& operator=(const CompileServer&);
+
+	static void serveClient(int client);
+	static bool handle(const string& request, string& response);
+
+	string path_;	// путь к сокету
+	int socket_;	// слушающий сокет
+};
+
+#endif
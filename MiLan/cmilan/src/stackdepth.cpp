@@ -0,0 +1,132 @@
+#include "stackdepth.h"
+#include <algorithm>
+
+// Ошибка, которую гарантированно вызовет инструкция при глубине стека depth,
+// или VM_OK
+VmStatus StackDepth::failure(const Command& command, int depth) const
+{
+	int arg = command.getArg();
+	switch(command.getInstruction()) {
+		case NOP:
+		case STOP:
+		case JUMP:
+			return VM_OK;
+
+		case LOAD:
+			if(depth + 1 > stackSize_) {
+				return VM_STACK_OVERFLOW;
+			}
+			return (unsigned)arg < (unsigned)memorySize_ ? VM_OK : VM_BAD_ADDRESS;
+
+		case STORE:
+			if(depth < 1) {
+				return VM_STACK_UNDERFLOW;
+			}
+			return (unsigned)arg < (unsigned)memorySize_ ? VM_OK : VM_BAD_ADDRESS;
+
+		case PUSH:
+		case INPUT:
+			return (depth + 1 > stackSize_) ? VM_STACK_OVERFLOW : VM_OK;
+
+		case DUP:
+			if(depth < 1) {
+				return VM_STACK_UNDERFLOW;
+			}
+			return (depth + 1 > stackSize_) ? VM_STACK_OVERFLOW : VM_OK;
+
+		case BLOAD:
+		case POP:
+		case INVERT:
+		case JUMP_YES:
+		case JUMP_NO:
+		case PRINT:
+			return (depth < 1) ? VM_STACK_UNDERFLOW : VM_OK;
+
+		case BSTORE:
+		case ADD:
+		case SUB:
+		case MULT:
+		case DIV:
+			return (depth < 2) ? VM_STACK_UNDERFLOW : VM_OK;
+
+		case COMPARE:
+			if(depth < 2) {
+				return VM_STACK_UNDERFLOW;
+			}
+			return (arg >= 0 && arg <= 5) ? VM_OK : VM_BAD_INSTRUCTION;
+
+		default:
+			return VM_BAD_INSTRUCTION;
+	}
+}
+
+int StackDepth::getEffect(Instruction instruction)
+{
+	switch(instruction) {
+		case LOAD: case PUSH: case DUP: case INPUT:
+			return 1;
+		case STORE: case POP: case ADD: case SUB: case MULT: case DIV:
+		case COMPARE: case JUMP_YES: case JUMP_NO: case PRINT:
+			return -1;
+		case BSTORE:
+			return -2;
+		default:
+			return 0;
+	}
+}
+
+// Вычисление глубины стека перед каждой достижимой инструкцией
+bool StackDepth::analyze()
+{
+	depth_.assign(count_, -1);
+	targets_.assign(count_ + 1, 0);
+	if(count_ == 0) {
+		return true;
+	}
+
+	vector<int> worklist;
+	depth_[0] = 0;
+	worklist.push_back(0);
+
+	while(!worklist.empty()) {
+		int address = worklist.back();
+		worklist.pop_back();
+
+		const Command& command = program_[address];
+		int depth = depth_[address];
+		maxDepth_ = max(maxDepth_, depth);
+		if(failure(command, depth) != VM_OK) {
+			continue;
+		}
+
+		Instruction instruction = command.getInstruction();
+		int after = depth + getEffect(instruction);
+		maxDepth_ = max(maxDepth_, after);
+
+		int successors[2];
+		int n = 0;
+		if(instruction != STOP && instruction != JUMP) {
+			successors[n++] = address + 1;
+		}
+		if(isJump(instruction) && isValidTarget(command.getArg())) {
+			successors[n++] = command.getArg();
+			++targets_[command.getArg()];
+		}
+
+		for(int i = 0; i < n; ++i) {
+			int next = successors[i];
+			if(next == count_) {
+				continue;	// выход за конец программы
+			}
+			if(depth_[next] < 0) {
+				depth_[next] = after;
+				worklist.push_back(next);
+			}
+			else if(depth_[next] != after) {
+				return false;
+			}
+		}
+	}
+
+	return maxDepth_ <= stackSize_;
+}
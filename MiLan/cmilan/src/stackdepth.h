@@ -0,0 +1,83 @@
+#ifndef CMILAN_STACKDEPTH_H
+#define CMILAN_STACKDEPTH_H
+
+#include "codegen.h"
+#include "vm.h"
+#include <vector>
+
+using namespace std;
+
+// Анализ глубины стека программы виртуальной машины.
+//
+// Для каждой достижимой с адреса 0 инструкции вычисляется глубина стека перед
+// ее исполнением. Программы, которые формирует компилятор, имеют постоянную
+// глубину стека в каждой точке, поэтому проверки стека и недопустимые адреса
+// LOAD/STORE можно обработать до исполнения, а слова стека - разместить
+// в фиксированных местах. Используется JIT-компилятором и генератором кода на C.
+
+class StackDepth
+{
+public:
+	StackDepth(const vector<Command>& program, int memorySize, int stackSize)
+		: program_(program), count_(program.size()), memorySize_(memorySize),
+		  stackSize_(stackSize), maxDepth_(0)
+	{
+	}
+
+	// Анализ программы. Возвращает false, если в какую-либо инструкцию можно
+	// попасть с разной глубиной стека или стек может оказаться глубже stackSize.
+	bool analyze();
+
+	// Глубина стека перед инструкцией или -1, если инструкция недостижима
+	int getDepth(int address) const
+	{
+		return depth_[address];
+	}
+
+	// Наибольшая глубина стека
+	int getMaxDepth() const
+	{
+		return maxDepth_;
+	}
+
+	// Число переходов на инструкцию из достижимых инструкций
+	int getTargetCount(int address) const
+	{
+		return targets_[address];
+	}
+
+	// Ошибка, которую гарантированно вызовет достижимая инструкция, или VM_OK.
+	// Порядок проверок совпадает с интерпретатором.
+	VmStatus getFailure(int address) const
+	{
+		return failure(program_[address], depth_[address]);
+	}
+
+	// Является ли адрес допустимой целью перехода
+	bool isValidTarget(int address) const
+	{
+		return (unsigned)address < (unsigned)count_;
+	}
+
+	// Изменение глубины стека после исполнения инструкции
+	static int getEffect(Instruction instruction);
+
+	// Является ли инструкция переходом
+	static bool isJump(Instruction instruction)
+	{
+		return instruction == JUMP || instruction == JUMP_YES || instruction == JUMP_NO;
+	}
+
+private:
+	VmStatus failure(const Command& command, int depth) const;
+
+	const vector<Command>& program_;
+	const int count_;
+	const int memorySize_;
+	const int stackSize_;
+	int maxDepth_;		// наибольшая глубина стека
+	vector<int> depth_;	// глубина стека перед инструкцией (-1 - недостижима)
+	vector<int> targets_;	// число переходов на инструкцию
+};
+
+#endif
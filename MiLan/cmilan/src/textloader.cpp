@@ -0,0 +1,277 @@
+#include "textloader.h"
+#include "mappedfile.h"
+#include <cstdio>
+#include <climits>
+
+// Код операции: имя, инструкция и число аргументов. SET задается числом
+// аргументов 2, поле instruction для нее не используется.
+struct Mnemonic
+{
+	const char* name;
+	int length;
+	Instruction instruction;
+	int args;
+};
+
+// Таблица кодов операций, упорядоченная по значению mnemonicHash.
+// Хеш-функция подобрана так, что у всех кодов операций значения различны,
+// поэтому поиск требует одного сравнения строк.
+static const Mnemonic mnemonics[32] = {
+	{ "DIV", 3, DIV, 0 },
+	{ 0, 0, NOP, 0 },
+	{ 0, 0, NOP, 0 },
+	{ 0, 0, NOP, 0 },
+	{ 0, 0, NOP, 0 },
+	{ "ADD", 3, ADD, 0 },
+	{ "BLOAD", 5, BLOAD, 1 },
+	{ "JUMP_YES", 8, JUMP_YES, 1 },
+	{ "PRINT", 5, PRINT, 0 },
+	{ "INPUT", 5, INPUT, 0 },
+	{ "DUP", 3, DUP, 0 },
+	{ "JUMP_NO", 7, JUMP_NO, 1 },
+	{ "STORE", 5, STORE, 1 },
+	{ "SET", 3, NOP, 2 },
+	{ "COMPARE", 7, COMPARE, 1 },
+	{ "MULT", 4, MULT, 0 },
+	{ "NOP", 3, NOP, 0 },
+	{ "INVERT", 6, INVERT, 0 },
+	{ "POP", 3, POP, 0 },
+	{ "SUB", 3, SUB, 0 },
+	{ 0, 0, NOP, 0 },
+	{ 0, 0, NOP, 0 },
+	{ "PUSH", 4, PUSH, 1 },
+	{ 0, 0, NOP, 0 },
+	{ "JUMP", 4, JUMP, 1 },
+	{ 0, 0, NOP, 0 },
+	{ "LOAD", 4, LOAD, 1 },
+	{ "STOP", 4, STOP, 0 },
+	{ 0, 0, NOP, 0 },
+	{ "BSTORE", 6, BSTORE, 1 },
+	{ 0, 0, NOP, 0 },
+	{ 0, 0, NOP, 0 }
+};
+
+// Все коды операций не короче трех символов
+static inline unsigned mnemonicHash(const char* name, int length)
+{
+	return ((unsigned char)name[0] + 6 * (unsigned char)name[1]
+		+ 5 * (unsigned char)name[length - 1] + 8 * length) & 31;
+}
+
+static const Mnemonic* findMnemonic(const char* name, int length)
+{
+	if(length < 3) {
+		return 0;
+	}
+	const Mnemonic* m = &mnemonics[mnemonicHash(name, length)];
+	if(m->length != length) {
+		return 0;
+	}
+	for(int i = 0; i < length; ++i) {
+		if(m->name[i] != name[i]) {
+			return 0;
+		}
+	}
+	return m;
+}
+
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline bool isMnemonicChar(char c)
+{
+	return (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline void skipBlanks(const char*& p, const char* end)
+{
+	while(p < end && isBlank(*p)) {
+		++p;
+	}
+}
+
+// Разбор целого числа со знаком. Возвращает 0 или описание ошибки.
+static const char* parseInt(const char*& p, const char* end, int& value)
+{
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+	if(p == end || !isDigit(*p)) {
+		return "number expected";
+	}
+
+	const unsigned limit = negative ? 2147483648u : 2147483647u;
+	unsigned result = 0;
+	while(p < end && isDigit(*p)) {
+		unsigned digit = *p - '0';
+		if(result > (limit - digit) / 10) {
+			return "number is out of range";
+		}
+		result = result * 10 + digit;
+		++p;
+	}
+	value = negative ? (int)(0u - result) : (int)result;
+	return 0;
+}
+
+bool TextLoader::fail(int line, const char* message)
+{
+	error_ = message;
+	errorLine_ = line;
+	return false;
+}
+
+bool TextLoader::load(const char* fileName)
+{
+	MappedFile file;
+	if(!file.open(fileName)) {
+		return fail(0, file.getError().c_str());
+	}
+	return parse(file.getData(), file.getData() + file.getSize());
+}
+
+bool TextLoader::parse(const char* begin, const char* end)
+{
+	code_.clear();
+	data_.clear();
+	memoryUsed_ = 0;
+	error_.clear();
+	errorLine_ = 0;
+
+	// Команда занимает не меньше 8 байт текста
+	code_.reserve((end - begin) / 8);
+
+	const char* p = begin;
+	for(int line = 1; p < end; ++line) {
+		skipBlanks(p, end);
+
+		// Адрес команды
+		bool hasAddress = false;
+		int address = 0;
+		if(p < end && isDigit(*p)) {
+			const char* error = parseInt(p, end, address);
+			if(error != 0) {
+				return fail(line, error);
+			}
+			if(p == end || *p != ':') {
+				return fail(line, "':' expected after instruction address");
+			}
+			++p;
+			hasAddress = true;
+			skipBlanks(p, end);
+		}
+
+		// Код операции
+		const char* name = p;
+		while(p < end && isMnemonicChar(*p)) {
+			++p;
+		}
+		const Mnemonic* mnemonic = 0;
+		if(p != name) {
+			mnemonic = findMnemonic(name, p - name);
+			if(mnemonic == 0) {
+				return fail(line, "unknown instruction");
+			}
+		}
+		else if(hasAddress) {
+			return fail(line, "instruction expected");
+		}
+
+		// Аргументы
+		int args[2] = { 0, 0 };
+		if(mnemonic != 0) {
+			for(int i = 0; i < mnemonic->args; ++i) {
+				const char* start = p;
+				skipBlanks(p, end);
+				if(p == start) {
+					return fail(line, "instruction argument expected");
+				}
+				const char* error = parseInt(p, end, args[i]);
+				if(error != 0) {
+					return fail(line, error);
+				}
+			}
+		}
+
+		// Конец строки или комментарий
+		skipBlanks(p, end);
+		if(p < end && *p == ';') {
+			while(p < end && *p != '\n') {
+				++p;
+			}
+		}
+		if(p < end) {
+			if(*p != '\n') {
+				return fail(line, "unexpected characters at the end of the line");
+			}
+			++p;
+		}
+
+		if(mnemonic == 0) {
+			continue;	// пустая строка или комментарий
+		}
+
+		if(mnemonic->args == 2) {
+			if((unsigned)args[0] >= (unsigned)memorySize_) {
+				return fail(line, "SET address is out of range");
+			}
+			DataWord word = { args[0], args[1] };
+			data_.push_back(word);
+			continue;
+		}
+
+		if(!hasAddress) {
+			return fail(line, "instruction address expected");
+		}
+		if(address != (int)code_.size()) {
+			char message[64];
+			snprintf(message, sizeof(message), "instruction address %d expected", (int)code_.size());
+			return fail(line, message);
+		}
+		Instruction instruction = mnemonic->instruction;
+		if((instruction == LOAD || instruction == STORE || instruction == BLOAD || instruction == BSTORE)
+			&& args[0] >= memoryUsed_ && args[0] < INT_MAX) {
+			memoryUsed_ = args[0] + 1;
+		}
+		code_.push_back(Command(instruction, args[0]));
+	}
+	return true;
+}
+
+bool TextLoader::isProgramText(const char* fileName)
+{
+	MappedFile file;
+	if(!file.open(fileName)) {
+		return false;
+	}
+
+	const char* p = file.getData();
+	const char* end = p + file.getSize();
+	while(p < end) {
+		skipBlanks(p, end);
+		if(p < end && (*p == '\n' || *p == ';')) {
+			while(p < end && *p != '\n') {
+				++p;
+			}
+			++p;
+			continue;
+		}
+		if(p < end && isDigit(*p)) {
+			while(p < end && isDigit(*p)) {
+				++p;
+			}
+			return p < end && *p == ':';
+		}
+		return end - p >= 3 && p[0] == 'S' && p[1] == 'E' && p[2] == 'T';
+	}
+	return false;
+}
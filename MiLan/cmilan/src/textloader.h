@@ -0,0 +1,93 @@
+#ifndef CMILAN_TEXTLOADER_H
+#define CMILAN_TEXTLOADER_H
+
+#include "codegen.h"
+#include "vm.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Начальное значение ячейки памяти данных (служебная инструкция SET)
+struct DataWord
+{
+	int address;	// адрес в памяти данных
+	int value;	// значение
+};
+
+// Загрузчик программ виртуальной машины Милана в текстовом формате, который
+// печатает компилятор и читает milanvm (см. vm/doc/vm.txt):
+//
+//     12:	LOAD	3	; комментарий
+//     SET	0	15
+//
+// Файл отображается в память и разбирается без потоков ввода-вывода:
+// числа разбираются вручную, коды операций ищутся в таблице с совершенной
+// хеш-функцией. Адреса команд должны идти подряд, начиная с 0.
+// Инструкции SET не попадают в программу, а задают начальное содержимое
+// памяти данных, которое нужно записать после загрузки программы в машину.
+
+class TextLoader
+{
+public:
+	// Конструктор
+	//     int memorySize - размер памяти данных, в которую записывают инструкции SET
+	explicit TextLoader(int memorySize = VirtualMachine::DEFAULT_MEMORY_SIZE)
+		: memorySize_(memorySize), memoryUsed_(0), errorLine_(0)
+	{
+	}
+
+	// Загрузка программы из файла. При ошибке возвращает false, описание
+	// ошибки и номер строки возвращают getError() и getErrorLine().
+	bool load(const char* fileName);
+
+	// Разбор программы из буфера [begin, end)
+	bool parse(const char* begin, const char* end);
+
+	// Похож ли файл на программу в текстовом формате: первая значащая строка
+	// начинается с адреса команды или с SET. Текст программы на Милане так
+	// начинаться не может.
+	static bool isProgramText(const char* fileName);
+
+	// Программа
+	const vector<Command>& getCode() const
+	{
+		return code_;
+	}
+
+	// Начальные значения памяти данных в порядке инструкций SET
+	const vector<DataWord>& getData() const
+	{
+		return data_;
+	}
+
+	// Размер памяти данных, к которой обращаются команды LOAD, STORE, BLOAD
+	// и BSTORE (текстовый формат, в отличие от двоичного, его не хранит)
+	int getMemoryUsed() const
+	{
+		return memoryUsed_;
+	}
+
+	const string& getError() const
+	{
+		return error_;
+	}
+
+	// Номер строки с ошибкой (0, если ошибка не относится к строке)
+	int getErrorLine() const
+	{
+		return errorLine_;
+	}
+
+private:
+	bool fail(int line, const char* message);
+
+	vector<Command> code_;		// программа
+	vector<DataWord> data_;		// инструкции SET
+	int memorySize_;		// размер памяти данных
+	int memoryUsed_;		// наибольший адрес обращения к памяти + 1
+	string error_;			// описание ошибки
+	int errorLine_;			// строка с ошибкой
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "tokens.h"
+#include <thread>
+
+void TokenArray::lex(Scanner& scanner)
+{
+	kinds_.clear();
+	values_.clear();
+	lines_.clear();
+
+	// Оценка числа лексем: в типичной программе лексема вместе с
+	// окружающими пробелами занимает не меньше 4 символов
+	size_t expected = scanner.getRemaining() / 4 + 1;
+	kinds_.reserve(expected);
+	values_.reserve(expected);
+	lines_.reserve(expected);
+	do {
+		scanner.nextToken();
+		kinds_.push_back(scanner.token());
+		values_.push_back(scanner.getValue());
+		lines_.push_back(scanner.getLineNumber());
+	} while(scanner.token() != T_EOF);
+}
+
+// Ожидание другого потока: сначала несколько попыток без передачи
+// управления, затем уступаем процессор
+static void waitForPeer(int& attempts)
+{
+	if(++attempts > 64) {
+		this_thread::yield();
+	}
+}
+
+void TokenRing::produce(Scanner& scanner)
+{
+	size_t head = head_.load(memory_order_relaxed);
+	Record record;
+	do {
+		scanner.nextToken();
+		record.kind = scanner.token();
+		record.value = scanner.getValue();
+		record.line = scanner.getLineNumber();
+
+		int attempts = 0;
+		while(head - cachedTail_ == CAPACITY) {
+			cachedTail_ = tail_.load(memory_order_acquire);
+			if(head - cachedTail_ == CAPACITY) {
+				if(stop_.load(memory_order_relaxed)) {
+					return;
+				}
+				waitForPeer(attempts);
+			}
+		}
+		records_[head & (CAPACITY - 1)] = record;
+		head_.store(++head, memory_order_release);
+	} while(record.kind != T_EOF);
+}
+
+void TokenRing::pop(Token& kind, int& value, int& line)
+{
+	if(!finished_) {
+		size_t tail = tail_.load(memory_order_relaxed);
+		int attempts = 0;
+		while(tail == cachedHead_) {
+			cachedHead_ = head_.load(memory_order_acquire);
+			if(tail == cachedHead_) {
+				waitForPeer(attempts);
+			}
+		}
+		last_ = records_[tail & (CAPACITY - 1)];
+		tail_.store(tail + 1, memory_order_release);
+		finished_ = (last_.kind == T_EOF);
+	}
+	kind = last_.kind;
+	value = last_.value;
+	line = last_.line;
+}
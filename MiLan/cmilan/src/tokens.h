@@ -0,0 +1,117 @@
+#ifndef CMILAN_TOKENS_H
+#define CMILAN_TOKENS_H
+
+#include "scanner.h"
+#include <vector>
+#include <atomic>
+
+using namespace std;
+
+// Последовательность лексем программы, выделенная заранее.
+//
+// Лексемы хранятся в трех параллельных массивах: вид лексемы, значение
+// (см. Scanner::getValue) и номер строки, в которой находился сканер после
+// чтения лексемы (его и сообщает парсер в сообщениях об ошибках). Парсер
+// проходит массивы по индексу, поэтому выделение лексем выполняется отдельным
+// этапом, а заглядывать вперед можно на любое число лексем.
+// Последняя лексема всегда T_EOF.
+
+class TokenArray
+{
+public:
+	TokenArray()
+	{
+	}
+
+	// Чтение всех лексем из scanner до конца текста
+	void lex(Scanner& scanner);
+
+	size_t size() const
+	{
+		return kinds_.size();
+	}
+
+	Token getKind(size_t i) const
+	{
+		return (Token)kinds_[i];
+	}
+
+	int getValue(size_t i) const
+	{
+		return values_[i];
+	}
+
+	int getLine(size_t i) const
+	{
+		return lines_[i];
+	}
+
+private:
+	vector<unsigned char> kinds_;	// виды лексем (Token)
+	vector<int> values_;		// значения лексем
+	vector<int> lines_;		// номера строк
+};
+
+// Кольцевой буфер лексем для сканера, работающего в отдельном потоке.
+//
+// Один поток (производитель) выделяет лексемы методом produce() и помещает
+// их в буфер, другой (парсер) забирает их методом pop(). Буфер без
+// блокировок: каждый индекс изменяет только один поток, а запись лексемы
+// публикуется сохранением индекса с семантикой release. Если буфер полон,
+// сканер ждет, пока парсер освободит место; если пуст - парсер ждет сканер.
+// Номер строки передается вместе с лексемой, поэтому сообщения об ошибках
+// содержат те же номера строк, что и при чтении лексем по запросу.
+
+class TokenRing
+{
+public:
+	static const size_t CAPACITY = 4096;	// число лексем в буфере (степень двойки)
+
+	TokenRing()
+		: head_(0), tail_(0), stop_(false), cachedHead_(0), finished_(false),
+		  cachedTail_(0)
+	{
+	}
+
+	// Чтение лексем из scanner до T_EOF включительно (выполняется в потоке
+	// сканера). Завершается раньше, если вызван stop().
+	void produce(Scanner& scanner);
+
+	// Следующая лексема. После T_EOF возвращается T_EOF.
+	void pop(Token& kind, int& value, int& line);
+
+	// Прекращение работы сканера (если парсер закончил разбор раньше, чем
+	// сканер дошел до конца текста)
+	void stop()
+	{
+		stop_.store(true, memory_order_relaxed);
+	}
+
+private:
+	TokenRing(const TokenRing&);
+	TokenRing& operator=(const TokenRing&);
+
+	struct Record
+	{
+		Token kind;
+		int value;
+		int line;
+	};
+
+	Record records_[CAPACITY];
+
+	// Индексы и данные каждой стороны лежат в разных строках кэша
+	alignas(64) atomic<size_t> head_;	// число записанных лексем (изменяет сканер)
+	alignas(64) atomic<size_t> tail_;	// число прочитанных лексем (изменяет парсер)
+	atomic<bool> stop_;			// парсер больше не читает лексемы
+
+	// Данные парсера
+	alignas(64) size_t cachedHead_;		// последнее прочитанное значение head_
+	bool finished_;				// прочитана лексема T_EOF
+	Record last_;				// лексема T_EOF
+
+	// Данные сканера
+	alignas(64) size_t cachedTail_;		// последнее прочитанное значение tail_
+};
+
+#endif
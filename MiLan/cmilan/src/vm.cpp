@@ -0,0 +1,672 @@
+#include "vm.h"
+#include <algorithm>
+
+static const char * vmStatusNames_[] = {
+	"ok",
+	"jump outside of the program",
+	"division by zero",
+	"memory address out of range",
+	"stack overflow",
+	"stack underflow",
+	"input error",
+	"illegal instruction"
+};
+
+// Арифметика по модулю 2^32: переполнение знаковых целых в C++ не определено,
+// поэтому вычисления выполняются над беззнаковыми словами.
+
+static inline int wrapAdd(int a, int b)
+{
+	return (int)((unsigned)a + (unsigned)b);
+}
+
+static inline int wrapSub(int a, int b)
+{
+	return (int)((unsigned)a - (unsigned)b);
+}
+
+static inline int wrapMult(int a, int b)
+{
+	return (int)((unsigned)a * (unsigned)b);
+}
+
+// Частное INT_MIN / -1 не представимо, результат по модулю 2^32 равен INT_MIN.
+static inline int wrapDiv(int a, int b)
+{
+	return (b == -1) ? wrapSub(0, a) : a / b;
+}
+
+// Исполнение с косвенными переходами по адресам меток (computed goto) доступно
+// в GCC и совместимых компиляторах. Иначе используется переносимый вариант с switch.
+#if defined(__GNUC__) && !defined(CMILAN_NO_THREADED_CODE)
+#define CMILAN_THREADED_CODE
+#endif
+
+// Декодирование инструкции программы из count инструкций во внутреннее представление
+void VirtualMachine::decode(VmOp& op, Instruction instruction, int arg, int count) const
+{
+	const int memorySize = memory_.size();
+	op.handler = 0;
+	op.arg = arg;
+	op.arg2 = 0;
+	op.arg3 = 0;
+
+	switch(instruction) {
+		case NOP:	op.opcode = OP_NOP; break;
+		case STOP:	op.opcode = OP_STOP; break;
+		case BLOAD:	op.opcode = OP_BLOAD; break;
+		case BSTORE:	op.opcode = OP_BSTORE; break;
+		case PUSH:	op.opcode = OP_PUSH; break;
+		case POP:	op.opcode = OP_POP; break;
+		case DUP:	op.opcode = OP_DUP; break;
+		case ADD:	op.opcode = OP_ADD; break;
+		case SUB:	op.opcode = OP_SUB; break;
+		case MULT:	op.opcode = OP_MULT; break;
+		case DIV:	op.opcode = OP_DIV; break;
+		case INVERT:	op.opcode = OP_INVERT; break;
+		case INPUT:	op.opcode = OP_INPUT; break;
+		case PRINT:	op.opcode = OP_PRINT; break;
+
+		case LOAD:
+			op.opcode = ((unsigned)arg < (unsigned)memorySize) ? OP_LOAD : OP_BAD_LOAD;
+			break;
+
+		case STORE:
+			op.opcode = ((unsigned)arg < (unsigned)memorySize) ? OP_STORE : OP_BAD_STORE;
+			break;
+
+		case COMPARE:
+			if(arg >= 0 && arg <= 5) {
+				op.opcode = OP_CMP_EQ + arg;
+			}
+			else {
+				op.opcode = OP_BAD_COMPARE;
+			}
+			break;
+
+		case JUMP:
+		case JUMP_YES:
+		case JUMP_NO: {
+			bool valid = (unsigned)arg < (unsigned)count;
+			if(instruction == JUMP) {
+				op.opcode = valid ? OP_JUMP : OP_ABORT;
+			}
+			else if(instruction == JUMP_YES) {
+				op.opcode = valid ? OP_JUMP_YES : OP_ABORT_YES;
+			}
+			else {
+				op.opcode = valid ? OP_JUMP_NO : OP_ABORT_NO;
+			}
+			break;
+		}
+
+		default:
+			op.opcode = OP_BAD_INSTRUCTION;
+			break;
+	}
+}
+
+void VirtualMachine::load(const vector<Command>& program)
+{
+	const int count = program.size();
+	code_.resize(count + 1);
+	for(int address = 0; address < count; ++address) {
+		decode(code_[address], program[address].getInstruction(), program[address].getArg(), count);
+	}
+	finishLoad(0);
+}
+
+void VirtualMachine::load(const BytecodeFile& image)
+{
+	const int count = image.getCount();
+	const BytecodeRecord* records = image.getRecords();
+	code_.resize(count + 1);
+	for(int address = 0; address < count; ++address) {
+		decode(code_[address], (Instruction)records[address].opcode, records[address].arg, count);
+	}
+	finishLoad(image.getEntry());
+}
+
+// Завершение загрузки программы: операция OP_END, суперинструкции, обнуление памяти
+void VirtualMachine::finishLoad(int entry)
+{
+	const int count = code_.size() - 1;
+	entry_ = entry;
+	code_[count].handler = 0;
+	code_[count].opcode = OP_END;
+	code_[count].arg = 0;
+	code_[count].arg2 = 0;
+	code_[count].arg3 = 0;
+	fuse();
+	threaded_ = false;
+
+	fill(memory_.begin(), memory_.end(), 0);
+	address_ = entry;
+}
+
+// Код сравнения, противоположного cmp (для замены JUMP_NO на переход по истине)
+static int negateCompare(int cmp)
+{
+	static const int negated[] = { 1, 0, 5, 4, 3, 2 };
+	return negated[cmp];
+}
+
+// Нет ли переходов на адреса (address, address + length), кроме переходов
+// из самой последовательности (проверка индекса переходит внутрь себя)
+bool VirtualMachine::isClosedRegion(const VmOp* code, const vector<int>& targets,
+	int address, int length)
+{
+	for(int i = 1; i < length; ++i) {
+		int internal = 0;
+		for(int j = 0; j < length; ++j) {
+			int opcode = code[address + j].opcode;
+			if((opcode == OP_JUMP || opcode == OP_JUMP_YES || opcode == OP_JUMP_NO)
+				&& code[address + j].arg == address + i) {
+				++internal;
+			}
+		}
+		if(targets[address + i] != internal) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void VirtualMachine::fuse()
+{
+	const int count = code_.size() - 1;
+	VmOp* code = &code_[0];
+
+	// Число переходов на каждый адрес. Последовательность можно заменить
+	// суперинструкцией, только если внутрь нее не ведет ни один переход извне.
+	vector<int> targets(count + 1, 0);
+	for(int address = 0; address < count; ++address) {
+		int opcode = code[address].opcode;
+		if(opcode == OP_JUMP || opcode == OP_JUMP_YES || opcode == OP_JUMP_NO) {
+			++targets[code[address].arg];
+		}
+	}
+	++targets[entry_];
+
+	int address = 0;
+	while(address < count) {
+		VmOp* op = code + address;
+		int left = count - address;
+		int length = 1;
+
+		// DUP; DUP; LOAD size | PUSH size; COMPARE 2; JUMP_YES +6; JUMP -1;
+		// PUSH 0; COMPARE 5; JUMP_YES +10; JUMP -1 [; BLOAD base]
+		if(left >= 10
+			&& op[0].opcode == OP_DUP && op[1].opcode == OP_DUP
+			&& (op[2].opcode == OP_LOAD || op[2].opcode == OP_PUSH) && op[3].opcode == OP_CMP_LT
+			&& op[4].opcode == OP_JUMP_YES && op[4].arg == address + 6
+			&& op[5].opcode == OP_ABORT
+			&& op[6].opcode == OP_PUSH && op[6].arg == 0 && op[7].opcode == OP_CMP_GE
+			&& op[8].opcode == OP_JUMP_YES && op[8].arg == address + 10
+			&& op[9].opcode == OP_ABORT) {
+			if(left >= 11 && op[10].opcode == OP_BLOAD
+				&& isClosedRegion(code, targets, address, 11)) {
+				op->opcode = (op[2].opcode == OP_LOAD) ? OP_CHECK_BLOAD : OP_CHECK_BLOAD_CONST;
+				op->arg = op[2].arg;
+				op->arg2 = op[10].arg;
+				length = 11;
+			}
+			else if(isClosedRegion(code, targets, address, 10)) {
+				op->opcode = (op[2].opcode == OP_LOAD) ? OP_CHECK_INDEX : OP_CHECK_INDEX_CONST;
+				op->arg = op[2].arg;
+				length = 10;
+			}
+		}
+
+		if(length == 1 && left >= 4
+			&& op[0].opcode == OP_LOAD
+			&& (op[1].opcode == OP_LOAD || op[1].opcode == OP_PUSH)
+			&& op[2].opcode >= OP_CMP_EQ && op[2].opcode <= OP_CMP_GE
+			&& (op[3].opcode == OP_JUMP_YES || op[3].opcode == OP_JUMP_NO)
+			&& isClosedRegion(code, targets, address, 4)) {
+			int cmp = op[2].opcode - OP_CMP_EQ;
+			if(op[3].opcode == OP_JUMP_NO) {
+				cmp = negateCompare(cmp);
+			}
+			op->opcode = ((op[1].opcode == OP_LOAD) ? OP_LL_JUMP_EQ : OP_LP_JUMP_EQ) + cmp;
+			op->arg2 = op[1].arg;
+			op->arg3 = op[3].arg;
+			length = 4;
+		}
+
+		if(length == 1 && left >= 4
+			&& op[0].opcode == OP_LOAD && op[1].opcode == OP_PUSH
+			&& (op[2].opcode == OP_ADD || op[2].opcode == OP_SUB)
+			&& op[3].opcode == OP_STORE && op[3].arg == op[0].arg
+			&& isClosedRegion(code, targets, address, 4)) {
+			op->opcode = OP_INC;
+			op->arg2 = (op[2].opcode == OP_ADD) ? op[1].arg : wrapSub(0, op[1].arg);
+			length = 4;
+		}
+
+		if(length == 1 && left >= 3 && op[0].opcode == OP_LOAD
+			&& (op[1].opcode == OP_LOAD || op[1].opcode == OP_PUSH)
+			&& isClosedRegion(code, targets, address, 3)) {
+			int arith = op[2].opcode;
+			if(op[1].opcode == OP_LOAD && (arith == OP_ADD || arith == OP_SUB || arith == OP_MULT)) {
+				op->opcode = (arith == OP_ADD) ? OP_LL_ADD : (arith == OP_SUB) ? OP_LL_SUB : OP_LL_MULT;
+				op->arg2 = op[1].arg;
+				length = 3;
+			}
+			else if(op[1].opcode == OP_PUSH && (arith == OP_ADD || arith == OP_SUB || arith == OP_MULT)) {
+				op->opcode = (arith == OP_MULT) ? OP_LP_MULT : OP_LP_ADD;
+				op->arg2 = (arith == OP_SUB) ? wrapSub(0, op[1].arg) : op[1].arg;
+				length = 3;
+			}
+		}
+
+		if(length == 1 && left >= 2 && isClosedRegion(code, targets, address, 2)) {
+			if(op[0].opcode >= OP_CMP_EQ && op[0].opcode <= OP_CMP_GE
+				&& (op[1].opcode == OP_JUMP_YES || op[1].opcode == OP_JUMP_NO)) {
+				int cmp = op[0].opcode - OP_CMP_EQ;
+				if(op[1].opcode == OP_JUMP_NO) {
+					cmp = negateCompare(cmp);
+				}
+				op->opcode = OP_CMP_JUMP_EQ + cmp;
+				op->arg = op[1].arg;
+				length = 2;
+			}
+			else if(op[0].opcode == OP_PUSH && op[1].opcode == OP_STORE) {
+				op->opcode = OP_SET;
+				op->arg2 = op[1].arg;
+				length = 2;
+			}
+			else if(op[0].opcode == OP_LOAD && op[1].opcode == OP_STORE) {
+				op->opcode = OP_COPY;
+				op->arg2 = op[1].arg;
+				length = 2;
+			}
+		}
+
+		address += length;
+	}
+}
+
+int VirtualMachine::getFusedLength(int address) const
+{
+	int opcode = code_[address].opcode;
+	if(opcode == OP_SET || opcode == OP_COPY
+		|| (opcode >= OP_CMP_JUMP_EQ && opcode <= OP_CMP_JUMP_GE)) {
+		return 2;
+	}
+	if(opcode >= OP_LL_ADD && opcode <= OP_LP_MULT) {
+		return 3;
+	}
+	if(opcode == OP_INC || (opcode >= OP_LL_JUMP_EQ && opcode <= OP_LP_JUMP_GE)) {
+		return 4;
+	}
+	if(opcode == OP_CHECK_INDEX || opcode == OP_CHECK_INDEX_CONST) {
+		return 10;
+	}
+	if(opcode == OP_CHECK_BLOAD || opcode == OP_CHECK_BLOAD_CONST) {
+		return 11;
+	}
+	return 1;
+}
+
+VmStatus VirtualMachine::run()
+{
+#ifdef CMILAN_THREADED_CODE
+	// Порядок меток совпадает с порядком VmOpcode
+	static const void* const handlers[OP_COUNT] = {
+		&&L_OP_NOP, &&L_OP_STOP, &&L_OP_LOAD, &&L_OP_STORE, &&L_OP_BLOAD,
+		&&L_OP_BSTORE, &&L_OP_PUSH, &&L_OP_POP, &&L_OP_DUP, &&L_OP_ADD,
+		&&L_OP_SUB, &&L_OP_MULT, &&L_OP_DIV, &&L_OP_INVERT,
+		&&L_OP_CMP_EQ, &&L_OP_CMP_NE, &&L_OP_CMP_LT, &&L_OP_CMP_GT,
+		&&L_OP_CMP_LE, &&L_OP_CMP_GE,
+		&&L_OP_JUMP, &&L_OP_JUMP_YES, &&L_OP_JUMP_NO, &&L_OP_INPUT, &&L_OP_PRINT,
+		&&L_OP_ABORT, &&L_OP_ABORT_YES, &&L_OP_ABORT_NO,
+		&&L_OP_BAD_LOAD, &&L_OP_BAD_STORE, &&L_OP_BAD_COMPARE, &&L_OP_BAD_INSTRUCTION, &&L_OP_END,
+		&&L_OP_INC, &&L_OP_SET, &&L_OP_COPY,
+		&&L_OP_LL_ADD, &&L_OP_LL_SUB, &&L_OP_LL_MULT, &&L_OP_LP_ADD, &&L_OP_LP_MULT,
+		&&L_OP_CMP_JUMP_EQ, &&L_OP_CMP_JUMP_NE, &&L_OP_CMP_JUMP_LT,
+		&&L_OP_CMP_JUMP_GT, &&L_OP_CMP_JUMP_LE, &&L_OP_CMP_JUMP_GE,
+		&&L_OP_LL_JUMP_EQ, &&L_OP_LL_JUMP_NE, &&L_OP_LL_JUMP_LT,
+		&&L_OP_LL_JUMP_GT, &&L_OP_LL_JUMP_LE, &&L_OP_LL_JUMP_GE,
+		&&L_OP_LP_JUMP_EQ, &&L_OP_LP_JUMP_NE, &&L_OP_LP_JUMP_LT,
+		&&L_OP_LP_JUMP_GT, &&L_OP_LP_JUMP_LE, &&L_OP_LP_JUMP_GE,
+		&&L_OP_CHECK_INDEX, &&L_OP_CHECK_BLOAD,
+		&&L_OP_CHECK_INDEX_CONST, &&L_OP_CHECK_BLOAD_CONST
+	};
+
+	if(!threaded_) {
+		for(size_t i = 0; i < code_.size(); ++i) {
+			code_[i].handler = handlers[code_[i].opcode];
+		}
+		threaded_ = true;
+	}
+#endif
+
+	const VmOp* const code = &code_[0];
+	const VmOp* ip = code + entry_;	// текущая инструкция
+	const unsigned memorySize = memory_.size();
+	int* const memory = &memory_[0];
+	int* const stackBase = &stack_[0];
+	int* const stackLimit = stackBase + stack_.size();
+	int* sp = stackBase;		// первое свободное слово стека
+	VmStatus status = VM_OK;
+
+// Обработчик операции op, переход к следующей инструкции и переход по адресу
+#ifdef CMILAN_THREADED_CODE
+#define CASE(op)	L_##op:
+#define NEXT()		do { ++ip; goto *ip->handler; } while(0)
+#define SKIP(n)		do { ip += (n); goto *ip->handler; } while(0)
+#define JUMP_TO(a)	do { ip = code + (a); goto *ip->handler; } while(0)
+#else
+#define CASE(op)	case op:
+#define NEXT()		{ ++ip; continue; }
+#define SKIP(n)		{ ip += (n); continue; }
+#define JUMP_TO(a)	{ ip = code + (a); continue; }
+#endif
+
+// Проверки стека перед выталкиванием n слов и заталкиванием n слов
+#define NEED(n)		if(sp - stackBase < (n)) { status = VM_STACK_UNDERFLOW; goto done; }
+#define ROOM(n)		if(stackLimit - sp < (n)) { status = VM_STACK_OVERFLOW; goto done; }
+#define FAIL(s)		{ status = (s); goto done; }
+
+// Проверка стека для суперинструкции, которая начинается с n команд,
+// заталкивающих по одному слову. Ошибка сообщается с адресом той команды
+// исходной последовательности, на которой переполнился бы стек.
+#define ROOM_AT(n)	if(stackLimit - sp < (n)) { ip += stackLimit - sp; FAIL(VM_STACK_OVERFLOW); }
+
+// Сравнение двух слов на вершине стека
+#define COMPARE_OP(op, cmp)	CASE(op) NEED(2); --sp; sp[-1] = (sp[-1] cmp sp[0]) ? 1 : 0; NEXT();
+
+// Суперинструкции сравнения с переходом
+#define CMP_JUMP_OP(op, cmp)	CASE(op) NEED(2); sp -= 2; \
+	if(sp[0] cmp sp[1]) { JUMP_TO(ip->arg); } SKIP(2);
+#define LL_JUMP_OP(op, cmp)	CASE(op) ROOM_AT(2); \
+	if(memory[ip->arg] cmp memory[ip->arg2]) { JUMP_TO(ip->arg3); } SKIP(4);
+#define LP_JUMP_OP(op, cmp)	CASE(op) ROOM_AT(2); \
+	if(memory[ip->arg] cmp ip->arg2) { JUMP_TO(ip->arg3); } SKIP(4);
+
+// Проверка индекса массива с размером size
+#define CHECK_OP(op, size)	CASE(op) NEED(1); ROOM_AT(3); \
+	if(!(sp[-1] < (size))) { ip += 5; FAIL(VM_ABORT); } \
+	if(!(sp[-1] >= 0)) { ip += 9; FAIL(VM_ABORT); }
+#define CHECK_INDEX_OP(op, size)	CHECK_OP(op, size) SKIP(10);
+#define CHECK_BLOAD_OP(op, size)	CHECK_OP(op, size) { \
+	unsigned address = (unsigned)wrapAdd(ip->arg2, sp[-1]); \
+	if(address >= memorySize) { ip += 10; FAIL(VM_BAD_ADDRESS); } \
+	sp[-1] = memory[address]; } SKIP(11);
+
+#ifdef CMILAN_THREADED_CODE
+	goto *ip->handler;
+	{
+#else
+	for(;;) {
+		switch(ip->opcode) {
+#endif
+		CASE(OP_NOP)
+			NEXT();
+
+		CASE(OP_STOP)
+			goto done;
+
+		CASE(OP_LOAD)
+			ROOM(1);
+			*sp++ = memory[ip->arg];
+			NEXT();
+
+		CASE(OP_STORE)
+			NEED(1);
+			memory[ip->arg] = *--sp;
+			NEXT();
+
+		CASE(OP_BLOAD) {
+			NEED(1);
+			unsigned address = (unsigned)wrapAdd(ip->arg, sp[-1]);
+			if(address >= memorySize) {
+				FAIL(VM_BAD_ADDRESS);
+			}
+			sp[-1] = memory[address];
+			NEXT();
+		}
+
+		CASE(OP_BSTORE) {
+			NEED(2);
+			unsigned address = (unsigned)wrapAdd(ip->arg, sp[-1]);
+			if(address >= memorySize) {
+				FAIL(VM_BAD_ADDRESS);
+			}
+			memory[address] = sp[-2];
+			sp -= 2;
+			NEXT();
+		}
+
+		CASE(OP_PUSH)
+			ROOM(1);
+			*sp++ = ip->arg;
+			NEXT();
+
+		CASE(OP_POP)
+			NEED(1);
+			--sp;
+			NEXT();
+
+		CASE(OP_DUP)
+			NEED(1);
+			ROOM(1);
+			sp[0] = sp[-1];
+			++sp;
+			NEXT();
+
+		CASE(OP_ADD)
+			NEED(2);
+			--sp;
+			sp[-1] = wrapAdd(sp[-1], sp[0]);
+			NEXT();
+
+		CASE(OP_SUB)
+			NEED(2);
+			--sp;
+			sp[-1] = wrapSub(sp[-1], sp[0]);
+			NEXT();
+
+		CASE(OP_MULT)
+			NEED(2);
+			--sp;
+			sp[-1] = wrapMult(sp[-1], sp[0]);
+			NEXT();
+
+		CASE(OP_DIV)
+			NEED(2);
+			if(sp[-1] == 0) {
+				FAIL(VM_DIVISION_BY_ZERO);
+			}
+			--sp;
+			sp[-1] = wrapDiv(sp[-1], sp[0]);
+			NEXT();
+
+		CASE(OP_INVERT)
+			NEED(1);
+			sp[-1] = wrapSub(0, sp[-1]);
+			NEXT();
+
+		COMPARE_OP(OP_CMP_EQ, ==)
+		COMPARE_OP(OP_CMP_NE, !=)
+		COMPARE_OP(OP_CMP_LT, <)
+		COMPARE_OP(OP_CMP_GT, >)
+		COMPARE_OP(OP_CMP_LE, <=)
+		COMPARE_OP(OP_CMP_GE, >=)
+
+		CASE(OP_JUMP)
+			JUMP_TO(ip->arg);
+
+		CASE(OP_JUMP_YES)
+			NEED(1);
+			if(*--sp != 0) {
+				JUMP_TO(ip->arg);
+			}
+			NEXT();
+
+		CASE(OP_JUMP_NO)
+			NEED(1);
+			if(*--sp == 0) {
+				JUMP_TO(ip->arg);
+			}
+			NEXT();
+
+		CASE(OP_INPUT) {
+			ROOM(1);
+			int value;
+			if(!(input_ >> value)) {
+				FAIL(VM_INPUT_ERROR);
+			}
+			*sp++ = value;
+			NEXT();
+		}
+
+		CASE(OP_PRINT)
+			NEED(1);
+			output_ << *--sp << '\n';
+			NEXT();
+
+		CASE(OP_ABORT)
+			FAIL(VM_ABORT);
+
+		CASE(OP_ABORT_YES)
+			NEED(1);
+			if(*--sp != 0) {
+				FAIL(VM_ABORT);
+			}
+			NEXT();
+
+		CASE(OP_ABORT_NO)
+			NEED(1);
+			if(*--sp == 0) {
+				FAIL(VM_ABORT);
+			}
+			NEXT();
+
+		// Ошибки, найденные при загрузке, сообщаются после проверок стека,
+		// которые выполнила бы исходная инструкция
+		CASE(OP_BAD_LOAD)
+			ROOM(1);
+			FAIL(VM_BAD_ADDRESS);
+
+		CASE(OP_BAD_STORE)
+			NEED(1);
+			FAIL(VM_BAD_ADDRESS);
+
+		CASE(OP_BAD_COMPARE)
+			NEED(2);
+			FAIL(VM_BAD_INSTRUCTION);
+
+		CASE(OP_BAD_INSTRUCTION)
+			FAIL(VM_BAD_INSTRUCTION);
+
+		// Выполнение дошло до конца программы без STOP: ошибка относится
+		// к последней инструкции
+		CASE(OP_END)
+			if(ip != code) {
+				--ip;
+			}
+			FAIL(VM_ABORT);
+
+		CASE(OP_INC)
+			ROOM_AT(2);
+			memory[ip->arg] = wrapAdd(memory[ip->arg], ip->arg2);
+			SKIP(4);
+
+		CASE(OP_SET)
+			ROOM_AT(1);
+			memory[ip->arg2] = ip->arg;
+			SKIP(2);
+
+		CASE(OP_COPY)
+			ROOM_AT(1);
+			memory[ip->arg2] = memory[ip->arg];
+			SKIP(2);
+
+		CASE(OP_LL_ADD)
+			ROOM_AT(2);
+			*sp++ = wrapAdd(memory[ip->arg], memory[ip->arg2]);
+			SKIP(3);
+
+		CASE(OP_LL_SUB)
+			ROOM_AT(2);
+			*sp++ = wrapSub(memory[ip->arg], memory[ip->arg2]);
+			SKIP(3);
+
+		CASE(OP_LL_MULT)
+			ROOM_AT(2);
+			*sp++ = wrapMult(memory[ip->arg], memory[ip->arg2]);
+			SKIP(3);
+
+		CASE(OP_LP_ADD)
+			ROOM_AT(2);
+			*sp++ = wrapAdd(memory[ip->arg], ip->arg2);
+			SKIP(3);
+
+		CASE(OP_LP_MULT)
+			ROOM_AT(2);
+			*sp++ = wrapMult(memory[ip->arg], ip->arg2);
+			SKIP(3);
+
+		CMP_JUMP_OP(OP_CMP_JUMP_EQ, ==)
+		CMP_JUMP_OP(OP_CMP_JUMP_NE, !=)
+		CMP_JUMP_OP(OP_CMP_JUMP_LT, <)
+		CMP_JUMP_OP(OP_CMP_JUMP_GT, >)
+		CMP_JUMP_OP(OP_CMP_JUMP_LE, <=)
+		CMP_JUMP_OP(OP_CMP_JUMP_GE, >=)
+
+		LL_JUMP_OP(OP_LL_JUMP_EQ, ==)
+		LL_JUMP_OP(OP_LL_JUMP_NE, !=)
+		LL_JUMP_OP(OP_LL_JUMP_LT, <)
+		LL_JUMP_OP(OP_LL_JUMP_GT, >)
+		LL_JUMP_OP(OP_LL_JUMP_LE, <=)
+		LL_JUMP_OP(OP_LL_JUMP_GE, >=)
+
+		LP_JUMP_OP(OP_LP_JUMP_EQ, ==)
+		LP_JUMP_OP(OP_LP_JUMP_NE, !=)
+		LP_JUMP_OP(OP_LP_JUMP_LT, <)
+		LP_JUMP_OP(OP_LP_JUMP_GT, >)
+		LP_JUMP_OP(OP_LP_JUMP_LE, <=)
+		LP_JUMP_OP(OP_LP_JUMP_GE, >=)
+
+		// Индекс на вершине стека остается в стеке. Ошибки сообщаются
+		// с адресами соответствующих команд JUMP -1 исходной последовательности.
+		CHECK_INDEX_OP(OP_CHECK_INDEX, memory[ip->arg])
+		CHECK_INDEX_OP(OP_CHECK_INDEX_CONST, ip->arg)
+		CHECK_BLOAD_OP(OP_CHECK_BLOAD, memory[ip->arg])
+		CHECK_BLOAD_OP(OP_CHECK_BLOAD_CONST, ip->arg)
+
+#ifndef CMILAN_THREADED_CODE
+		default:
+			FAIL(VM_BAD_INSTRUCTION);
+		}
+#endif
+	}
+
+#undef CASE
+#undef NEXT
+#undef SKIP
+#undef JUMP_TO
+#undef NEED
+#undef ROOM
+#undef FAIL
+#undef ROOM_AT
+#undef COMPARE_OP
+#undef CMP_JUMP_OP
+#undef LL_JUMP_OP
+#undef LP_JUMP_OP
+#undef CHECK_OP
+#undef CHECK_INDEX_OP
+#undef CHECK_BLOAD_OP
+
+done:
+	address_ = ip - code;
+	output_.flush();
+	return status;
+}
+
+const char * vmStatusToString(VmStatus s)
+{
+	return vmStatusNames_[s];
+}
@@ -0,0 +1,197 @@
+#ifndef CMILAN_VM_H
+#define CMILAN_VM_H
+
+#include "codegen.h"
+#include "bytecode.h"
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Результат работы виртуальной машины
+
+enum VmStatus
+{
+	VM_OK,			// программа завершилась командой STOP
+	VM_ABORT,		// переход за пределы программы (в том числе JUMP -1)
+	VM_DIVISION_BY_ZERO,	// деление на ноль
+	VM_BAD_ADDRESS,		// обращение за пределы памяти данных
+	VM_STACK_OVERFLOW,	// переполнение стека
+	VM_STACK_UNDERFLOW,	// выталкивание из пустого стека
+	VM_INPUT_ERROR,		// ошибка чтения числа командой INPUT
+	VM_BAD_INSTRUCTION	// недопустимая инструкция или код сравнения
+};
+
+// Функция vmStatusToString возвращает описание результата работы машины.
+// Используется при печати сообщения об ошибке времени исполнения.
+const char * vmStatusToString(VmStatus s);
+
+// Виртуальная машина Милана.
+//
+// Исполняет программу, сформированную кодогенератором, непосредственно в памяти,
+// без печати и повторного разбора текста. Семантика команд соответствует
+// описанию в vm/doc/vm.txt: память данных инициализируется нулями, переход
+// по адресу за пределами программы (JUMP -1) прекращает работу с ошибкой.
+// Арифметика выполняется над 32-битными словами с переполнением по модулю 2^32.
+
+class VirtualMachine
+{
+public:
+	static const int DEFAULT_MEMORY_SIZE = 65536;	// размер памяти данных в словах
+	static const int DEFAULT_STACK_SIZE = 65536;	// размер стека в словах
+
+	// Конструктор
+	//     istream& input - поток, из которого читает команда INPUT
+	//     ostream& output - поток, в который печатает команда PRINT
+	VirtualMachine(istream& input, ostream& output,
+		int memorySize = DEFAULT_MEMORY_SIZE, int stackSize = DEFAULT_STACK_SIZE)
+		: input_(input), output_(output), memory_(memorySize, 0), stack_(stackSize),
+		  threaded_(false), entry_(0), address_(0)
+	{
+	}
+
+	// Загрузка программы. Память данных при этом обнуляется.
+	// Программа предварительно декодируется во внутреннее представление (см. VmOp).
+	void load(const vector<Command>& program);
+
+	// Загрузка программы из двоичного файла (см. BytecodeFile) без
+	// промежуточного преобразования в Command
+	void load(const BytecodeFile& image);
+
+	// Исполнение загруженной программы с точки входа (для Command - с адреса 0)
+	VmStatus run();
+
+	// Адрес последней исполненной инструкции (для сообщений об ошибках)
+	int getAddress() const
+	{
+		return address_;
+	}
+
+	// Число команд загруженной программы, которые исполняет операция по адресу
+	// address: больше 1, если с него начинается суперинструкция
+	int getFusedLength(int address) const;
+
+	// Чтение и запись ячейки памяти данных
+	int getMemory(int address) const
+	{
+		return memory_[address];
+	}
+
+	void setMemory(int address, int value)
+	{
+		memory_[address] = value;
+	}
+
+	int getMemorySize() const
+	{
+		return memory_.size();
+	}
+
+private:
+	// Внутренние коды операций. В отличие от Instruction, проверки, которые
+	// можно выполнить при загрузке (адреса LOAD/STORE, цели переходов, коды
+	// сравнения), уже выполнены, а их результат закодирован в самой операции.
+	enum VmOpcode
+	{
+		OP_NOP,
+		OP_STOP,
+		OP_LOAD,
+		OP_STORE,
+		OP_BLOAD,
+		OP_BSTORE,
+		OP_PUSH,
+		OP_POP,
+		OP_DUP,
+		OP_ADD,
+		OP_SUB,
+		OP_MULT,
+		OP_DIV,
+		OP_INVERT,
+		OP_CMP_EQ,		// COMPARE 0
+		OP_CMP_NE,		// COMPARE 1
+		OP_CMP_LT,		// COMPARE 2
+		OP_CMP_GT,		// COMPARE 3
+		OP_CMP_LE,		// COMPARE 4
+		OP_CMP_GE,		// COMPARE 5
+		OP_JUMP,
+		OP_JUMP_YES,
+		OP_JUMP_NO,
+		OP_INPUT,
+		OP_PRINT,
+		OP_ABORT,		// JUMP за пределы программы (JUMP -1)
+		OP_ABORT_YES,		// JUMP_YES за пределы программы
+		OP_ABORT_NO,		// JUMP_NO за пределы программы
+		OP_BAD_LOAD,		// LOAD за пределами памяти данных
+		OP_BAD_STORE,		// STORE за пределами памяти данных
+		OP_BAD_COMPARE,		// COMPARE с недопустимым кодом
+		OP_BAD_INSTRUCTION,	// недопустимая инструкция
+		OP_END,			// выход за конец программы
+
+		// Суперинструкции, которыми при загрузке заменяются частые
+		// последовательности команд (см. VirtualMachine::fuse). Суперинструкция
+		// занимает адрес первой команды последовательности, остальные команды
+		// остаются на своих местах, но не исполняются.
+		OP_INC,			// LOAD x; PUSH c; ADD|SUB; STORE x
+		OP_SET,			// PUSH c; STORE x
+		OP_COPY,		// LOAD x; STORE y
+		OP_LL_ADD,		// LOAD x; LOAD y; ADD
+		OP_LL_SUB,		// LOAD x; LOAD y; SUB
+		OP_LL_MULT,		// LOAD x; LOAD y; MULT
+		OP_LP_ADD,		// LOAD x; PUSH c; ADD|SUB
+		OP_LP_MULT,		// LOAD x; PUSH c; MULT
+		OP_CMP_JUMP_EQ,		// COMPARE cmp; JUMP_YES|JUMP_NO addr
+		OP_CMP_JUMP_NE,
+		OP_CMP_JUMP_LT,
+		OP_CMP_JUMP_GT,
+		OP_CMP_JUMP_LE,
+		OP_CMP_JUMP_GE,
+		OP_LL_JUMP_EQ,		// LOAD x; LOAD y; COMPARE cmp; JUMP_YES|JUMP_NO addr
+		OP_LL_JUMP_NE,
+		OP_LL_JUMP_LT,
+		OP_LL_JUMP_GT,
+		OP_LL_JUMP_LE,
+		OP_LL_JUMP_GE,
+		OP_LP_JUMP_EQ,		// LOAD x; PUSH c; COMPARE cmp; JUMP_YES|JUMP_NO addr
+		OP_LP_JUMP_NE,
+		OP_LP_JUMP_LT,
+		OP_LP_JUMP_GT,
+		OP_LP_JUMP_LE,
+		OP_LP_JUMP_GE,
+		OP_CHECK_INDEX,		// проверка индекса массива из Parser::statement (10 команд)
+		OP_CHECK_BLOAD,		// проверка индекса и BLOAD из Parser::factor (11 команд)
+		OP_CHECK_INDEX_CONST,	// то же с PUSH size вместо LOAD size (cmilan -O)
+		OP_CHECK_BLOAD_CONST,
+		OP_COUNT
+	};
+
+	// Декодированная инструкция. При исполнении с косвенными переходами
+	// (GCC, "computed goto") handler содержит адрес обработчика операции,
+	// который заполняется при первом запуске run().
+	struct VmOp
+	{
+		const void* handler;	// адрес обработчика
+		int opcode;		// внутренний код операции
+		int arg;		// аргумент (для переходов - адрес цели)
+		int arg2;		// второй и третий аргументы суперинструкций
+		int arg3;
+	};
+
+	void decode(VmOp& op, Instruction instruction, int arg, int count) const;
+	void finishLoad(int entry);
+
+	// Замена частых последовательностей команд в code_ суперинструкциями
+	void fuse();
+	static bool isClosedRegion(const VmOp* code, const vector<int>& targets,
+		int address, int length);
+
+	istream& input_;		// входной поток команды INPUT
+	ostream& output_;		// выходной поток команды PRINT
+	vector<VmOp> code_;		// декодированная программа с завершающей операцией OP_END
+	vector<int> memory_;		// память данных
+	vector<int> stack_;		// стек
+	bool threaded_;			// заполнены ли адреса обработчиков в code_
+	int entry_;			// адрес первой исполняемой инструкции
+	int address_;			// адрес последней исполненной инструкции
+};
+
+#endif
@@ -0,0 +1,192 @@
+#!/bin/sh
+# Регрессионные тесты компилятора (make check в каталоге src).
+#
+#     sh check.sh путь_к_cmilan путь_к_serverclient
+#
+# Каждая программа NAME.mil из каталога test исполняется во всех режимах
+# компилятора; ее вывод вместе с сообщениями об ошибках сравнивается
+# с файлом NAME.out. Ввод программы берется из файла NAME.in, если он есть.
+# Программы запускаются из своего каталога, поэтому имена файлов в сообщениях
+# не зависят от того, откуда запущены тесты. Для режима --serve на время
+# тестов запускается сервер компиляции, программы отправляет ему serverclient.
+
+cmilan=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+client=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+tests=$(cd "$(dirname "$0")" && pwd)
+tmp=$(mktemp -d) || exit 1
+server=
+trap 'if [ -n "$server" ]; then kill $server; fi; rm -rf "$tmp"' EXIT
+failed=0
+
+# Исполнение команды с вводом теста $test и сравнение ее вывода с ожидаемым.
+# Завершение по сигналу считается ошибкой, даже если вывод совпал.
+check()
+{
+	mode=$1
+	shift
+	"$@" < "$input" > "$tmp/output" 2>&1
+	status=$?
+	if [ $status -ge 128 ] || ! cmp -s "$tmp/output" "$expected"; then
+		echo "FAILED: cmilan $mode $dir/$test"
+		failed=1
+	fi
+}
+
+# Перевод программы $2 на C (cmilan $1 --emit-c), компиляция компилятором
+# C ($CC, по умолчанию cc) и исполнение
+emit_c()
+{
+	"$cmilan" $1 --emit-c "$2" > "$tmp/program.c" || return 1
+	${CC:-cc} -o "$tmp/program" "$tmp/program.c" || return 1
+	"$tmp/program"
+}
+
+# Запись программы в двоичном формате (--emit-binary) и исполнение файла
+bytecode()
+{
+	"$cmilan" --emit-binary "$1" > "$tmp/program.mlb" || return 1
+	"$cmilan" --run "$tmp/program.mlb"
+}
+
+# Печать программы в текстовом формате и исполнение загруженного текста
+# (при ошибках компиляции программа не печатается)
+text()
+{
+	"$cmilan" "$1" > "$tmp/program.o" 2> "$tmp/errors"
+	if [ -s "$tmp/errors" ]; then
+		cat "$tmp/errors"
+		return 1
+	fi
+	"$cmilan" --run "$tmp/program.o"
+}
+
+# Компиляция всех программ каталога одним пакетом (--batch) в $tmp/$1;
+# остальные аргументы передаются компилятору
+compile_batch()
+{
+	batch=$1
+	shift
+	rm -rf "$tmp/$batch"
+	mkdir "$tmp/$batch" || exit 1
+	for test in *.mil; do
+		echo "$test $tmp/$batch/${test%.mil}.o"
+	done > "$tmp/$batch.manifest"
+	"$cmilan" --batch -j 4 --manifest "$tmp/$batch.manifest" "$@" > "$tmp/$batch.log" 2>&1
+}
+
+# Исполнение программы $2, скомпилированной пакетом $1. Если программа не
+# скомпилирована, печатаются сообщения пакета о ее ошибках.
+batched()
+{
+	if [ -f "$tmp/$1/${2%.mil}.o" ]; then
+		"$cmilan" --run "$tmp/$1/${2%.mil}.o"
+	else
+		sed -n "s/^$2: //p" "$tmp/$1.log"
+		return 1
+	fi
+}
+
+# Повторная компиляция пакета с кэшем (--cache): все программы второго
+# пакета должны быть взяты из кэша и совпасть с программами без кэша.
+# Программы с ошибками в кэш не попадают и считаются промахами.
+compile_cached()
+{
+	compile_batch cache --cache "$tmp/cache"
+	compile_batch cached --cache "$tmp/cache"
+	count=$(ls "$tmp/batch" | wc -l)
+	if ! grep -q "^Cache: $count hits, .* 0 stored" "$tmp/cached.log"; then
+		echo "FAILED: cmilan --cache $dir: $(grep '^Cache:' "$tmp/cached.log")"
+		failed=1
+	fi
+	for program in "$tmp"/batch/*.o; do
+		if ! cmp -s "$program" "$tmp/cached/${program##*/}"; then
+			echo "FAILED: cmilan --cache $dir/${program##*/}"
+			failed=1
+		fi
+	done
+}
+
+# Выбор теста $1 в каталоге $dir: ожидаемый вывод и ввод
+prepare()
+{
+	test=$1
+	name=${test%.*}
+	expected=$name.out
+	input=/dev/null
+	if [ -f "$name.in" ]; then
+		input=$name.in
+	fi
+}
+
+# Исполнение программы на Милане во всех режимах
+run_modes()
+{
+	check "--run" "$cmilan" --run "$test"
+	check "--lexer ahead --run" "$cmilan" --lexer ahead --run "$test"
+	check "--lexer thread --run" "$cmilan" --lexer thread --run "$test"
+	check "--jit" "$cmilan" --jit "$test"
+	check "--emit-c" emit_c "" "$test"
+	check "--emit-binary" bytecode "$test"
+	check "(text)" text "$test"
+	check "--batch" batched batch "$test"
+	check "--cache" batched cached "$test"
+	check "--serve" "$client" "$tmp/socket" "$test"
+}
+
+# Запуск сервера компиляции и ожидание его сокета
+start_server()
+{
+	"$cmilan" --serve "$tmp/socket" &
+	server=$!
+	for i in 1 2 3 4 5; do
+		if [ -S "$tmp/socket" ]; then
+			return
+		fi
+		sleep 1
+	done
+	echo "FAILED: cmilan --serve: no socket"
+	failed=1
+}
+
+start_server
+dir=.
+cd "$tests" || exit 1
+compile_batch batch
+compile_cached
+for test in *.mil; do
+	prepare "$test"
+	run_modes
+done
+
+# Программы для оптимизатора исполняются и с оптимизацией (-O). В остальных
+# тестах есть ошибки времени исполнения, а их адреса зависят от оптимизации.
+# Если есть файл NAME.lst, с ним сравнивается код программы после -O.
+dir=opt
+cd "$tests/$dir" || exit 1
+compile_batch batch
+compile_cached
+for test in *.mil; do
+	prepare "$test"
+	run_modes
+	check "-O --verify-ir --run" "$cmilan" -O --verify-ir --run "$test"
+	check "-O --jit" "$cmilan" -O --jit "$test"
+	check "-O --emit-c" emit_c -O "$test"
+	if [ -f "$name.lst" ]; then
+		expected=$name.lst
+		check "-O (listing)" "$cmilan" -O "$test"
+	fi
+done
+
+# Программы виртуальной машины в текстовом формате, в том числе с ошибками
+dir=load
+cd "$tests/$dir" || exit 1
+for test in *.o; do
+	prepare "$test"
+	check "--run" "$cmilan" --run "$test"
+	check "--jit" "$cmilan" --jit "$test"
+done
+
+if [ $failed = 0 ]; then
+	echo "All tests passed"
+fi
+exit $failed
@@ -0,0 +1,141 @@
+// Клиент сервера компиляции для тестов (make check).
+//
+//     serverclient socket_path program.mil < input
+//
+// Отправляет серверу (cmilan --serve) запрос SERVER_RUN с текстом программы
+// и стандартным вводом, печатает вывод программы, а за ним сообщения об
+// ошибках, как cmilan --run с перенаправлением stderr в stdout. Код
+// завершения - 0, если сервер ответил SERVER_OK.
+
+#include "server.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+static void putUint32(string& buffer, uint32_t value)
+{
+	char bytes[4] = {
+		(char)(value & 0xFF), (char)((value >> 8) & 0xFF),
+		(char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF)
+	};
+	buffer.append(bytes, 4);
+}
+
+static uint32_t getUint32(const char* bytes)
+{
+	const unsigned char* p = (const unsigned char*)bytes;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void putBlock(string& buffer, const string& block)
+{
+	putUint32(buffer, block.size());
+	buffer += block;
+}
+
+// Чтение блока ответа с позиции position
+static bool getBlock(const string& response, size_t& position, string& block)
+{
+	if(response.size() - position < 4) {
+		return false;
+	}
+	uint32_t size = getUint32(response.data() + position);
+	position += 4;
+	if(response.size() - position < size) {
+		return false;
+	}
+	block.assign(response, position, size);
+	position += size;
+	return true;
+}
+
+static bool readAll(int fd, char* data, size_t size)
+{
+	while(size > 0) {
+		ssize_t n = read(fd, data, size);
+		if(n <= 0) {
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool writeAll(int fd, const char* data, size_t size)
+{
+	while(size > 0) {
+		ssize_t n = write(fd, data, size);
+		if(n <= 0) {
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc != 3) {
+		cerr << "Usage: serverclient socket_path program.mil < input" << endl;
+		return EXIT_FAILURE;
+	}
+
+	ifstream file(argv[2], ios::binary);
+	if(!file) {
+		cerr << "File '" << argv[2] << "' not found" << endl;
+		return EXIT_FAILURE;
+	}
+	ostringstream source;
+	source << file.rdbuf();
+	ostringstream input;
+	input << cin.rdbuf();
+
+	string request;
+	request += (char)SERVER_RUN;
+	putBlock(request, source.str());
+	putBlock(request, input.str());
+	string message;
+	putUint32(message, request.size());
+	message += request;
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+		cerr << "Cannot connect to '" << argv[1] << "'" << endl;
+		return EXIT_FAILURE;
+	}
+
+	char header[4];
+	string response;
+	bool ok = writeAll(fd, message.data(), message.size()) && readAll(fd, header, sizeof(header));
+	if(ok) {
+		response.resize(getUint32(header));
+		ok = response.empty() || readAll(fd, &response[0], response.size());
+	}
+	close(fd);
+
+	size_t position = 1;
+	string bytecode;
+	string diagnostics;
+	string output;
+	if(!ok || response.empty() || !getBlock(response, position, bytecode)
+		|| !getBlock(response, position, diagnostics) || !getBlock(response, position, output)) {
+		cerr << "Bad response from the server" << endl;
+		return EXIT_FAILURE;
+	}
+	cout << output << diagnostics;
+	return (response[0] == SERVER_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
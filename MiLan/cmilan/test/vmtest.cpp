@@ -0,0 +1,106 @@
+// Тест суперинструкций виртуальной машины (make check).
+//
+// Программа компилируется, в ее коде находится последовательность команд,
+// которую машина должна заменить суперинструкцией, и проверяется, что
+// после загрузки операция по этому адресу исполняет всю последовательность,
+// а вывод программы не изменился.
+
+#include "parser.h"
+#include "vm.h"
+#include "optimizer.h"
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+struct FusionTest
+{
+	const char* name;		// название суперинструкции
+	bool optimize;			// компиляция с оптимизацией (-O)
+	const char* source;		// текст программы
+	const char* input;		// входные данные программы
+	const char* output;		// ожидаемый вывод
+	Instruction pattern[12];	// последовательность команд, завершенная NOP
+	int length;			// ожидаемое число команд суперинструкции
+};
+
+static const FusionTest tests[] = {
+	{ "CHECK_BLOAD", false, "BEGIN ARRAY a[4]; i := READ; WRITE(a[i]) END", "3", "0\n",
+		{ DUP, DUP, LOAD, COMPARE, JUMP_YES, JUMP, PUSH, COMPARE, JUMP_YES, JUMP, BLOAD, NOP },
+		11 },
+	{ "CHECK_INDEX", false, "BEGIN ARRAY a[4]; i := READ; a[i] := 5; WRITE(a[3]) END", "3", "5\n",
+		{ DUP, DUP, LOAD, COMPARE, JUMP_YES, JUMP, PUSH, COMPARE, JUMP_YES, JUMP, NOP },
+		10 },
+	{ "INC", false, "BEGIN i := READ; i := i + 1; WRITE(i) END", "41", "42\n",
+		{ LOAD, PUSH, ADD, STORE, NOP },
+		4 },
+	{ "LL_JUMP", false, "BEGIN n := READ; i := 0; WHILE i < n DO i := i + 2 OD; WRITE(i) END", "5", "6\n",
+		{ LOAD, LOAD, COMPARE, JUMP_NO, NOP },
+		4 },
+	{ "CHECK_BLOAD_CONST", true, "BEGIN ARRAY a[4]; i := READ; WRITE(a[i]) END", "3", "0\n",
+		{ DUP, DUP, PUSH, COMPARE, JUMP_YES, JUMP, PUSH, COMPARE, JUMP_YES, JUMP, BLOAD, NOP },
+		11 },
+	{ "CHECK_INDEX_CONST", true, "BEGIN ARRAY a[4]; i := READ; a[i] := 5; WRITE(a[3]) END", "3", "5\n",
+		{ DUP, DUP, PUSH, COMPARE, JUMP_YES, JUMP, PUSH, COMPARE, JUMP_YES, JUMP, NOP },
+		10 }
+};
+
+// Адрес первого вхождения последовательности pattern в программу или -1
+static int find(const vector<Command>& code, const Instruction* pattern)
+{
+	for(size_t address = 0; address < code.size(); ++address) {
+		size_t i = 0;
+		while(pattern[i] != NOP && address + i < code.size()
+			&& code[address + i].getInstruction() == pattern[i]) {
+			++i;
+		}
+		if(pattern[i] == NOP) {
+			return address;
+		}
+	}
+	return -1;
+}
+
+int main()
+{
+	int failed = 0;
+	for(size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+		const FusionTest& test = tests[i];
+		istringstream source(test.source);
+		Parser parser(test.name, source);
+		Optimizer optimizer;
+		if(test.optimize) {
+			parser.setOptimizer(&optimizer);
+		}
+		if(!parser.compile()) {
+			cout << "FAILED: " << test.name << ": compile error" << endl;
+			failed = 1;
+			continue;
+		}
+		const vector<Command>& code = parser.getCode();
+		int address = find(code, test.pattern);
+
+		istringstream input(test.input);
+		ostringstream output;
+		VirtualMachine vm(input, output);
+		vm.load(code);
+		VmStatus status = vm.run();
+
+		if(address < 0) {
+			cout << "FAILED: " << test.name << ": sequence not found" << endl;
+			failed = 1;
+		}
+		else if(vm.getFusedLength(address) != test.length) {
+			cout << "FAILED: " << test.name << ": " << vm.getFusedLength(address)
+			     << " commands fused at address " << address << ", "
+			     << test.length << " expected" << endl;
+			failed = 1;
+		}
+		if(status != VM_OK || output.str() != test.output) {
+			cout << "FAILED: " << test.name << ": wrong result" << endl;
+			failed = 1;
+		}
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}